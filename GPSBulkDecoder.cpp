@@ -0,0 +1,375 @@
+#include "GPSBulkDecoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "GPSDecoder.h"
+
+struct GPSBulkDecoder::Log
+{
+	const char* data = nullptr;
+	size_t length = 0;
+};
+
+// One chunk of a log, [start, end), and what its decoder made of it.
+struct GPSBulkDecoder::Chunk
+{
+	size_t log;
+	size_t warmup;				//its decoder starts at the first epoch from here
+	size_t start;
+	size_t end;
+	bool last;					//of its log
+
+	//fixes emitted from start on, the first being the decoder's
+	//firstIndex-th, up to where the chunk syncChunk took over
+	std::vector<GPSFix> fixes;
+	uint64_t firstIndex = 0;
+
+	//the decoder of chunk syncChunk had emitted syncIndex fixes and
+	//counted syncStats by then, this one endStats
+	size_t syncChunk = 0;
+	uint64_t syncIndex = 0;
+	GPSStatsSnapshot syncStats;
+	GPSStatsSnapshot endStats;
+	uint64_t resyncs = 0;
+
+	bool done = false;
+};
+
+//counts what a decoder emits, and keeps it once keep is set
+struct Collector
+{
+	std::vector<GPSFix>* fixes;
+	uint64_t emitted;
+	bool keep;
+};
+
+static void fixCollected(const GPSFix& fix, void* context)
+{
+	Collector* collector = static_cast<Collector*>(context);
+	collector->emitted++;
+	if(collector->keep)
+		collector->fixes->push_back(fix);
+}
+
+static const char* nextLine(const char* from, const char* end)
+{
+	const char* newline = (const char*)memchr(from, '\n', end - from);
+	return newline ? newline + 1 : end;
+}
+
+static size_t nextFrame(const char* data, size_t length, size_t from)
+{
+	if(from >= length)
+		return length;
+	const char* dollar = (const char*)memchr(data + from, '$', length - from);
+	return dollar ? dollar - data : length;
+}
+
+//the first line from from on that opens an epoch: a decoder starting
+//there learns the whole burst from its first fix, rather than the tail
+//of one it came in on, and so can match the decoder that saw it all
+static size_t epochStart(const char* data, size_t from, size_t to)
+{
+	GPSDecoder scout{GPSSourceConfig()};
+	Collector collector{nullptr, 0, false};
+	scout.addFixListener(fixCollected, &collector);
+
+	const char* line = data + from;
+	const char* end = data + to;
+	while(line < end)
+	{
+		uint64_t emitted = collector.emitted;
+		bool pending = scout.epochPending();
+		const char* after = nextLine(line, end);
+		scout.decode(line, after - line);
+
+		//a time change closed the last epoch, or this one opened after it
+		if(scout.epochPending() && ((collector.emitted > emitted) || ((emitted > 0) && !pending)))
+			return line - data;
+		line = after;
+	}
+	return from;
+}
+
+int GPSBulkDecoder::add(const std::string& path)
+{
+	struct stat st;
+	if(stat(path.c_str(), &st) < 0)
+		return 0;
+
+	if(!S_ISDIR(st.st_mode))
+	{
+		files.push_back(path);
+		return 1;
+	}
+
+	DIR* dir = opendir(path.c_str());
+	if(!dir)
+		return 0;
+
+	std::vector<std::string> found;
+	while(struct dirent* entry = readdir(dir))
+	{
+		std::string file = path + "/" + entry->d_name;
+		if((stat(file.c_str(), &st) == 0) && S_ISREG(st.st_mode))
+			found.push_back(file);
+	}
+	closedir(dir);
+
+	std::sort(found.begin(), found.end());
+	files.insert(files.end(), found.begin(), found.end());
+	return 1;
+}
+
+void GPSBulkDecoder::addStats(const GPSStatsSnapshot& end, const GPSStatsSnapshot& start)
+{
+	totals.bytes += end.bytes - start.bytes;
+	totals.frames += end.frames - start.frames;
+	totals.sentences += end.sentences - start.sentences;
+	totals.checksumFailures += end.checksumFailures - start.checksumFailures;
+	totals.malformed += end.malformed - start.malformed;
+	totals.truncated += end.truncated - start.truncated;
+	totals.overlong += end.overlong - start.overlong;
+	totals.droppedBytes += end.droppedBytes - start.droppedBytes;
+	totals.noPosition += end.noPosition - start.noPosition;
+	totals.ubxFrames += end.ubxFrames - start.ubxFrames;
+	totals.ubxChecksumFailures += end.ubxChecksumFailures - start.ubxChecksumFailures;
+	totals.epochs += end.epochs - start.epochs;
+	totals.partialEpochs += end.partialEpochs - start.partialEpochs;
+	totals.otherTypes += end.otherTypes - start.otherTypes;
+
+	//by address, a chunk's decoder has seen them in its own order
+	for(const auto& type : end.types)
+	{
+		uint64_t count = type.second;
+		for(const auto& before : start.types)
+			if(before.first == type.first)
+				count -= before.second;
+		if(count == 0)
+			continue;
+
+		auto total = std::find_if(totals.types.begin(), totals.types.end(),
+			[&](const std::pair<std::string, uint64_t>& t) { return t.first == type.first; });
+		if(total != totals.types.end())
+			total->second += count;
+		else
+			totals.types.push_back(std::make_pair(type.first, count));
+	}
+}
+
+void GPSBulkDecoder::decodeChunk(const std::vector<Log>& logs, std::vector<Chunk>& chunks, size_t index,
+	const std::atomic<size_t>& covered)
+{
+	//decoded already by a chunk before, which did not catch up with it
+	if(index < covered)
+		return;
+
+	Chunk& chunk = chunks[index];
+	const char* data = logs[chunk.log].data;
+
+	GPSDecoder decoder{GPSSourceConfig()};
+	Collector collector{&chunk.fixes, 0, false};
+	decoder.addFixListener(fixCollected, &collector);
+
+	size_t warmup = epochStart(data, chunk.warmup, chunk.start);
+	decoder.decode(data + warmup, chunk.start - warmup);
+	chunk.firstIndex = collector.emitted;
+	collector.keep = true;
+	decoder.decode(data + chunk.start, chunk.end - chunk.start);
+
+	for(size_t next = index + 1; !chunks[next - 1].last; next++)
+	{
+		if(index < covered)
+			return;
+		const Chunk& following = chunks[next];
+
+		//the next chunk's decoder as it will be at its start
+		GPSDecoder ahead{GPSSourceConfig()};
+		Collector aheadCollector{nullptr, 0, false};
+		ahead.addFixListener(fixCollected, &aheadCollector);
+		warmup = epochStart(data, following.warmup, following.start);
+		ahead.decode(data + warmup, following.start - warmup);
+
+		const char* line = data + following.start;
+		const char* end = data + following.end;
+		const char* limit = data + std::min(following.end, following.start + config.syncBytes);
+		while(line < limit)
+		{
+			const char* after = nextLine(line, end);
+			decoder.decode(line, after - line);
+			ahead.decode(line, after - line);
+			line = after;
+
+			if(decoder.inSyncWith(ahead))
+			{
+				chunk.syncChunk = next;
+				chunk.syncIndex = aheadCollector.emitted;
+				ahead.readStats(chunk.syncStats);
+				decoder.readStats(chunk.endStats);
+				return;
+			}
+		}
+
+		decoder.decode(line, end - line);
+		chunk.resyncs++;
+	}
+
+	decoder.flush();
+	chunk.syncChunk = chunks.size();
+	for(size_t next = index + 1; next < chunks.size(); next++)
+	{
+		if(chunks[next].log != chunk.log)
+		{
+			chunk.syncChunk = next;
+			break;
+		}
+	}
+	decoder.readStats(chunk.endStats);
+}
+
+int GPSBulkDecoder::run(GPSFixCallback callback, void* context)
+{
+	totals = GPSStatsSnapshot();
+	fallbacks = 0;
+
+	std::vector<Log> logs(files.size());
+	bool opened = true;
+	for(size_t i = 0; opened && (i < files.size()); i++)
+	{
+		int fd = ::open(files[i].c_str(), O_RDONLY);
+		struct stat st;
+		if((fd < 0) || (fstat(fd, &st) < 0))
+			opened = false;
+		else if(st.st_size > 0)
+		{
+			void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(mapped == MAP_FAILED)
+				opened = false;
+			else
+			{
+				madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+				logs[i].data = (const char*)mapped;
+				logs[i].length = st.st_size;
+			}
+		}
+		if(fd >= 0)
+			::close(fd);
+	}
+
+	std::vector<Chunk> chunks;
+	for(size_t i = 0; opened && (i < logs.size()); i++)
+	{
+		const Log& log = logs[i];
+		size_t start = 0;
+		while(start < log.length)
+		{
+			size_t end = nextFrame(log.data, log.length, start + std::max<size_t>(config.chunkBytes, 1));
+			size_t warmup = 0;
+			if(start > config.warmupBytes)
+				warmup = nextFrame(log.data, log.length, start - config.warmupBytes);
+
+			Chunk chunk;
+			chunk.log = i;
+			chunk.warmup = std::min(warmup, start);
+			chunk.start = start;
+			chunk.end = end;
+			chunk.last = (end == log.length);
+			chunks.push_back(std::move(chunk));
+			start = end;
+		}
+	}
+
+	int threads = config.threads;
+	if(threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t inFlight = (config.maxInFlight > 0) ? config.maxInFlight : 4 * threads;
+
+	std::mutex lock;
+	std::condition_variable ready;
+	std::condition_variable space;
+	size_t delivered = 0;
+
+	//in order, so the chunk the merge waits for is always being decoded
+	std::atomic<size_t> next{0};
+	std::atomic<size_t> covered{0};
+	auto worker = [&]()
+	{
+		for(size_t i = next++; i < chunks.size(); i = next++)
+		{
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				space.wait(guard, [&]() { return i < delivered + inFlight; });
+			}
+
+			decodeChunk(logs, chunks, i, covered);
+
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				chunks[i].done = true;
+			}
+			ready.notify_one();
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for(int i = 0; i < std::min<int>(threads, chunks.size()); i++)
+		pool.emplace_back(worker);
+
+	size_t skipUntil = 0;
+	uint64_t cut = 0;
+	GPSStatsSnapshot empty;
+	const GPSStatsSnapshot* before = &empty;
+	for(size_t i = 0; i < chunks.size(); i++)
+	{
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			ready.wait(guard, [&]() { return chunks[i].done; });
+		}
+
+		Chunk& chunk = chunks[i];
+		if((i == 0) || (chunks[i - 1].log != chunk.log))
+		{
+			cut = 0;
+			before = &empty;
+		}
+
+		if(i >= skipUntil)
+		{
+			for(size_t j = cut - chunk.firstIndex; j < chunk.fixes.size(); j++)
+				callback(chunk.fixes[j], context);
+			addStats(chunk.endStats, *before);
+			fallbacks += chunk.resyncs;
+
+			skipUntil = chunk.syncChunk;
+			covered = skipUntil;
+			cut = chunk.syncIndex;
+			before = &chunk.syncStats;
+		}
+		std::vector<GPSFix>().swap(chunk.fixes);
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			delivered = i + 1;
+		}
+		space.notify_all();
+	}
+
+	for(std::thread& thread : pool)
+		thread.join();
+
+	for(const Log& log : logs)
+		if(log.data)
+			munmap((void*)log.data, log.length);
+	return opened ? 1 : 0;
+}
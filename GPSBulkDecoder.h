@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GPSEpochAssembler.h"
+#include "GPSStats.h"
+
+struct GPSBulkConfig
+{
+	// Decoding threads, 0 for every core. The calling thread merges.
+	int threads = 0;
+
+	// Bytes per chunk, each decoded by one thread.
+	size_t chunkBytes = 8 << 20;
+
+	// Bytes before its chunk each decoder starts on, from the first epoch
+	// in them, so it already knows the epoch and satellite groups under
+	// way when the chunk begins. With 0 a decoder starts mid-burst, and
+	// may never catch up with a stream whose epochs all end complete.
+	size_t warmupBytes = 64 << 10;
+
+	// How far into the next chunk a decoder goes to catch up with that
+	// chunk's own decoder before it gives up and decodes the whole of it.
+	size_t syncBytes = 1 << 20;
+
+	// Chunks decoded ahead of the one being delivered, 0 for four per
+	// thread. Bounds the fixes held in memory.
+	int maxInFlight = 0;
+};
+
+// Decodes raw NMEA and UBX logs on every core, with the same fixes, in the
+// same order, and the same counts as decoding each log start to end on
+// one GPSDecoder.
+//
+// Each log is cut into chunks at a '$'. A chunk's decoder first decodes
+// warmupBytes of the chunk before without keeping what comes out, then
+// the chunk itself. Then it goes on into the next chunk line by line in
+// step with a second decoder that has had the same warm-up as that
+// chunk's decoder, until the two are in the same state between frames,
+// see GPSDecoder::inSyncWith(). From that line on the next chunk's decoder
+// would produce exactly what this one would, so the fixes up to it come
+// from this chunk and the rest from the next. The warm-up only makes the
+// catch-up quick; correctness rests on the states matching. When they do
+// not match within syncBytes, e.g. in a long run of damaged data, this
+// decoder decodes the whole next chunk too and tries again at the one
+// after.
+//
+// Threads take chunks in order from a shared counter and never get more
+// than maxInFlight ahead of the merge, which hands the fixes to the
+// callback on the calling thread as each chunk completes in turn.
+//
+// Every log starts on a fresh decoder state, as if each were replayed
+// with a GPSDecoder of its own.
+
+class GPSBulkDecoder
+{
+public:
+	void setConfig(const GPSBulkConfig& newConfig) { config = newConfig; }
+
+	// A log, or a directory, whose regular files are added in name order.
+	// Returns 0 when the path cannot be read.
+	int add(const std::string& path);
+
+	size_t fileCount() const { return files.size(); }
+	const std::string& file(size_t i) const { return files[i]; }
+
+	// Decodes every log added, calling back once per fix on this thread.
+	// Returns 0, before decoding anything, when a log cannot be opened.
+	int run(GPSFixCallback callback, void* context);
+
+	// Totals over every log of the last run(). The latency histograms stay
+	// empty, offline they would only time the decoding.
+	void readStats(GPSStatsSnapshot& out) const { out = totals; }
+	uint64_t fixCount() const { return totals.epochs; }
+
+	// Chunks the decoder before had to decode whole, not having caught up
+	// with them. Their own decoding is thrown away.
+	uint64_t resyncs() const { return fallbacks; }
+
+private:
+	struct Chunk;
+	struct Log;
+
+	void decodeChunk(const std::vector<Log>& logs, std::vector<Chunk>& chunks, size_t index,
+		const std::atomic<size_t>& covered);
+	void addStats(const GPSStatsSnapshot& end, const GPSStatsSnapshot& start);
+
+	GPSBulkConfig config;
+	std::vector<std::string> files;
+
+	GPSStatsSnapshot totals;
+	uint64_t fallbacks = 0;
+};
@@ -0,0 +1,215 @@
+#include "GPSDashboard.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+//used when the output is not a terminal
+static const int DEFAULT_WIDTH = 80;
+static const int DEFAULT_HEIGHT = 24;
+
+//SNR that fills a whole bar, in dB-Hz
+static const double FULL_SNR = 50.0;
+
+GPSTerminalFrame::GPSTerminalFrame(int fd) : fd(fd)
+{
+}
+
+GPSTerminalFrame::~GPSTerminalFrame()
+{
+	if(front.empty())
+		return;
+
+	//leave the cursor visible, below the last frame
+	char restore[32];
+	int length = snprintf(restore, sizeof(restore), "\x1b[%d;1H\x1b[?25h\n", height);
+	if(write(fd, restore, length) < 0)
+		return;
+}
+
+void GPSTerminalFrame::begin()
+{
+	int newWidth = DEFAULT_WIDTH;
+	int newHeight = DEFAULT_HEIGHT;
+
+	struct winsize size;
+	if((ioctl(fd, TIOCGWINSZ, &size) == 0) && (size.ws_col > 0) && (size.ws_row > 0))
+	{
+		newWidth = size.ws_col;
+		newHeight = size.ws_row;
+	}
+
+	if((newWidth != width) || (newHeight != height))
+	{
+		width = newWidth;
+		height = newHeight;
+		back.resize(width * height);
+		front.resize(width * height);
+		fullRedraw = true;
+	}
+
+	std::fill(back.begin(), back.end(), ' ');
+}
+
+void GPSTerminalFrame::print(int row, int col, std::string_view text)
+{
+	if((row < 0) || (row >= height) || (col < 0) || (col >= width))
+		return;
+
+	size_t length = std::min(text.length(), (size_t)(width - col));
+	std::copy(text.begin(), text.begin() + length, back.begin() + row*width + col);
+}
+
+void GPSTerminalFrame::printf(int row, int col, const char* format, ...)
+{
+	char text[256];
+
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+
+	if(length > 0)
+		print(row, col, std::string_view(text, std::min(length, (int)sizeof(text) - 1)));
+}
+
+void GPSTerminalFrame::bar(int row, int col, int cells, double fraction)
+{
+	int filled = (int)(std::min(1.0, std::max(0.0, fraction)) * cells + 0.5);
+
+	std::string text(cells, '.');
+	std::fill(text.begin(), text.begin() + filled, '#');
+	print(row, col, text);
+}
+
+size_t GPSTerminalFrame::present()
+{
+	out.clear();
+
+	if(fullRedraw)
+	{
+		//hide the cursor and start from a blank screen
+		out.append("\x1b[?25l\x1b[2J");
+		std::fill(front.begin(), front.end(), ' ');
+		fullRedraw = false;
+	}
+
+	int cursorRow = -1;
+	int cursorCol = -1;
+	for(int row = 0; row < height; row++)
+	{
+		const char* want = &back[row*width];
+		char* have = &front[row*width];
+
+		for(int col = 0; col < width; col++)
+		{
+			if(want[col] == have[col])
+				continue;
+
+			//a short run of unchanged cells is cheaper to rewrite than to skip
+			if((row == cursorRow) && (col > cursorCol) && (col - cursorCol <= 4))
+				out.append(want + cursorCol, col - cursorCol);
+			else if((row != cursorRow) || (col != cursorCol))
+			{
+				char move[24];
+				int length = snprintf(move, sizeof(move), "\x1b[%d;%dH", row + 1, col + 1);
+				out.append(move, length);
+			}
+
+			out.push_back(want[col]);
+			have[col] = want[col];
+			cursorRow = row;
+			cursorCol = col + 1;
+		}
+	}
+
+	const char* p = out.data();
+	size_t left = out.size();
+	while(left > 0)
+	{
+		ssize_t n = write(fd, p, left);
+		if(n <= 0)
+			break;
+		p += n;
+		left -= n;
+	}
+	return out.size() - left;
+}
+
+GPSDashboard::GPSDashboard(GPSDecoder& decoder, int refreshHz) :
+	decoder(decoder),
+	refreshPeriod(1000 / std::max(1, refreshHz))
+{
+}
+
+size_t GPSDashboard::draw()
+{
+	//the rate is taken over a second or more, receivers send in bursts
+	auto now = std::chrono::steady_clock::now();
+	GPSStatsSnapshot stats;
+	decoder.readStats(stats);
+	uint64_t sentences = stats.sentences;
+	double seconds = std::chrono::duration<double>(now - rateStart).count();
+	if(rateStart.time_since_epoch().count() == 0)
+	{
+		rateStart = now;
+		rateSentences = sentences;
+	}
+	else if(seconds >= 1.0)
+	{
+		sentenceRate = (sentences - rateSentences) / seconds;
+		rateStart = now;
+		rateSentences = sentences;
+	}
+
+	GPSSnapshot snap;
+	decoder.readSnapshot(snap);
+	const GPSFix& fix = snap.fix;
+
+	static const char* fixNames[] = {"--", "none", "2D", "3D"};
+	const char* fixName = ((fix.fixType >= 0) && (fix.fixType <= 3)) ? fixNames[fix.fixType] : "??";
+
+	frame.begin();
+	frame.print(0, 0, "Search and Rescue Menu V0.1");
+	if(decoder.inputSource())
+		frame.print(0, 40, decoder.inputSource()->name());
+
+	frame.printf(2, 0, "Time   %02d:%02d:%02d.%03d UTC   Date %04d-%02d-%02d",
+		fix.time.hour, fix.time.minute, fix.time.second, fix.time.millisecond,
+		fix.date.year, fix.date.month, fix.date.day);
+	frame.printf(3, 0, "Fix    %-4s  quality %d  status %c  talker %s%s",
+		fixName, fix.quality, fix.status ? fix.status : '-', fix.talker.id, snap.rejected ? "  rejected by filter" : "");
+	frame.printf(4, 0, "Lat    %12.7f   Lon %12.7f   Alt %8.1f m",
+		fix.latitude, fix.longitude, fix.altitude);
+	frame.printf(5, 0, "Speed  %6.1f kn   Course %6.1f   Track %.3f km  %.1f kn  %.1f deg",
+		fix.speedKnots, fix.course, snap.motion.distance / 1000,
+		snap.motion.speed / GPS_METRES_PER_SECOND_PER_KNOT, snap.motion.heading);
+	frame.printf(6, 0, "Sats   %d used, %d in view   PDOP %.1f  HDOP %.1f  VDOP %.1f",
+		fix.satellitesUsed, fix.satellitesInView, fix.PDOP, fix.HDOP, fix.VDOP);
+
+	frame.printf(8, 0, "Sentences %llu  %.0f/s   Checksum failures %llu   Epoch %llu",
+		(unsigned long long)sentences, sentenceRate,
+		(unsigned long long)stats.checksumFailures, (unsigned long long)snap.epoch);
+	frame.printf(9, 0, "Malformed %llu  Truncated %llu  Dropped %llu B   Fix latency p50 %llu us  p99 %llu us",
+		(unsigned long long)stats.malformed, (unsigned long long)stats.truncated,
+		(unsigned long long)stats.droppedBytes, (unsigned long long)stats.inputToFix.percentile(0.5),
+		(unsigned long long)stats.inputToFix.percentile(0.99));
+
+	const GPSSatTable& sats = snap.satellites;
+	frame.printf(11, 0, "Satellites  %d tracked of %d, mean SNR %.1f dB-Hz",
+		sats.tracked(), sats.count, sats.meanSNR());
+
+	int barWidth = std::max(0, std::min(40, frame.cols() - 40));
+	for(int i = 0; (i < sats.count) && (12 + i < frame.rows()); i++)
+	{
+		frame.printf(12 + i, 0, "%-8s %3d  el %2d az %3d  SNR %2d",
+			gpsConstellationName(sats.constellation[i]), sats.prn[i],
+			sats.elevation[i], sats.azimuth[i], sats.SNR[i]);
+		frame.bar(12 + i, 38, barWidth, sats.SNR[i] / FULL_SNR);
+	}
+
+	return frame.present();
+}
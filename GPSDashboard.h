@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "GPSDecoder.h"
+
+// A screen's worth of character cells that is drawn by difference.
+//
+// Each frame is laid out from scratch into the back buffer; present()
+// compares it with what is on the terminal and sends only the cells that
+// changed, as cursor moves and text, in a single write(). An idle screen
+// costs no output at all.
+
+class GPSTerminalFrame
+{
+public:
+	GPSTerminalFrame(int fd = 1);
+	~GPSTerminalFrame();
+
+	// Starts a new frame of blank cells, following the terminal size.
+	void begin();
+
+	void print(int row, int col, std::string_view text);
+	void printf(int row, int col, const char* format, ...) __attribute__((format(printf, 4, 5)));
+
+	// width cells of '#' filled in proportion to fraction, 0 to 1.
+	void bar(int row, int col, int width, double fraction);
+
+	// Brings the terminal up to date. Returns the bytes written.
+	size_t present();
+
+	int rows() const { return height; }
+	int cols() const { return width; }
+
+private:
+	int fd;
+	int width = 0;
+	int height = 0;
+	bool fullRedraw = true;
+
+	std::vector<char> back;
+	std::vector<char> front;
+	std::string out;
+};
+
+// Live view of one decoder: the latest fix, decode and checksum rates and
+// an SNR bar per satellite, drawn from the published snapshot.
+
+class GPSDashboard
+{
+public:
+	GPSDashboard(GPSDecoder& decoder, int refreshHz = 10);
+
+	std::chrono::milliseconds period() const { return refreshPeriod; }
+
+	// Draws one frame. Returns the bytes written to the terminal.
+	size_t draw();
+
+private:
+	GPSDecoder& decoder;
+	GPSTerminalFrame frame;
+	std::chrono::milliseconds refreshPeriod;
+
+	std::chrono::steady_clock::time_point rateStart;
+	uint64_t rateSentences = 0;
+	double sentenceRate = 0;
+};
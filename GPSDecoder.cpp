@@ -1,605 +1,748 @@
-#include "GPSDecoder.h"
-
-GPSDecoder::GPSDecoder(std::string UARTStr){
-
-for(int i = 0; i<12; i++)
-	GSAData.PRN.push_back(0);
-}
-
-GPSDecoder::~GPSDecoder(){
-		UARTStream.Close();
-		closeFile();
-}
-
-int GPSDecoder::initDecoder()
-{
-	int ret = 0;
-	ret = initFiles();
-	ret += initGPS();
-	if(ret == 2)
-		return 1;
-	else
-		return 0;
-}
-
-int GPSDecoder::initGPS()
-{
-
-	UARTStream.Open(UARTStr);
-	UARTStream.SetBaudRate(SerialStreamBuf::BAUD_38400);
-
-	if(UARTStream.IsOpen())
-		return 1;
-	else
-		return 0;
-}
-
-int GPSDecoder::initFiles()
-{
-	//initialize the KML file
-	file.open("KMLOutput.kml", std::ios::out);
-	if(file.is_open())
-	{
-		file 	<< "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
-					<< "<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n"
-					<< "\t<Document>\n"
-					<< "\t\t<name>testing kml</name>\n"
-					<< "\t\t<description/>\n"
-					<< "\t\t<Style id=\"test_line\">"
-					<< "\t\t\t<IconStyle><Icon>\n"
-					<< "\t\t\t\t<href>http://maps.google.com/mapfiles/kml/pal3/icon19.png</href>\n"
-					<< "\t\t\t</Icon></IconStyle>\n"
-					<< "\t\t\t<LineStyle><color>ff0000ff</color><width>8</width></LineStyle>\n"
-					<< "\t\t</Style>\n"
-					<< "\t\t\t<Placemark>\n"
-					<< "\t\t\t\t<name>Placemark Name</name>\n"
-					<< "\t\t\t\t<styleUrl>#test_line</styleUrl>\n"
-					<< "\t\t\t\t<LineString>\n"
-					<< "\t\t\t\t\t<tessellate>1</tessellate>\n"
-					<< "\t\t\t\t\t<coordinates>"<< std::endl;
-
-		file.close();
-		return 1;
-	}
-	return 0;
-}
-
-void GPSDecoder::printKMLtoConsole()
-{
-	std::cout << "print KML "
-	<< GGAData.GGALongitudeNum << ","
-	<< GGAData.GGALatitudeNum << "," << 0
-	<< std::endl;
-}
-
-int GPSDecoder::printKMLtoFile()
-{
-	file.open(KMLOutputStr, std::ios::app);
-	if(file.is_open() && ((GGAData.gps_fix == 1) || (GGAData.gps_fix == 2)))
-	{
-		file.precision(10);
-
-		file << "\t\t\t\t\t\t"
-		<< GGAData.GGALongitudeNum << ","
-		<< GGAData.GGALatitudeNum << "," << 0
-		<< std::endl;
-
-		file.close();
-
-		return 1;
-	}
-	else
-		return 0;
-}
-
-void GPSDecoder::closeFile()
-{
-	file.open("KMLOutput.kml", std::ios::app);
-	if(file.is_open())
-	{
-		file 	<< "\t\t\t\t\t</coordinates>\n"
-					<< "\t\t\t\t</LineString>\n"
-					<< "\t\t\t</Placemark>\n"
-					<< "\t</Document>\n"
-					<< "</kml>"
-					<< std::endl;
-		file.close();
-	}
-}
-
-void GPSDecoder::crunchGPSSentence(std::string inputString)
-{
-	//get GPS senetence name
-	std::string GPSSentenceName = inputString.substr(3,3);
-
-	//Make copy of inputstring in a char array
-	char* GPSSentence = new char[inputString.length()+1];
-	for(int i = 0; i<inputString.length(); i++)
-		GPSSentence[i] = 0;
-
-	for(int i=0; i<inputString.length();i++){
-		GPSSentence[i]=inputString[i];
-	}
-	GPSSentence[inputString.length()] = 0;
-
-  if(!GPSSentenceName.compare("GGA"))
-    readGGAData(GPSSentence);
-  else if(!GPSSentenceName.compare("GSA"))
-  	readGSAData(GPSSentence);
-  else if(!GPSSentenceName.compare("GSV"))
-	 	readGSVData(GPSSentence);
-  else if(!GPSSentenceName.compare("GLL"))
-		readGLLData(GPSSentence);
-  else if(!GPSSentenceName.compare("RMC"))
-  	readRMCData(GPSSentence);
-  else if(!GPSSentenceName.compare("TXT"))
-		readTXTData(GPSSentence);
-  else if(!GPSSentenceName.compare("VTG"))
-		readVTGData(GPSSentence);
-  else;
-//    std::cout << "Other message: " << GPSSentenceName << std::endl;
-
-	delete GPSSentence;
-}
-
-int GPSDecoder::readGGAData(char* sentence)
-{
-	//std::cout << "readGGAData: " << sentence << std::endl;
-  char* token;
-	std::string tempStr;
-	int latlonglength;
-	//std::cout << "sentence: " << sentence << std::endl;
-	float tempFlt;
-	token = std::strtok(sentence, ",");
-  token = std::strtok(NULL, ",");
-  GGAData.GGAfixTime = token;
-
-	//std::cout << "GGAData.GGAfixTime: " << GGAData.GGAfixTime << std::endl;
-
-	//Computing GGAData.Latitude
-  GGAData.GGALatitude = std::strtok(NULL, ",");
-	latlonglength = GGAData.GGALatitude.length();
-
-
-	//std::cout << "GGAData.GGALatitude: "  << std::endl;
-
-	if(!strcmp(GGAData.GGALatitude.c_str(), "0"))
-	{
-		std::cout << "No data in GGA" << std::endl;
-		return 1;
-	}
-		std::string GPSdegrees = GGAData.GGALatitude.substr(0,latlonglength-8);
-		std::string GPSMinutes = GGAData.GGALatitude.substr(latlonglength-8,8);
-
-		//std::cout << "GGAData.GGALatitude: " << GGAData.GGALatitude << std::endl;
-
-	tempFlt = atof(GPSdegrees.c_str());
-	GGAData.GGALatitudeNum = (float)tempFlt;
-	std::cout.precision(10);
-
-	tempFlt = (atof(GPSMinutes.c_str())/60.000000);
-	GGAData.GGALatitudeNum += tempFlt;
-
-	token = std::strtok(NULL, ",");
-	if(strcmp(token, "S") == 0)
-		GGAData.GGALatitudeNum *= -1;
-
-	// std::cout << "GGALatitude: " << GGAData.GGALatitude << std::endl;
-	// std::cout << "GPSdegrees: "<< GPSdegrees <<std::endl;
-	// std::cout << "GPSminutes: "<< GPSMinutes <<std::endl;
-	// std::cout << "GGALatitudeNum: " << GGAData.GGALatitudeNum << std::endl;
-
-  GGAData.GGALongitude = std::strtok(NULL, ",");
-	latlonglength = GGAData.GGALongitude.length();
-
-	GPSdegrees = GGAData.GGALongitude.substr(0,latlonglength-8);
-	GPSMinutes = GGAData.GGALongitude.substr(latlonglength-8,8);
-
-	GGAData.GGALongitudeNum = atof(GPSdegrees.c_str());
-	GGAData.GGALongitudeNum += (atof(GPSMinutes.c_str())/60.000000);
-	token = std::strtok(NULL, ",");
-	if(strcmp(token, "W") == 0)
-		GGAData.GGALongitudeNum *= -1;
-
-	// std::cout << "longitude: " << GGAData.GGALongitude << std::endl;
-	// std::cout << "GPSdegrees: "<< GPSdegrees <<std::endl;
-	// std::cout << "GPSminutes: "<< GPSMinutes <<std::endl;
-	// std::cout << "GGALongitudeNum: " << GGAData.GGALongitudeNum << std::endl;
-
-  token = std::strtok(NULL, ",");
-  //std::cout << "gps_fix: " << token << std::endl;
-  GGAData.gps_fix = atoi(token);
-
-  token = std::strtok(NULL, ",");
-  //std::cout << "sat_num: " << token << std::endl;
-  GGAData.satNum = atoi(token);
-
-  token = std::strtok(NULL, ",");
-  //std::cout << "horzDOP: " << token << std::endl;
-  GGAData.horzDOP = atof(token);
-
-  token = std::strtok(NULL, ",");
-  //std::cout << "alt: " << token << std::endl;
-  GGAData.alt = atoi(token);
-  token = std::strtok(NULL, ",");
-
-  token = std::strtok(NULL, ",");
-  //std::cout << "heightOfGeoid: " << token << std::endl;
-  GGAData.heightOfGeoid = atof(token);
-  token = std::strtok(NULL, ",");
-}
-
-void GPSDecoder::readGSAData(char* sentence)
-{
-
-	char moddedSentence[100];
-	char* moddedPtr = moddedSentence;
-	char* sentPtr = sentence;
-
-	while(*sentPtr != 0)
-	{
-		*moddedPtr++ = *sentPtr;
-		if((sentPtr[0] == ',') && (sentPtr[1] == ',')){
-			*moddedPtr++ = '0';
-		}
-		sentPtr++;
-	}
-	*moddedPtr == 0;
-
-	//Start toking
-	// std::cout << "moddedSentence: " << moddedSentence << std::endl;
-	// std::cout << "Sentence:       " << sentence << std::endl;
-	char* token = std::strtok(moddedSentence, ",");
-	// std::cout << "preambl: " << token << std::endl;
-
-	token = std::strtok(NULL, ",");
-	// std::cout << "autoSelect: " << token << std::endl;
-	GSAData.autoSelect = token;
-
-	token = std::strtok(NULL, ",");
-	// std::cout << "fixTime: " << token << std::endl;
-	GSAData.GPSFix = atof(token);
-
-	for(int i=0; i< 12; i++)
-	{
-		token = std::strtok(NULL, ",");
-		//std::cout << "PRN[" << i << "]" << token << std::endl;
-		GSAData.PRN[i] = atoi(token);
-	}
-
-	token = std::strtok(NULL, ",");
-	// std::cout << "PDOP: " << token << std::endl;
-	GSAData.PDOP = atof(token);
-
-	token = std::strtok(NULL, ",");
-	// std::cout << "HDOP: " << token << std::endl;
-	GSAData.HDOP = atof(token);
-
-	token = std::strtok(NULL, ",");
-	// std::cout << "VDOP: " << token << std::endl;
-	GSAData.VDOP = atof(token);
-}
-
-void GPSDecoder::readGSVData(char* sentence)
-{
-	//std::cout << "starting readGSVData: " << std::endl;
-	//Start toking
-	char* token = std::strtok(sentence, ",");
-	//std::cout << "preambl: " << token << std::endl;
-
-	token = std::strtok(NULL, ",");
-	//std::cout << "fullDataSentNum: " << token << std::endl;
-	GSVData.fullDataSentNum = atoi(token);
-
-	token = std::strtok(NULL, ",");
-	//std::cout << "sentence: " << token << std::endl;
-	GSVData.sentence = atoi(token);
-
-	token = std::strtok(NULL, ",");
-	//std::cout << "sateliteInView: " << token << std::endl;
-	GSVData.sateliteInView = atoi(token);
-
-	token = std::strtok(NULL, ",");
-	//std::cout << "satPRNNum: " << token << std::endl;
-	GSVData.satPRNNum = atoi(token);
-
-	token = std::strtok(NULL, ",");
-	//std::cout << "azimuth: " << token << std::endl;
-	GSVData.azimuth = atoi(token);
-	//std::cout << "End of readGSVData()" << std::endl;
-}
-
-void GPSDecoder::readGLLData(char* sentence)
-{
-	//std::cout << "In readGLLData: " << sentence << std::endl;
-	//Start toking
-	char* token = std::strtok(sentence, ",");
-	//std::cout << "preambl: " << token << std::endl;
-
-	token = std::strtok(NULL, ",");
-	//std::cout << "GLLLatitude: " << token << std::endl;
-	GLLData.GLLLatitude = token;
-
-	token = std::strtok(NULL, ",");
-	GLLData.GLLLatitude.append(" ");
-	GLLData.GLLLatitude.append(token);
-
-	token = std::strtok(NULL, ",");
-	//std::cout << "GLLLongitude: " << token << std::endl;
-	GLLData.GLLLongitude = token;
-	token = std::strtok(NULL, ",");
-	GLLData.GLLLongitude.append(" ");
-	GLLData.GLLLongitude.append(token);
-
-	token = std::strtok(NULL, ",");
-	//std::cout << "GLLfixTakenAt: " << token << std::endl;
-	GLLData.GLLfixTakenAt = token;
-
-	token = std::strtok(NULL, ",");
-	//std::cout << "dataActive: " << token << std::endl;
-	GLLData.dataActive = token;
-
-}
-
-void GPSDecoder::readRMCData(char* sentence)
-{
-    char* token;
-
-    token = std::strtok(sentence, ",");
-    //std::cout << "preambl: " << token << std::endl;
-
-    token = std::strtok(NULL, ",");
-    //std::cout << "fixTime: " << token << std::endl;
-    RMCData.RMCFixTaken = token;
-
-    token = std::strtok(NULL, ",");
-    //std::cout << "fixTime: " << token << std::endl;
-    RMCData.RMCStatus = token;
-
-		token = std::strtok(NULL, ",");
-		//std::cout << "fixTime: " << token << std::endl;
-		RMCData.RMCLatitude = token;
-		token = std::strtok(NULL, ",");
-		RMCData.RMCLatitude.append(" ");
-		RMCData.RMCLatitude.append(token);
-
-		token = std::strtok(NULL, ",");
-		//std::cout << "fixTime: " << token << std::endl;
-		RMCData.RMCLongitude = token;
-		token = std::strtok(NULL, ",");
-		RMCData.RMCLongitude.append(" ");
-		RMCData.RMCLongitude.append(token);
-
-		token = std::strtok(NULL, ",");
-		//std::cout << "fixTime: " << token << std::endl;
-		RMCData.RMCGNDSpeed = token;
-
-		token = std::strtok(NULL, ",");
-		//std::cout << "fixTime: " << token << std::endl;
-		RMCData.RMCTrackAngle = token;
-
-		token = std::strtok(NULL, ",");
-		// std::cout << "RMCMagneticVar[0]: " << token[0] << std::endl;
-		RMCData.RMCMagneticVar = token[0];
-		// std::cout << "RMCMagneticVar:    " << RMCData.RMCMagneticVar << std::endl;
-}
-
-void GPSDecoder::readTXTData(char* sentence)
-{
-	//start
-  //std::cout << "TXT: " << sentence << std::endl;
-}
-
-void GPSDecoder::readVTGData(char* sentence)
-{
-    char* token;
-
-    token = std::strtok(sentence, ",");
-    //std::cout << "preambl: " << token << std::endl;
-
-    token = std::strtok(NULL, ",");
-    //std::cout << "fixTime: " << token << std::endl;
-    VTGData.VTGTrueTrack = token;
-
-    token = std::strtok(NULL, ",");
-    //std::cout << "fixTime: " << token << std::endl;
-    VTGData.VTGMagTrack = token;
-
-    token = std::strtok(NULL, ",");
-    //std::cout << "fixTime: " << token << std::endl;
-    VTGData.VTGGndSpdKnots = token;
-
-    token = std::strtok(NULL, ",");
-    //std::cout << "fixTime: " << token << std::endl;
-    VTGData.VTGGndSpdkmph = token;
-
-}
-
-int static hex2int(char c)
-{
-    if (c >= '0' && c <= '9')
-        return c - '0';
-    if (c >= 'A' && c <= 'F')
-        return c - 'A' + 10;
-    if (c >= 'a' && c <= 'f')
-        return c - 'a' + 10;
-    return -1;
-}
-
-int GPSDecoder::GPSSentenceCheck(std::string sent)
-{
-	if(sent[0] != '$')
-	{
-		//FAIL
-		return 1;
-	}
-
-
-	if((sent.length() > 83)||(sent.length() < 6))
-	{
-		//std::cout << "GPS too long/short" << std::endl;
-		//std::cout << "sentence: " << sent << std::endl;
-		//FAIL
-		return 1;
-	}
-
-	char checksum = 0;
-	auto it=sent.begin();
-	it++;
-	for(;(*it!='*')&&(*it!=' ')&&(*it!=0);++it)
-	{
-		checksum ^= *it;
-	}
-
-	it++;
-
-	unsigned int cs = (16*hex2int(*it));
-	it++;
-	cs += hex2int(*it);
-
-	//checksum failed
-	if(checksum != cs)
-	{
-		std::cout << "Did not pass checksum" << std::endl;
-		return 1;
-	}
-
-	return 0;
-}
-
-void GPSDecoder::run()
-{
-
-	while(runGPSWorker)
-	{
-		std::string inputString;
-		UARTStream >> inputString;
-
-		if(!GPSSentenceCheck(inputString))
-		{
-		 	crunchGPSSentence(inputString);
-			if(!printKMLtoFile())
-			{
-				std::cout << "printKMLData Failed: " << inputString << std::endl;
-			}
-		}
-		usleep(10);
-	}
-}
-
-void GPSDecoder::printGGA()
-{
-	// Fix quality:
-	// 		0 = invalid
-	// 		1 = GPS fix (SPS)
-	// 		2 = DGPS fix
-	// 		3 = PPS fix
-	// 		4 = Real Time Kinematic
-	// 		5 = Float RTK
-	// 		6 = estimated (dead reckoning) (2.3 feature)
-	// 		7 = Manual input mode
-	// 		8 = Simulation mode
-  std::cout << "GGAData--------------------"
-	 	<< "\nfixTime:\t" << GGAData.GGAfixTime
-		<< "\nlatitude:\t" << GGAData.GGALatitudeNum
-		<< "\nlongitude:\t" << GGAData.GGALongitudeNum
-		<< "\nGPS fix:\t" << GGAData.gps_fix
-    << "\nSatelinte num:\t" << GGAData.satNum
-		<< "\nHorzDOP:\t" << GGAData.horzDOP
-    << "\nAltitude:\t" << GGAData.alt
-		<< "\nHeightOfGeoid:\t" << GGAData.heightOfGeoid
-    << std::endl;
-
-		// std::ofstream file("GPSOutput.txt", std::ios::app);
-		// if(file.is_open())
-		// {
-		// 	//std::cout << "Opened file successfully" << std::endl;
-		// 	file << "GGAData--------------------"
-		// 	 	<< "\nfixTime:\t" << GGAData.GGAfixTime
-		// 		<< "\nlatitude:\t" << GGAData.GGALatitudeNum
-		// 		<< "\nlongitude:\t" << GGAData.GGALongitudeNum
-		// 		<< "\nGPS fix:\t" << GGAData.gps_fix
-		//     << "\nSatelinte num:\t" << GGAData.satNum
-		// 		<< "\nHorzDOP:\t" << GGAData.horzDOP
-		//     << "\nAltitude:\t" << GGAData.alt
-		// 		<< "\nHeightOfGeoid:\t" << GGAData.heightOfGeoid
-		//     << std::endl;
-		//
-		// 	file.close();
-		// }
-		// else
-		// {
-		// 	std::cout << "Cannot open file" << std::endl;
-		// }
-
-}
-
-void GPSDecoder::printGSA()
-{
-	std::cout << "GSAData--------------------"
-		<< "\nautoSelect: " << GSAData.autoSelect
-		<< "\nfixTime: "<< GSAData.GPSFix << std::endl;
-
-		for(int i=0; i<12; i++)
-			std::cout << "PRN[" << i << "]: " << GSAData.PRN[i] << std::endl;
-
-	std::cout
-		<< "PDOP: " << GSAData.PDOP
-		<< "\nHDOP: "<< GSAData.HDOP
-		<< "\nVDOP: " << GSAData.VDOP
-		<< std::endl;
-}
-
-void GPSDecoder::printGSV()
-{
-
-	std::cout << "GSVData--------------------"
-						<< "\nFullDataSentNum: " 	<< GSVData.fullDataSentNum
-						<< "\nsentence: "					<< GSVData.sentence
-						<< "\nsateliteInView: " 	<< GSVData.sateliteInView
-						<< "\nsatPRNNum: " 				<< GSVData.satPRNNum
-						<< "\nelevation: " 				<< GSVData.elevation
-						<< "\nazimuth: " 					<< GSVData.azimuth
-						<< std::endl;
-}
-
-void GPSDecoder::printGLL()
-{
-	std::cout << "GLLData--------------------"
-						<< "\nGLLLatitude: " 			<< GLLData.GLLLatitude
-						<< "\nGLLLongitude: "			<< GLLData.GLLLongitude
-						<< "\nGLLfixTakenAt: "		<< GLLData.GLLfixTakenAt
-						<< "\ndataActive: "				<< GLLData.dataActive
-						<< std::endl;
-}
-
-void GPSDecoder::printRMC()
-{
-	std::cout << "RMCData--------------------"
-						<< "\nRMCFixTaken: " 			<< RMCData.RMCFixTaken
-						<< "\nRMCStatus: "			<< RMCData.RMCStatus
-						<< "\nRMCLatitude: "		<< RMCData.RMCLatitude
-						<< "\nRMCLongitude: "			<< RMCData.RMCLongitude
-						<< "\nRMCGNDSpeed: "			<< RMCData.RMCGNDSpeed
-						<< "\nRMCTrackAngle: "			<< RMCData.RMCTrackAngle
-						<< "\nRMCMagneticVar: "			<< RMCData.RMCMagneticVar
-						<< std::endl;
-}
-
-void GPSDecoder::printTXT()
-{
-	std::cout << "TXTData--------------------\n"
-						<< "To do"
-						// << "\nRMCFixTaken: " 			<< RMCData.RMCFixTaken
-						<< std::endl;
-}
-
-void GPSDecoder::printVTG()
-{
-	std::cout << "RMCData--------------------"
-						<< "\nVTGTrueTrack: " 			<< VTGData.VTGTrueTrack
-						<< "\nVTGMagTrack: "			<< VTGData.VTGMagTrack
-						<< "\nVTGGndSpdKnots: "		<< VTGData.VTGGndSpdKnots
-						<< "\nVTGGndSpdkmph: "			<< VTGData.VTGGndSpdkmph
-						<< std::endl;
-}
+#include "GPSDecoder.h"
+#include "GPSEventLoop.h"
+
+#include <cerrno>
+#include <poll.h>
+
+template<typename R, R (GPSDecoder::*Method)(const NMEAFields&)>
+static void decoderHandler(const NMEAFields& fields, void* decoder)
+{
+	(static_cast<GPSDecoder*>(decoder)->*Method)(fields);
+}
+
+static void readTalker(const NMEAFields& fields, NMEATalker& talker)
+{
+	std::string_view talkerID, type;
+	nmeaSplitAddress(fields[0], talkerID, type);
+	talker.set(talkerID);
+}
+
+//the group NAV-SAT tables replace in the satellite tracker
+static NMEATalker UBXTalker()
+{
+	NMEATalker talker;
+	talker.set("UB");
+	return talker;
+}
+
+GPSDecoder::GPSDecoder(std::string UARTStr){
+
+	parseSourceSpec(UARTStr, sourceConfig);
+	registerDefaultHandlers();
+}
+
+GPSDecoder::GPSDecoder(const GPSSourceConfig& config)
+	: sourceConfig(config)
+{
+	registerDefaultHandlers();
+}
+
+void GPSDecoder::registerDefaultHandlers()
+{
+	epochs.addListener(fixAssembled, this);
+	KMLSimplifier.setOutput(KMLSimplified, this);
+
+	dispatcher.add(nmeaSentenceKey("GGA"), decoderHandler<int, &GPSDecoder::readGGAData>, this);
+	dispatcher.add(nmeaSentenceKey("GSA"), decoderHandler<void, &GPSDecoder::readGSAData>, this);
+	dispatcher.add(nmeaSentenceKey("GSV"), decoderHandler<void, &GPSDecoder::readGSVData>, this);
+	dispatcher.add(nmeaSentenceKey("GLL"), decoderHandler<void, &GPSDecoder::readGLLData>, this);
+	dispatcher.add(nmeaSentenceKey("RMC"), decoderHandler<void, &GPSDecoder::readRMCData>, this);
+	dispatcher.add(nmeaSentenceKey("TXT"), decoderHandler<void, &GPSDecoder::readTXTData>, this);
+	dispatcher.add(nmeaSentenceKey("VTG"), decoderHandler<void, &GPSDecoder::readVTGData>, this);
+}
+
+GPSDecoder::~GPSDecoder(){
+		if(source)
+			source->close();
+		closeFile();
+		closeTrackLog();
+		closeSinks();
+}
+
+int GPSDecoder::initDecoder()
+{
+	int ret = 0;
+	ret = initFiles();
+	ret += initGPS();
+	if(ret == 2)
+		return 1;
+	else
+		return 0;
+}
+
+int GPSDecoder::initGPS()
+{
+
+	source = makeInputSource(sourceConfig);
+
+	if(source && source->open())
+		return 1;
+	else
+		return 0;
+}
+
+int GPSDecoder::initFiles()
+{
+	//initialize the KML file
+	if(KMLWriter.open(KMLConfig))
+	{
+		KMLOutputEnabled = true;
+		return 1;
+	}
+	return 0;
+}
+
+void GPSDecoder::printKMLtoConsole()
+{
+	std::cout << "print KML "
+	<< GGAData.GGALongitudeNum << ","
+	<< GGAData.GGALatitudeNum << "," << 0
+	<< std::endl;
+}
+
+int GPSDecoder::printKMLtoFile(const GPSFix& fix)
+{
+	if((fix.quality == 1) || (fix.quality == 2))
+	{
+		if(!KMLSimplifier.getConfig().enabled())
+			return KMLWriter.add(fix);
+
+		KMLSimplifier.add(fix);
+		return 1;
+	}
+	else
+		return 0;
+}
+
+void GPSDecoder::KMLSimplified(const GPSFix& fix, void* decoder)
+{
+	static_cast<GPSDecoder*>(decoder)->KMLWriter.add(fix);
+}
+
+void GPSDecoder::closeFile()
+{
+	KMLSimplifier.flush();
+	KMLWriter.close();
+	KMLOutputEnabled = false;
+}
+
+int GPSDecoder::initTrackLog(const std::string& path)
+{
+	return trackLog.open(path);
+}
+
+void GPSDecoder::closeTrackLog()
+{
+	trackLog.close();
+}
+
+void GPSDecoder::crunchGPSSentence(const std::string& inputString)
+{
+	crunchGPSSentence(inputString.data(), inputString.length());
+}
+
+void GPSDecoder::crunchGPSSentence(const char* sentence, size_t length)
+{
+	NMEAFields fields(sentence, length);
+	dispatcher.dispatch(fields);
+}
+
+bool GPSDecoder::registerSentenceHandler(std::string_view type, NMEASentenceHandler handler, void* context)
+{
+	return dispatcher.add(nmeaSentenceKey(type), handler, context);
+}
+
+int GPSDecoder::readGGAData(const NMEAFields& fields)
+{
+	readTalker(fields, GGAData.talker);
+	nmeaParseTime(fields[1], GGAData.GGAfixTime);
+
+	bool position = nmeaParseCoordinate(fields[2], fields[3], GGAData.GGALatitudeNum);
+	nmeaParseCoordinate(fields[4], fields[5], GGAData.GGALongitudeNum);
+
+	GGAData.gps_fix = nmeaInt(fields[6]);
+	GGAData.satNum = nmeaInt(fields[7]);
+	GGAData.horzDOP = nmeaDecimal(fields[8]);
+	GGAData.alt = nmeaDecimal(fields[9]);
+	GGAData.heightOfGeoid = nmeaDecimal(fields[11]);
+
+	//a GGA without a position still closes the epoch
+	epochs.addGGA(GGAData);
+
+	if(!position)
+	{
+		stats.noPosition.add();
+		return 1;
+	}
+	return 0;
+}
+
+void GPSDecoder::readGSAData(const NMEAFields& fields)
+{
+	readTalker(fields, GSAData.talker);
+	GSAData.autoSelect = fields.firstChar(1);
+	GSAData.GPSFix = nmeaInt(fields[2]);
+
+	//empty PRN slots read as 0
+	for(int i=0; i< 12; i++)
+		GSAData.PRN[i] = nmeaInt(fields[3+i]);
+
+	GSAData.PDOP = nmeaDecimal(fields[15]);
+	GSAData.HDOP = nmeaDecimal(fields[16]);
+	GSAData.VDOP = nmeaDecimal(fields[17]);
+
+	epochs.addGSA(GSAData);
+}
+
+void GPSDecoder::readGSVData(const NMEAFields& fields)
+{
+	readTalker(fields, GSVData.talker);
+	GSVData.fullDataSentNum = nmeaInt(fields[1]);
+	GSVData.sentence = nmeaInt(fields[2]);
+	GSVData.sateliteInView = nmeaInt(fields[3]);
+
+	//up to four satellites of PRN, elevation, azimuth, SNR; an NMEA 4.1
+	//signal ID may follow
+	GSVData.satCount = 0;
+	for(int i = 0; (i < 4) && (7 + 4*i < fields.count()); i++)
+	{
+		int n = GSVData.satCount++;
+		GSVData.satPRNNum[n] = nmeaInt(fields[4 + 4*i]);
+		GSVData.elevation[n] = nmeaInt(fields[5 + 4*i]);
+		GSVData.azimuth[n] = nmeaInt(fields[6 + 4*i]);
+		GSVData.SNR[n] = nmeaInt(fields[7 + 4*i]);
+	}
+
+	satellites.add(GSVData);
+	epochs.addGSV(GSVData);
+}
+
+void GPSDecoder::readGLLData(const NMEAFields& fields)
+{
+	readTalker(fields, GLLData.talker);
+	nmeaParseCoordinate(fields[1], fields[2], GLLData.GLLLatitude);
+	nmeaParseCoordinate(fields[3], fields[4], GLLData.GLLLongitude);
+	nmeaParseTime(fields[5], GLLData.GLLfixTakenAt);
+	GLLData.dataActive = fields.firstChar(6);
+
+	epochs.addGLL(GLLData);
+}
+
+void GPSDecoder::readRMCData(const NMEAFields& fields)
+{
+	readTalker(fields, RMCData.talker);
+	nmeaParseTime(fields[1], RMCData.RMCFixTaken);
+	RMCData.RMCStatus = fields.firstChar(2);
+
+	nmeaParseCoordinate(fields[3], fields[4], RMCData.RMCLatitude);
+	nmeaParseCoordinate(fields[5], fields[6], RMCData.RMCLongitude);
+
+	RMCData.RMCGNDSpeed = nmeaDecimal(fields[7]);
+	RMCData.RMCTrackAngle = nmeaDecimal(fields[8]);
+	nmeaParseDate(fields[9], RMCData.RMCDate);
+
+	RMCData.RMCMagneticVar = nmeaDecimal(fields[10]);
+	if(fields.firstChar(11) == 'W')
+		RMCData.RMCMagneticVar *= -1;
+
+	epochs.addRMC(RMCData);
+}
+
+void GPSDecoder::readTXTData(const NMEAFields&)
+{
+	//start
+}
+
+void GPSDecoder::readVTGData(const NMEAFields& fields)
+{
+	readTalker(fields, VTGData.talker);
+	VTGData.VTGTrueTrack = nmeaDecimal(fields[1]);
+	VTGData.VTGMagTrack = nmeaDecimal(fields[3]);
+	VTGData.VTGGndSpdKnots = nmeaDecimal(fields[5]);
+	VTGData.VTGGndSpdkmph = nmeaDecimal(fields[7]);
+
+	epochs.addVTG(VTGData);
+}
+
+int GPSDecoder::GPSSentenceCheck(const std::string& sent)
+{
+	return GPSSentenceCheck(sent.data(), sent.length());
+}
+
+enum FrameCheck
+{
+	FRAME_OK,
+	FRAME_MALFORMED,
+	FRAME_CHECKSUM
+};
+
+static FrameCheck checkFrame(const char* sent, size_t length, size_t maxLength)
+{
+	if((length == 0) || ((sent[0] != '$') && (sent[0] != '!')))
+		return FRAME_MALFORMED;
+
+	if((length > maxLength)||(length < 6))
+		return FRAME_MALFORMED;
+
+	//never read past the end, even when the '*' is missing
+	const char* star = (const char*)memchr(sent, '*', length);
+	if((star == nullptr) || (star + 2 >= sent + length))
+		return FRAME_MALFORMED;
+
+	unsigned int checksum = nmeaChecksum(sent + 1, star - sent - 1);
+	int cs = nmeaHexByte(star[1], star[2]);
+
+	if((cs < 0) || (checksum != (unsigned int)cs))
+		return FRAME_CHECKSUM;
+
+	return FRAME_OK;
+}
+
+int GPSDecoder::GPSSentenceCheck(const char* sent, size_t length)
+{
+	//0 passes, 1 fails
+	return (checkFrame(sent, length, 83) == FRAME_OK) ? 0 : 1;
+}
+
+void GPSDecoder::setSentenceCallback(GPSSentenceCallback callback, void* context)
+{
+	sentenceCallback = callback;
+	sentenceContext = context;
+}
+
+void GPSDecoder::setUBXCallback(GPSUBXCallback callback, void* context)
+{
+	UBXCallback = callback;
+	UBXContext = context;
+}
+
+int GPSDecoder::decodeFrame(const char* frame, size_t length)
+{
+	if((uint8_t)frame[0] == UBX_SYNC1)
+		return decodeUBX(frame, length);
+
+	//drop the line ending
+	while((length > 0) && ((frame[length-1] == '\r') || (frame[length-1] == '\n')))
+		length--;
+
+	stats.frames.add();
+	//the framer has already held it to its length limit
+	FrameCheck check = checkFrame(frame, length, NMEAFramer::BUFFER_SIZE);
+	if(check != FRAME_OK)
+	{
+		if(check == FRAME_CHECKSUM)
+			stats.checksumFailures.add();
+		else
+			stats.malformed.add();
+		return 0;
+	}
+	stats.sentences.add();
+
+	if(sinks.wantsSentences())
+		sinks.pushSentence(frame, length);
+
+	NMEAFields fields(frame, length);
+	stats.types.add(fields[0]);
+	dispatcher.dispatch(fields);
+
+	if(sentenceCallback)
+		sentenceCallback(*this, fields, sentenceContext);
+	return 1;
+}
+
+int GPSDecoder::decodeUBX(const char* frame, size_t length)
+{
+	//the framer has checked sync, length and checksum already
+	const uint8_t* bytes = (const uint8_t*)frame;
+	uint8_t msgClass = bytes[2];
+	uint8_t msgID = bytes[3];
+	const uint8_t* payload = bytes + UBX_HEADER_LENGTH;
+	size_t payloadLength = length - UBX_HEADER_LENGTH - UBX_CHECKSUM_LENGTH;
+
+	const char* name = ubxMessageName(msgClass, msgID);
+	stats.types.add(name ? name : "UBX");
+
+	if((msgClass == UBX_NAV) && (msgID == UBX_NAV_PVT))
+	{
+		GPSFix fix;
+		if(!ubxParseNavPVT(payload, payloadLength, fix))
+		{
+			stats.malformed.add();
+			return 0;
+		}
+		fix.satellitesInView = satellites.table().count;
+		epochs.addFix(fix);
+	}
+	else if((msgClass == UBX_NAV) && (msgID == UBX_NAV_SAT))
+	{
+		GPSSatTable table;
+		if(!ubxParseNavSat(payload, payloadLength, table))
+		{
+			stats.malformed.add();
+			return 0;
+		}
+		satellites.replace(UBXTalker(), table);
+	}
+
+	if(UBXCallback)
+		UBXCallback(*this, msgClass, msgID, payload, payloadLength, UBXContext);
+	return 1;
+}
+
+int GPSDecoder::sendToReceiver(const std::string& bytes)
+{
+	if(!source || !source->isOpen())
+		return 0;
+
+	//the source is non-blocking, wait briefly when the tty buffer is full
+	size_t sent = 0;
+	while(sent < bytes.size())
+	{
+		ssize_t n = source->write(bytes.data() + sent, bytes.size() - sent);
+		if(n > 0)
+		{
+			sent += n;
+			continue;
+		}
+
+		struct pollfd writable = {source->fd(), POLLOUT, 0};
+		if((n < 0) && ((errno == EAGAIN) || (errno == EINTR)) && (::poll(&writable, 1, 100) > 0))
+			continue;
+		return 0;
+	}
+	return 1;
+}
+
+int GPSDecoder::sendUBX(uint8_t msgClass, uint8_t msgID, const uint8_t* payload, size_t length)
+{
+	std::string frame;
+	ubxAppendMessage(frame, msgClass, msgID, payload, length);
+	return sendToReceiver(frame);
+}
+
+int GPSDecoder::configureUBX(const GPSUBXConfig& config)
+{
+	std::string messages = ubxConfigMessages(config);
+	if(messages.empty())
+		return 0;
+	return sendToReceiver(messages);
+}
+
+size_t GPSDecoder::decode(const char* data, size_t length)
+{
+	//one clock read per chunk, every sentence in it arrived together
+	stats.bytes.add(length);
+	epochs.setArrival(std::chrono::steady_clock::now());
+
+	framesPassed = 0;
+	framer.feed(data, length, frameReady, this);
+	return framesPassed;
+}
+
+void GPSDecoder::frameReady(const char* frame, size_t length, void* decoder)
+{
+	GPSDecoder* self = static_cast<GPSDecoder*>(decoder);
+	self->framesPassed += self->decodeFrame(frame, length);
+}
+
+void GPSDecoder::run()
+{
+	GPSEventLoop loop;
+	if(!loop.add(source.get(), this))
+		return;
+
+	//the timeout only bounds how long a stop() goes unnoticed
+	while(runGPSWorker && (loop.activeSources() > 0))
+	{
+		if(loop.runOnce(100) < 0)
+			break;
+	}
+}
+
+bool GPSDecoder::inSyncWith(const GPSDecoder& other) const
+{
+	return framer.idle() && other.framer.idle()
+		&& epochs.sameState(other.epochs) && satellites.sameState(other.satellites);
+}
+
+size_t GPSDecoder::flush()
+{
+	//a last frame without a line ending is still a frame
+	framesPassed = 0;
+	framer.finish(frameReady, this);
+
+	epochs.flush();
+	return framesPassed;
+}
+
+void GPSDecoder::poll()
+{
+	if(epochs.pending())
+		epochs.poll(std::chrono::steady_clock::now());
+}
+
+int GPSDecoder::addFixListener(GPSFixCallback callback, void* context)
+{
+	return epochs.addListener(callback, context);
+}
+
+void GPSDecoder::removeFixListener(GPSFixCallback callback, void* context)
+{
+	epochs.removeListener(callback, context);
+}
+
+void GPSDecoder::fixAssembled(const GPSFix& fix, void* decoder)
+{
+	GPSDecoder* self = static_cast<GPSDecoder*>(decoder);
+	auto arrival = self->epochs.lastArrival();
+
+	//rejected fixes go no further than the snapshot, which flags them
+	GPSFix filtered;
+	const GPSFix* out = &fix;
+	bool pass = true;
+	if(self->fixFilter.getConfig().enabled())
+	{
+		pass = (self->fixFilter.add(fix, filtered) == FILTER_ACCEPTED);
+		out = &filtered;
+	}
+
+	if(pass)
+	{
+		if(self->KMLOutputEnabled)
+			self->printKMLtoFile(*out);
+
+		if(self->trackLog.isOpen() && out->valid())
+			self->trackLog.add(*out);
+
+		self->motion.add(*out);
+	}
+
+	self->stats.inputToFix.record(std::chrono::steady_clock::now() - arrival);
+	if(pass)
+		self->sinks.pushFix(*out, arrival);
+
+	self->publishSnapshot(pass ? *out : fix, !pass);
+}
+
+void GPSDecoder::publishSnapshot(const GPSFix& fix, bool rejected)
+{
+	GPSSnapshot snap;
+	snap.epoch = snapshots.count() + 1;
+	snap.fix = fix;
+	snap.rejected = rejected;
+	snap.GGAData = GGAData;
+	snap.GSAData = GSAData;
+	snap.GSVData = GSVData;
+	snap.GLLData = GLLData;
+	snap.RMCData = RMCData;
+	snap.VTGData = VTGData;
+	snap.satellites = satellites.table();
+	snap.motion = motion.motion();
+	snapshots.publish(snap);
+}
+
+void GPSDecoder::readStats(GPSStatsSnapshot& out) const
+{
+	out.bytes = stats.bytes.get();
+	out.frames = stats.frames.get();
+	out.sentences = stats.sentences.get();
+	out.checksumFailures = stats.checksumFailures.get();
+	out.malformed = stats.malformed.get();
+	out.truncated = framer.truncated();
+	out.overlong = framer.overlong();
+	out.droppedBytes = framer.droppedBytes();
+	out.noPosition = stats.noPosition.get();
+	out.ubxFrames = framer.ubxFrames();
+	out.ubxChecksumFailures = framer.ubxChecksumFailures();
+
+	out.epochs = epochs.fixCount();
+	out.partialEpochs = epochs.partialCount();
+	out.sinkDrops = sinks.dropped();
+	out.KMLDrops = KMLWriter.droppedCount();
+	out.fixesRejected = fixFilter.rejected();
+
+	out.types.clear();
+	for(int i = 0; i < stats.types.types(); i++)
+		out.types.push_back(std::make_pair(stats.types.address(i), stats.types.count(i)));
+	out.otherTypes = stats.types.other();
+
+	stats.inputToFix.read(out.inputToFix);
+	sinks.latency(out.inputToSink);
+}
+
+GPSSnapshot GPSDecoder::snapshot() const
+{
+	GPSSnapshot snap;
+	snapshots.read(snap);
+	return snap;
+}
+
+void GPSDecoder::printGGA()
+{
+	printGGA(snapshot());
+}
+
+void GPSDecoder::printGGA(const GPSSnapshot& snap)
+{
+	// Fix quality:
+	// 		0 = invalid
+	// 		1 = GPS fix (SPS)
+	// 		2 = DGPS fix
+	// 		3 = PPS fix
+	// 		4 = Real Time Kinematic
+	// 		5 = Float RTK
+	// 		6 = estimated (dead reckoning) (2.3 feature)
+	// 		7 = Manual input mode
+	// 		8 = Simulation mode
+	std::cout.precision(10);
+  std::cout << "GGAData--------------------"
+		<< "\ntalker:\t\t" << snap.GGAData.talker.view()
+	 	<< "\nfixTime:\t" << snap.GGAData.GGAfixTime
+		<< "\nlatitude:\t" << snap.GGAData.GGALatitudeNum
+		<< "\nlongitude:\t" << snap.GGAData.GGALongitudeNum
+		<< "\nGPS fix:\t" << snap.GGAData.gps_fix
+    << "\nSatelinte num:\t" << snap.GGAData.satNum
+		<< "\nHorzDOP:\t" << snap.GGAData.horzDOP
+    << "\nAltitude:\t" << snap.GGAData.alt
+		<< "\nHeightOfGeoid:\t" << snap.GGAData.heightOfGeoid
+    << std::endl;
+
+		// std::ofstream file("GPSOutput.txt", std::ios::app);
+		// if(file.is_open())
+		// {
+		// 	//std::cout << "Opened file successfully" << std::endl;
+		// 	file << "GGAData--------------------"
+		// 	 	<< "\nfixTime:\t" << snap.GGAData.GGAfixTime
+		// 		<< "\nlatitude:\t" << snap.GGAData.GGALatitudeNum
+		// 		<< "\nlongitude:\t" << snap.GGAData.GGALongitudeNum
+		// 		<< "\nGPS fix:\t" << snap.GGAData.gps_fix
+		//     << "\nSatelinte num:\t" << snap.GGAData.satNum
+		// 		<< "\nHorzDOP:\t" << snap.GGAData.horzDOP
+		//     << "\nAltitude:\t" << snap.GGAData.alt
+		// 		<< "\nHeightOfGeoid:\t" << snap.GGAData.heightOfGeoid
+		//     << std::endl;
+		//
+		// 	file.close();
+		// }
+		// else
+		// {
+		// 	std::cout << "Cannot open file" << std::endl;
+		// }
+
+}
+
+void GPSDecoder::printGSA()
+{
+	printGSA(snapshot());
+}
+
+void GPSDecoder::printGSA(const GPSSnapshot& snap)
+{
+	std::cout << "GSAData--------------------"
+		<< "\ntalker: " << snap.GSAData.talker.view()
+		<< "\nautoSelect: " << snap.GSAData.autoSelect
+		<< "\nfixTime: "<< snap.GSAData.GPSFix << std::endl;
+
+		for(int i=0; i<12; i++)
+			std::cout << "PRN[" << i << "]: " << snap.GSAData.PRN[i] << std::endl;
+
+	std::cout
+		<< "PDOP: " << snap.GSAData.PDOP
+		<< "\nHDOP: "<< snap.GSAData.HDOP
+		<< "\nVDOP: " << snap.GSAData.VDOP
+		<< std::endl;
+}
+
+void GPSDecoder::printGSV()
+{
+	printGSV(snapshot());
+}
+
+void GPSDecoder::printGSV(const GPSSnapshot& snap)
+{
+
+	std::cout << "GSVData--------------------"
+						<< "\ntalker: "				<< snap.GSVData.talker.view()
+						<< "\nFullDataSentNum: " 	<< snap.GSVData.fullDataSentNum
+						<< "\nsentence: "					<< snap.GSVData.sentence
+						<< "\nsateliteInView: " 	<< snap.GSVData.sateliteInView
+						<< "\ntracked: "					<< snap.satellites.tracked() << "/" << snap.satellites.count
+						<< "\nmeanSNR: "					<< snap.satellites.meanSNR()
+						<< std::endl;
+
+	const GPSSatTable& sats = snap.satellites;
+	for(int i = 0; i < sats.count; i++)
+	{
+		std::cout << std::setw(8) << gpsConstellationName(sats.constellation[i])
+							<< " PRN " << std::setw(3) << sats.prn[i]
+							<< " el " << std::setw(2) << (int)sats.elevation[i]
+							<< " az " << std::setw(3) << sats.azimuth[i]
+							<< " SNR " << std::setw(2) << (int)sats.SNR[i]
+							<< std::endl;
+	}
+}
+
+void GPSDecoder::printGLL()
+{
+	printGLL(snapshot());
+}
+
+void GPSDecoder::printGLL(const GPSSnapshot& snap)
+{
+	std::cout << "GLLData--------------------"
+						<< "\ntalker: "				<< snap.GLLData.talker.view()
+						<< "\nGLLLatitude: " 			<< snap.GLLData.GLLLatitude
+						<< "\nGLLLongitude: "			<< snap.GLLData.GLLLongitude
+						<< "\nGLLfixTakenAt: "		<< snap.GLLData.GLLfixTakenAt
+						<< "\ndataActive: "				<< snap.GLLData.dataActive
+						<< std::endl;
+}
+
+void GPSDecoder::printRMC()
+{
+	printRMC(snapshot());
+}
+
+void GPSDecoder::printRMC(const GPSSnapshot& snap)
+{
+	std::cout << "RMCData--------------------"
+						<< "\ntalker: "				<< snap.RMCData.talker.view()
+						<< "\nRMCFixTaken: " 			<< snap.RMCData.RMCFixTaken
+						<< "\nRMCStatus: "			<< snap.RMCData.RMCStatus
+						<< "\nRMCLatitude: "		<< snap.RMCData.RMCLatitude
+						<< "\nRMCLongitude: "			<< snap.RMCData.RMCLongitude
+						<< "\nRMCGNDSpeed: "			<< snap.RMCData.RMCGNDSpeed
+						<< "\nRMCTrackAngle: "			<< snap.RMCData.RMCTrackAngle
+						<< "\nRMCDate: "			<< snap.RMCData.RMCDate
+						<< "\nRMCMagneticVar: "			<< snap.RMCData.RMCMagneticVar
+						<< std::endl;
+}
+
+void GPSDecoder::printTXT()
+{
+	printTXT(snapshot());
+}
+
+void GPSDecoder::printTXT(const GPSSnapshot&)
+{
+	std::cout << "TXTData--------------------\n"
+						<< "To do"
+						// << "\nRMCFixTaken: " 			<< snap.RMCData.RMCFixTaken
+						<< std::endl;
+}
+
+void GPSDecoder::printVTG()
+{
+	printVTG(snapshot());
+}
+
+void GPSDecoder::printVTG(const GPSSnapshot& snap)
+{
+	std::cout << "VTGData--------------------"
+						<< "\ntalker: "				<< snap.VTGData.talker.view()
+						<< "\nVTGTrueTrack: " 			<< snap.VTGData.VTGTrueTrack
+						<< "\nVTGMagTrack: "			<< snap.VTGData.VTGMagTrack
+						<< "\nVTGGndSpdKnots: "		<< snap.VTGData.VTGGndSpdKnots
+						<< "\nVTGGndSpdkmph: "			<< snap.VTGData.VTGGndSpdkmph
+						<< std::endl;
+}
@@ -1,228 +1,260 @@
-#pragma once
-
-#include <iostream>
-#include <fstream>
-#include <string>
-#include <cstring>
-#include <vector>
-#include <SerialStream.h>
-
-#include <iomanip>
-
-using namespace LibSerial;
-
-// GGA - essential fix data which provide 3D location and accuracy data.
-//
-//  $GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47
-//
-// Where:
-//      GGA          Global Positioning System Fix Data
-//      123519       Fix taken at 12:35:19 UTC
-//      4807.038,N   Latitude 48 deg 07.038' N
-//      01131.000,E  Longitude 11 deg 31.000' E
-//      1            Fix quality: 0 = invalid
-//                                1 = GPS fix (SPS)
-//                                2 = DGPS fix
-//                                3 = PPS fix
-// 			       4 = Real Time Kinematic
-// 			       5 = Float RTK
-//                                6 = estimated (dead reckoning) (2.3 feature)
-// 			       7 = Manual input mode
-// 			       8 = Simulation mode
-//      08           Number of satellites being tracked
-//      0.9          Horizontal dilution of position
-//      545.4,M      Altitude, Meters, above mean sea level
-//      46.9,M       Height of geoid (mean sea level) above WGS84
-//                       ellipsoid
-//      (empty field) time in seconds since last DGPS update
-//      (empty field) DGPS station ID number
-//      *47          the checksum data, always begins with *
-
-struct GGAStruct
-{
-	std::string GGAfixTime;
-	std::string GGALatitude;
-	std::string GGALongitude;
-	float GGALatitudeNum = 0;
-	float GGALongitudeNum = 0;
-	int gps_fix = 0;
-	int satNum = 0;
-	float horzDOP = 0;
-	float alt = 0;
-	float heightOfGeoid = 0;
-	int empty1;
-	int empty2;
-};
-
-// $GPGLL,4916.45,N,12311.12,W,225444,A,*1D
-//
-// Where:
-// 	 GLL          Geographic position, Latitude and Longitude
-// 	 4916.46,N    Latitude 49 deg. 16.45 min. North
-// 	 12311.12,W   Longitude 123 deg. 11.12 min. West
-// 	 225444       Fix taken at 22:54:44 UTC
-// 	 A            Data Active or V (void)
-// 	 *iD          checksum data
-
-struct GLLStruct
-{
-	std::string GLLLatitude;
-	std::string GLLLongitude;
-	std::string GLLfixTakenAt;
-	std::string dataActive;
-};
-
-// $GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39
-//
-// Where:
-// 	 GSA      Satellite status
-// 	 A        Auto selection of 2D or 3D fix (M = manual)
-// 	 3        3D fix - values include: 1 = no fix
-// 																		 2 = 2D fix
-// 																		 3 = 3D fix
-// 	 04,05... PRNs of satellites used for fix (space for 12)
-// 	 2.5      PDOP (dilution of precision)
-// 	 1.3      Horizontal dilution of precision (HDOP)
-// 	 2.1      Vertical dilution of precision (VDOP)
-// 	 *39      the checksum data, always begins with *
-
-struct GSAStruct
-{
-	std::string autoSelect;
-	int GPSFix = 0;
-	std::vector<int> PRN;
-	float PDOP = 0;
-	float HDOP = 0;
-	float VDOP = 0;
-};
-
-// $GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45*75
-//
-// Where:
-// 		GSV          Satellites in view
-// 		2            Number of sentences for full data
-// 		1            sentence 1 of 2
-// 		08           Number of satellites in view
-//
-// 		01           Satellite PRN number
-// 		40           Elevation, degrees
-// 		083          Azimuth, degrees
-// 		46           SNR - higher is better
-// 				 for up to 4 satellites per sentence
-// 		*75          the checksum data, always begins with *
-
-struct GSVStruct
-{
-	int fullDataSentNum = 0;
-	int sentence = 0;
-	int sateliteInView = 0;
-	int satPRNNum = 0;
-	int elevation = 0;
-	int azimuth = 0;
-};
-
-// $GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A
-//
-// Where:
-//      RMC          Recommended Minimum sentence C
-//      123519       Fix taken at 12:35:19 UTC
-//      A            Status A=active or V=Void.
-//      4807.038,N   Latitude 48 deg 07.038' N
-//      01131.000,E  Longitude 11 deg 31.000' E
-//      022.4        Speed over the ground in knots
-//      084.4        Track angle in degrees True
-//      230394       Date - 23rd of March 1994
-//      003.1,W      Magnetic Variation
-//      *6A          The checksum data, always begins with *
-
-struct RMCStruct
-{
-	std::string RMCFixTaken;
-	std::string RMCStatus;
-	std::string RMCLatitude;
-	std::string RMCLongitude;
-	std::string RMCGNDSpeed;
-	std::string RMCTrackAngle;
-	std::string RMCMagneticVar;
-};
-
-// VTG - Velocity made good. The gps receiver may use the LC prefix instead of GP if it is emulating Loran output.
-//
-//   $GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48
-//
-// where:
-//         VTG          Track made good and ground speed
-//         054.7,T      True track made good (degrees)
-//         034.4,M      Magnetic track made good
-//         005.5,N      Ground speed, knots
-//         010.2,K      Ground speed, Kilometers per hour
-//         *48          Checksum
-
-struct VTGStruct
-{
-	std::string VTGTrueTrack;
-	std::string VTGMagTrack;
-	std::string VTGGndSpdKnots;
-	std::string VTGGndSpdkmph;
-};
-
-
-class GPSDecoder
-{
-public:
-	GPSDecoder(std::string);
-	~GPSDecoder();
-
-	int initDecoder();
-	int initGPS();
-	int initFiles();
-	void closeFile();
-
-	int GPSSentenceCheck(std::string);
-
-	void printGGA();
-	void printGSA();
-	void printGSV();
-	void printGLL();
-	void printRMC();
-	void printTXT();
-	void printVTG();
-
-	void printKMLtoConsole();
-	int printKMLtoFile();
-
-	void readFFFData(char*);
-	int readGGAData(char*);
-	void readGSAData(char*);
-	void readGSVData(char*);
-	void readGLLData(char*);
-	void readRMCData(char*);
-	void readTXTData(char*);
-	void readVTGData(char*);
-	void crunchGPSSentence(std::string);
-
-	void run();
-
-	GGAStruct GGAData;
-	GSAStruct GSAData;
-	GSVStruct GSVData;
-	GLLStruct GLLData;
-	RMCStruct RMCData;
-//	TXTStruct TXTData;
-	VTGStruct VTGData;
-
-	int iterator = 0;
-	bool runGPSWorker = true;
-	bool file_init = true;
-	bool cleared_buffer=false;
-	bool GPSClosed = false;
-
-
-private:
-	std::ofstream file;
-
-	std::string UARTStr = "/dev/ttyACM0";
-	std::string KMLOutputStr = "KMLOutput.kml";
-
-	SerialStream UARTStream;
-};
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include "GPSEpochAssembler.h"
+#include "GPSFilter.h"
+#include "GPSGeodesy.h"
+#include "GPSInputSource.h"
+#include "GPSKMLWriter.h"
+#include "GPSSatellites.h"
+#include "GPSSentences.h"
+#include "GPSSeqLock.h"
+#include "GPSSimplify.h"
+#include "GPSSink.h"
+#include "GPSStats.h"
+#include "GPSTrackLog.h"
+#include "GPSUBX.h"
+#include "NMEADispatch.h"
+#include "NMEAFields.h"
+#include "NMEAFramer.h"
+#include "NMEANumeric.h"
+#include "NMEAScan.h"
+
+#include <iomanip>
+
+// Everything the decoder knows, copied out as one consistent unit. The
+// worker publishes a snapshot each time an epoch is assembled into a fix
+// and any thread can read the latest one without locking.
+struct GPSSnapshot
+{
+	uint64_t epoch = 0;
+	// As passed by the fix filter, smoothed when it smooths. A fix the
+	// filter rejected is kept as received, with rejected set.
+	GPSFix fix;
+	bool rejected = false;
+
+	GGAStruct GGAData;
+	GSAStruct GSAData;
+	GSVStruct GSVData;
+	GLLStruct GLLData;
+	RMCStruct RMCData;
+	VTGStruct VTGData;
+
+	GPSSatTable satellites;
+
+	// Distance, smoothed speed and heading and local position as of this
+	// fix, see GPSMotionTracker.
+	GPSMotion motion;
+};
+
+class GPSDecoder;
+
+typedef void (*GPSSentenceCallback)(GPSDecoder& decoder, const NMEAFields& fields, void* context);
+typedef void (*GPSUBXCallback)(GPSDecoder& decoder, uint8_t msgClass, uint8_t msgID, const uint8_t* payload, size_t length, void* context);
+
+class GPSDecoder
+{
+public:
+	GPSDecoder(std::string);
+	GPSDecoder(const GPSSourceConfig&);
+	~GPSDecoder();
+
+	int initDecoder();
+	int initGPS();
+	// Where initFiles() writes the KML track. Default KMLOutput.kml.
+	void setKMLOutput(const GPSKMLConfig& config) { KMLConfig = config; }
+	// Smoothing for GPSSnapshot::motion, and the origin of its ENU frame
+	// when the first fix should not be.
+	void setMotionConfig(const GPSMotionConfig& config) { motion.setConfig(config); }
+	void setMotionOrigin(double latitude, double longitude, double height) { motion.setOrigin(latitude, longitude, height); }
+	// Drops implausible fixes, and smooths the rest, before they reach the
+	// KML track, the track log, the sinks and GPSSnapshot::motion. The
+	// snapshot's fix is the filtered one, or flagged rejected. Off by
+	// default.
+	void setFixFilter(const GPSFilterConfig& config) { fixFilter.setConfig(config); }
+	// Thins the KML track before it is written. Off by default.
+	void setKMLSimplify(const GPSSimplifyConfig& config) { KMLSimplifier.setConfig(config); }
+	int initFiles();
+	void closeFile();
+
+	// Fixes and sentences are also handed to every sink added here, on a
+	// thread of their own, see GPSSink.h and GPSFileSinks.h.
+	int addSink(std::unique_ptr<GPSSink> sink) { return sinks.add(std::move(sink)); }
+	void closeSinks() { sinks.close(); }
+	uint64_t sinkDrops() const { return sinks.dropped(); }
+
+	// Also writes every valid fix to a binary track log, see GPSTrackLog.h.
+	int initTrackLog(const std::string& path);
+	void closeTrackLog();
+
+	int GPSSentenceCheck(const std::string&);
+	int GPSSentenceCheck(const char*, size_t);
+
+	void printGGA();
+	void printGGA(const GPSSnapshot&);
+	void printGSA();
+	void printGSA(const GPSSnapshot&);
+	void printGSV();
+	void printGSV(const GPSSnapshot&);
+	void printGLL();
+	void printGLL(const GPSSnapshot&);
+	void printRMC();
+	void printRMC(const GPSSnapshot&);
+	void printTXT();
+	void printTXT(const GPSSnapshot&);
+	void printVTG();
+	void printVTG(const GPSSnapshot&);
+
+	void printKMLtoConsole();
+	int printKMLtoFile(const GPSFix&);
+
+	int readGGAData(const NMEAFields&);
+	void readGSAData(const NMEAFields&);
+	void readGSVData(const NMEAFields&);
+	void readGLLData(const NMEAFields&);
+	void readRMCData(const NMEAFields&);
+	void readTXTData(const NMEAFields&);
+	void readVTGData(const NMEAFields&);
+	void crunchGPSSentence(const std::string&);
+	void crunchGPSSentence(const char*, size_t);
+
+	// type is "GGA" for every talker, "GLGSV" for one talker or a
+	// proprietary address such as "PUBX". Replaces any existing handler.
+	bool registerSentenceHandler(std::string_view type, NMEASentenceHandler handler, void* context);
+
+	// Decodes every complete $...*hh frame in the buffer, which may hold any
+	// number of concatenated sentences and UBX frames. A frame cut off at
+	// the end of the buffer is kept and completed by the next call; see
+	// NMEAFramer for how noise and damaged frames are skipped. Returns the
+	// number of sentences and UBX messages that passed the checksum.
+	size_t decode(const char* data, size_t length);
+
+	// Frames longer than this, counting "\r\n", are dropped. Default 82,
+	// the NMEA 0183 limit; at most NMEAFramer::BUFFER_SIZE + 2.
+	void setMaxFrameLength(size_t length) { framer.setMaxLength(length); }
+
+	// Called for each decoded sentence after its struct has been updated.
+	void setSentenceCallback(GPSSentenceCallback callback, void* context);
+
+	// Called for each UBX message after NAV-PVT and NAV-SAT have been
+	// decoded, e.g. to see the ACK-ACK or ACK-NAK to a configuration.
+	void setUBXCallback(GPSUBXCallback callback, void* context);
+
+	// Sends configuration to the receiver over the open source: output
+	// rate and protocols, see GPSUBXConfig. Returns 1 when every byte was
+	// written; the receiver acknowledges each message on its own. Returns
+	// 0 without sending anything when the rate is out of range.
+	int configureUBX(const GPSUBXConfig& config);
+	int sendUBX(uint8_t msgClass, uint8_t msgID, const uint8_t* payload, size_t length);
+
+	// Called once per receiver epoch with the merged fix. See
+	// GPSEpochAssembler for when an epoch counts as complete.
+	int addFixListener(GPSFixCallback callback, void* context);
+	void removeFixListener(GPSFixCallback callback, void* context);
+
+	// Decodes a final frame that has no line ending and emits the open
+	// epoch. Call at the end of input.
+	size_t flush();
+
+	// Emits the open epoch once the receiver has gone quiet. The event
+	// loop calls this whenever it wakes.
+	void poll();
+	bool epochPending() const { return epochs.pending(); }
+
+	// Reads the configured source until stop() is called or the
+	// source runs out of input.
+	void run();
+
+	void stop() { runGPSWorker = false; }
+
+	GPSInputSource* inputSource() { return source.get(); }
+
+	// True when both decoders, fed the same bytes from here on, would
+	// produce the same fixes: neither is inside a frame and both hold the
+	// same epoch and satellite state. Only meaningful between decode()
+	// calls on the decoding threads; GPSBulkDecoder uses it to tell when a
+	// chunk decoded without its history has caught up.
+	bool inSyncWith(const GPSDecoder& other) const;
+
+	// Running totals, safe to read from any thread.
+	uint64_t sentenceCount() const { return stats.sentences.get(); }
+	uint64_t checksumFailures() const { return stats.checksumFailures.get(); }
+
+	// Every counter and latency histogram at once, safe to call from any
+	// thread. See GPSStats.h for writing them out.
+	void readStats(GPSStatsSnapshot& out) const;
+
+	// Latest published state, safe to call from any thread. Returns the
+	// snapshot's epoch, 0 before anything was decoded.
+	uint64_t readSnapshot(GPSSnapshot& out) const { return snapshots.read(out); }
+	GPSSnapshot snapshot() const;
+
+	// Satellites in view as of the last complete GSV group or NAV-SAT,
+	// safe to call from any thread. Updated per group rather than per
+	// epoch.
+	uint64_t readSatellites(GPSSatTable& out) const { return satellites.read(out); }
+
+	GGAStruct GGAData;
+	GSAStruct GSAData;
+	GSVStruct GSVData;
+	GLLStruct GLLData;
+	RMCStruct RMCData;
+//	TXTStruct TXTData;
+	VTGStruct VTGData;
+
+	int iterator = 0;
+	std::atomic<bool> runGPSWorker{true};
+	bool file_init = true;
+	bool cleared_buffer=false;
+	bool GPSClosed = false;
+	bool KMLOutputEnabled = false;
+
+
+	static const size_t MAX_SENTENCE_LENGTH = 128;
+
+private:
+	void registerDefaultHandlers();
+	int decodeFrame(const char* frame, size_t length);
+	int decodeUBX(const char* frame, size_t length);
+	int sendToReceiver(const std::string& bytes);
+	static void frameReady(const char* frame, size_t length, void* decoder);
+	void publishSnapshot(const GPSFix& fix, bool rejected);
+	static void fixAssembled(const GPSFix& fix, void* decoder);
+
+	NMEADispatcher dispatcher;
+
+	GPSEpochAssembler epochs;
+	GPSSatelliteTracker satellites;
+	GPSMotionTracker motion;
+	GPSFixFilter fixFilter;
+	GPSSeqLock<GPSSnapshot> snapshots;
+
+	//only the decoding thread writes these
+	GPSDecodeStats stats;
+
+	GPSSentenceCallback sentenceCallback = nullptr;
+	void* sentenceContext = nullptr;
+	GPSUBXCallback UBXCallback = nullptr;
+	void* UBXContext = nullptr;
+
+	NMEAFramer framer;
+	size_t framesPassed = 0;
+
+	GPSKMLWriter KMLWriter;
+	GPSTrackSimplifier KMLSimplifier;
+	static void KMLSimplified(const GPSFix& fix, void* decoder);
+	GPSTrackWriter trackLog;
+	GPSSinkFanout sinks;
+
+	GPSKMLConfig KMLConfig;
+
+	GPSSourceConfig sourceConfig;
+	std::unique_ptr<GPSInputSource> source;
+};
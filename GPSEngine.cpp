@@ -0,0 +1,95 @@
+#include "GPSEngine.h"
+
+GPSEngine::GPSEngine(int workerCount)
+{
+	if(workerCount <= 0)
+		workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+	for(int i = 0; i < workerCount; i++)
+		workers.emplace_back(new Worker());
+}
+
+GPSEngine::~GPSEngine()
+{
+	stop();
+}
+
+int GPSEngine::addSource(const GPSSourceConfig& config)
+{
+	std::unique_ptr<GPSInputSource> input = makeInputSource(config);
+	if(!input || !input->open())
+		return -1;
+	return addSource(std::move(input));
+}
+
+int GPSEngine::addSource(std::unique_ptr<GPSInputSource> input)
+{
+	if(started || !input || !input->isOpen())
+		return -1;
+
+	Source source;
+	source.input = std::move(input);
+	source.decoder.reset(new GPSDecoder(GPSSourceConfig()));
+	source.worker = (int)sources.size() % (int)workers.size();
+
+	if(!workers[source.worker]->loop.add(source.input.get(), source.decoder.get()))
+		return -1;
+
+	sources.push_back(std::move(source));
+	return (int)sources.size() - 1;
+}
+
+int GPSEngine::start()
+{
+	if(started)
+		return 0;
+
+	started = true;
+	startTime = std::chrono::steady_clock::now();
+
+	for(auto& worker : workers)
+	{
+		Worker* w = worker.get();
+		w->thread = std::thread([w]{
+			w->loop.run();
+			w->done = true;
+		});
+	}
+	return 1;
+}
+
+void GPSEngine::stop()
+{
+	for(auto& worker : workers)
+		worker->loop.stop();
+
+	for(auto& worker : workers)
+		if(worker->thread.joinable())
+			worker->thread.join();
+}
+
+bool GPSEngine::running() const
+{
+	if(!started)
+		return false;
+
+	for(auto& worker : workers)
+		if(!worker->done)
+			return true;
+	return false;
+}
+
+GPSEngineThroughput GPSEngine::throughput() const
+{
+	GPSEngineThroughput total;
+
+	for(auto& worker : workers)
+	{
+		total.bytes += worker->loop.bytesRead();
+		total.sentences += worker->loop.sentencesDecoded();
+	}
+
+	if(started)
+		total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return total;
+}
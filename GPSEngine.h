@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "GPSDecoder.h"
+#include "GPSEventLoop.h"
+#include "GPSInputSource.h"
+
+// Decodes many receivers on a fixed pool of worker threads.
+//
+// Each source gets its own GPSDecoder, so parser state and the latest fix
+// are kept per receiver. Sources are sharded round robin across the
+// workers and every worker runs one GPSEventLoop, so dozens of receivers
+// cost a handful of threads that sleep until any of their sources has
+// bytes.
+//
+// Sources are added before start(). Workers stop on stop() or once every
+// one of their sources has reached end of input.
+
+struct GPSEngineThroughput
+{
+	size_t bytes = 0;
+	size_t sentences = 0;
+	double seconds = 0;
+
+	double bytesPerSecond() const { return seconds > 0 ? bytes / seconds : 0; }
+	double sentencesPerSecond() const { return seconds > 0 ? sentences / seconds : 0; }
+};
+
+class GPSEngine
+{
+public:
+	// 0 workers means one per core.
+	GPSEngine(int workers = 0);
+	~GPSEngine();
+
+	// Opens the source and gives it a decoder. Returns its id or -1.
+	int addSource(const GPSSourceConfig& config);
+	int addSource(std::unique_ptr<GPSInputSource> source);
+
+	int start();
+	void stop();
+	bool running() const;
+
+	int sourceCount() const { return (int)sources.size(); }
+	int workerCount() const { return (int)workers.size(); }
+
+	GPSDecoder& decoder(int id) { return *sources[id].decoder; }
+	GPSInputSource& source(int id) { return *sources[id].input; }
+
+	// Totals over every worker since start().
+	GPSEngineThroughput throughput() const;
+
+private:
+	struct Source
+	{
+		std::unique_ptr<GPSInputSource> input;
+		std::unique_ptr<GPSDecoder> decoder;
+		int worker;
+	};
+
+	struct Worker
+	{
+		GPSEventLoop loop;
+		std::thread thread;
+		std::atomic<bool> done{false};
+	};
+
+	std::vector<Source> sources;
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	std::chrono::steady_clock::time_point startTime;
+	bool started = false;
+};
@@ -0,0 +1,286 @@
+#include "GPSEpochAssembler.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+int GPSEpochAssembler::addListener(GPSFixCallback callback, void* context)
+{
+	if((callback == nullptr) || (listenerCount == MAX_LISTENERS))
+		return 0;
+
+	listeners[listenerCount++] = Listener{callback, context};
+	return 1;
+}
+
+void GPSEpochAssembler::removeListener(GPSFixCallback callback, void* context)
+{
+	for(int i = 0; i < listenerCount; i++)
+	{
+		if((listeners[i].callback == callback) && (listeners[i].context == context))
+		{
+			for(int j = i + 1; j < listenerCount; j++)
+				listeners[j-1] = listeners[j];
+			listenerCount--;
+			return;
+		}
+	}
+}
+
+void GPSEpochAssembler::timed(const NMEATime& time, const NMEATalker& talker)
+{
+	if(!time.valid)
+	{
+		untimed();
+		return;
+	}
+
+	//a new fix time closes the open epoch
+	if(open && current.time.valid && (current.time.millisOfDay() != time.millisOfDay()))
+		emit(true);
+
+	untimed();
+	if(!current.time.valid)
+	{
+		current.time = time;
+		current.talker = talker;
+	}
+}
+
+void GPSEpochAssembler::untimed()
+{
+	lastSentence = (arrival.time_since_epoch().count() != 0) ? arrival : std::chrono::steady_clock::now();
+	open = true;
+}
+
+void GPSEpochAssembler::counted(int type)
+{
+	counts[type]++;
+
+	//with binary fixes the epoch waits for its NAV-PVT instead
+	if(!expectedKnown || binaryLed)
+		return;
+
+	for(int i = 0; i < TYPE_COUNT; i++)
+		if(counts[i] < expected[i])
+			return;
+
+	//everything the last epoch had has arrived
+	emit(false);
+}
+
+void GPSEpochAssembler::addGGA(const GGAStruct& GGA)
+{
+	timed(GGA.GGAfixTime, GGA.talker);
+
+	current.latitude = GGA.GGALatitudeNum;
+	current.longitude = GGA.GGALongitudeNum;
+	current.altitude = GGA.alt;
+	current.heightOfGeoid = GGA.heightOfGeoid;
+	current.quality = GGA.gps_fix;
+	current.satellitesUsed = GGA.satNum;
+	if(!(current.sentences & FIX_GSA))
+		current.HDOP = GGA.horzDOP;
+	current.sentences |= FIX_GGA;
+
+	counted(TYPE_GGA);
+}
+
+void GPSEpochAssembler::addRMC(const RMCStruct& RMC)
+{
+	timed(RMC.RMCFixTaken, RMC.talker);
+
+	//GGA has the better position, altitude included
+	if(!(current.sentences & FIX_GGA))
+	{
+		current.latitude = RMC.RMCLatitude;
+		current.longitude = RMC.RMCLongitude;
+	}
+	current.date = RMC.RMCDate;
+	current.status = RMC.RMCStatus;
+	current.speedKnots = RMC.RMCGNDSpeed;
+	current.course = RMC.RMCTrackAngle;
+	current.sentences |= FIX_RMC;
+
+	counted(TYPE_RMC);
+}
+
+void GPSEpochAssembler::addGLL(const GLLStruct& GLL)
+{
+	timed(GLL.GLLfixTakenAt, GLL.talker);
+
+	if(!(current.sentences & (FIX_GGA | FIX_RMC)))
+	{
+		current.latitude = GLL.GLLLatitude;
+		current.longitude = GLL.GLLLongitude;
+	}
+	if(!(current.sentences & FIX_RMC))
+		current.status = GLL.dataActive;
+	current.sentences |= FIX_GLL;
+
+	counted(TYPE_GLL);
+}
+
+void GPSEpochAssembler::addGSA(const GSAStruct& GSA)
+{
+	untimed();
+
+	//multi constellation receivers send one GSA per system
+	current.fixType = std::max(current.fixType, GSA.GPSFix);
+	current.PDOP = GSA.PDOP;
+	current.HDOP = GSA.HDOP;
+	current.VDOP = GSA.VDOP;
+	for(int i = 0; i < 12; i++)
+		if(GSA.PRN[i])
+			gsaUsed++;
+	current.sentences |= FIX_GSA;
+
+	counted(TYPE_GSA);
+}
+
+void GPSEpochAssembler::addGSV(const GSVStruct& GSV)
+{
+	untimed();
+
+	if(GSV.sentence == 1)
+		current.satellitesInView += GSV.sateliteInView;
+	current.sentences |= FIX_GSV;
+
+	//one count per complete group
+	if(GSV.sentence == GSV.fullDataSentNum)
+		counted(TYPE_GSV);
+}
+
+void GPSEpochAssembler::addVTG(const VTGStruct& VTG)
+{
+	untimed();
+
+	if(!(current.sentences & FIX_RMC))
+	{
+		current.speedKnots = VTG.VTGGndSpdKnots;
+		current.course = VTG.VTGTrueTrack;
+	}
+	current.sentences |= FIX_VTG;
+
+	counted(TYPE_VTG);
+}
+
+//NMEA gives hundredths of a second, NAV-PVT rounds to the millisecond
+static bool sameTime(const NMEATime& a, const NMEATime& b)
+{
+	return a.valid && b.valid && (std::abs(a.millisOfDay() - b.millisOfDay()) < 10);
+}
+
+void GPSEpochAssembler::addFix(const GPSFix& fix)
+{
+	GPSFix merged = fix;
+	if(open && sameTime(current.time, fix.time))
+	{
+		//the NMEA sentences of the same epoch only add what the binary
+		//fix lacks
+		if(current.sentences & (FIX_GGA | FIX_GSA))
+		{
+			merged.HDOP = current.HDOP;
+			merged.VDOP = current.VDOP;
+		}
+		merged.sentences |= current.sentences;
+		clear();
+	}
+	else if(open)
+		emit(true);
+
+	binaryLed = true;
+	unmatched = 0;
+
+	//what the last NMEA epoch learned still holds for the next one
+	untimed();
+	current = merged;
+	emit(false);
+}
+
+void GPSEpochAssembler::poll(std::chrono::steady_clock::time_point now)
+{
+	if(open && (now - lastSentence >= burstGap))
+		emit(true);
+}
+
+void GPSEpochAssembler::flush()
+{
+	if(open)
+		emit(true);
+}
+
+static bool sameFix(const GPSFix& a, const GPSFix& b)
+{
+	return (a.talker.view() == b.talker.view())
+		&& (a.time.valid == b.time.valid) && (a.time.millisOfDay() == b.time.millisOfDay())
+		&& (a.date.valid == b.date.valid) && (a.date.year == b.date.year) && (a.date.month == b.date.month) && (a.date.day == b.date.day)
+		&& (a.latitude == b.latitude) && (a.longitude == b.longitude)
+		&& (a.altitude == b.altitude) && (a.heightOfGeoid == b.heightOfGeoid)
+		&& (a.speedKnots == b.speedKnots) && (a.course == b.course)
+		&& (a.quality == b.quality) && (a.fixType == b.fixType) && (a.status == b.status)
+		&& (a.PDOP == b.PDOP) && (a.HDOP == b.HDOP) && (a.VDOP == b.VDOP)
+		&& (a.satellitesUsed == b.satellitesUsed) && (a.satellitesInView == b.satellitesInView)
+		&& (a.sentences == b.sentences);
+}
+
+bool GPSEpochAssembler::sameState(const GPSEpochAssembler& other) const
+{
+	if((open != other.open) || (gsaUsed != other.gsaUsed) || (expectedKnown != other.expectedKnown)
+		|| (binaryLed != other.binaryLed) || (unmatched != other.unmatched))
+		return false;
+
+	for(int i = 0; i < TYPE_COUNT; i++)
+		if((counts[i] != other.counts[i]) || (expected[i] != other.expected[i]))
+			return false;
+
+	return sameFix(current, other.current);
+}
+
+void GPSEpochAssembler::clear()
+{
+	current = GPSFix();
+	open = false;
+	gsaUsed = 0;
+	for(int i = 0; i < TYPE_COUNT; i++)
+		counts[i] = 0;
+}
+
+void GPSEpochAssembler::emit(bool learn)
+{
+	if(!(current.sentences & FIX_GGA) && (gsaUsed > 0))
+		current.satellitesUsed = gsaUsed;
+
+	//an epoch that ended on a time change or a gap shows the full burst
+	if(learn)
+	{
+		for(int i = 0; expectedKnown && (i < TYPE_COUNT); i++)
+		{
+			if(counts[i] < expected[i])
+			{
+				partial.add();
+				break;
+			}
+		}
+
+		for(int i = 0; i < TYPE_COUNT; i++)
+			expected[i] = counts[i];
+		expectedKnown = true;
+	}
+
+	//while binary fixes come, an NMEA epoch that found none to fold into
+	//goes no further, until too many in a row say they have stopped
+	bool drop = binaryLed && !(current.sentences & FIX_PVT);
+	if(drop && (++unmatched > MAX_UNMATCHED))
+	{
+		binaryLed = false;
+		drop = false;
+	}
+
+	if(!drop)
+	{
+		fixes.add();
+		for(int i = 0; i < listenerCount; i++)
+			listeners[i].callback(current, listeners[i].context);
+	}
+	clear();
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "GPSFix.h"
+#include "GPSSentences.h"
+#include "GPSStats.h"
+
+typedef void (*GPSFixCallback)(const GPSFix& fix, void* context);
+
+// Groups decoded sentences into one GPSFix per receiver epoch.
+//
+// Sentences carrying a UTC time (GGA, RMC, GLL) open a new epoch when
+// their time differs from the open one; sentences without a time (GSA,
+// GSV, VTG) join the open epoch. An epoch is emitted to the listeners as
+// soon as it holds as many sentences of each type as the previous epoch
+// did, or when the next epoch starts, or when no sentence has arrived for
+// the burst gap. GSV counts once per complete N of M group.
+//
+// A binary fix is a whole epoch. A receiver sending UBX alongside NMEA
+// reports every epoch twice, so once a NAV-PVT has been seen the open NMEA
+// epoch is folded into the NAV-PVT with the same time, filling in the HDOP
+// and VDOP it lacks, and NMEA epochs without one are dropped. After
+// MAX_UNMATCHED of those in a row the binary fixes are taken to have
+// stopped and NMEA epochs go out on their own again.
+
+class GPSEpochAssembler
+{
+public:
+	static const int MAX_LISTENERS = 8;
+	static const int MAX_UNMATCHED = 2;
+
+	int addListener(GPSFixCallback callback, void* context);
+	void removeListener(GPSFixCallback callback, void* context);
+
+	// Silence after which a burst is considered over. Default 100 ms.
+	void setBurstGap(std::chrono::milliseconds gap) { burstGap = gap; }
+
+	void addGGA(const GGAStruct&);
+	void addRMC(const RMCStruct&);
+	void addGLL(const GLLStruct&);
+	void addGSA(const GSAStruct&);
+	void addGSV(const GSVStruct&);
+	void addVTG(const VTGStruct&);
+
+	// A fix that is already a whole epoch, e.g. a UBX NAV-PVT. Takes in
+	// the open epoch when it has the same time, emits it first otherwise.
+	void addFix(const GPSFix&);
+
+	bool pending() const { return open; }
+
+	// When the bytes about to be added arrived, e.g. from the read that
+	// returned them. Without it a sentence arrives when it is added.
+	void setArrival(std::chrono::steady_clock::time_point time) { arrival = time; }
+
+	// Arrival of the last sentence of the epoch being emitted, for a
+	// listener to measure latency from.
+	std::chrono::steady_clock::time_point lastArrival() const { return lastSentence; }
+
+	// Emits the open epoch when the burst gap has passed.
+	void poll(std::chrono::steady_clock::time_point now);
+
+	// Emits the open epoch now, e.g. at the end of a log.
+	void flush();
+
+	// True when both would assemble the same sentences into the same
+	// fixes from here on: the same open epoch and the same expectations
+	// learned from the last one. Listeners and counts are not compared.
+	bool sameState(const GPSEpochAssembler& other) const;
+
+	// Safe to read from any thread. A partial epoch went out without a
+	// sentence type the one before it had.
+	uint64_t fixCount() const { return fixes.get(); }
+	uint64_t partialCount() const { return partial.get(); }
+
+private:
+	enum { TYPE_GGA, TYPE_RMC, TYPE_GSA, TYPE_GSV, TYPE_VTG, TYPE_GLL, TYPE_COUNT };
+
+	void timed(const NMEATime& time, const NMEATalker& talker);
+	void untimed();
+	void counted(int type);
+	void emit(bool learn);
+	void clear();
+
+	struct Listener
+	{
+		GPSFixCallback callback;
+		void* context;
+	};
+
+	Listener listeners[MAX_LISTENERS];
+	int listenerCount = 0;
+
+	GPSFix current;
+	bool open = false;
+	int gsaUsed = 0;
+
+	int counts[TYPE_COUNT] = {0};
+	int expected[TYPE_COUNT] = {0};
+	bool expectedKnown = false;
+
+	bool binaryLed = false;		//a NAV-PVT has been seen
+	int unmatched = 0;			//NMEA epochs dropped since the last one
+
+	std::chrono::milliseconds burstGap{100};
+	std::chrono::steady_clock::time_point arrival;
+	std::chrono::steady_clock::time_point lastSentence;
+
+	GPSCounter fixes;
+	GPSCounter partial;
+};
@@ -0,0 +1,180 @@
+#include "GPSEventLoop.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "GPSDecoder.h"
+
+//chunks read from one source before giving the others a turn
+static const int MAX_CHUNKS_PER_WAKE = 16;
+static const int MAX_EVENTS = 64;
+static const int EPOCH_POLL_MS = 10;
+
+GPSEventLoop::GPSEventLoop() : buffer(READ_CHUNK)
+{
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if((epollFd >= 0) && (wakeFd >= 0))
+	{
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.ptr = nullptr;
+		epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+	}
+}
+
+GPSEventLoop::~GPSEventLoop()
+{
+	if(epollFd >= 0)
+		close(epollFd);
+	if(wakeFd >= 0)
+		close(wakeFd);
+}
+
+int GPSEventLoop::add(GPSInputSource* source, GPSDecoder* decoder)
+{
+	if((epollFd < 0) || (source == nullptr) || !source->isOpen() || (decoder == nullptr))
+		return 0;
+
+	std::unique_ptr<Entry> entry(new Entry{source, decoder, true, false});
+
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = entry.get();
+
+	if(epoll_ctl(epollFd, EPOLL_CTL_ADD, source->fd(), &event) < 0)
+	{
+		//regular files are always readable and epoll refuses them
+		if(errno != EPERM)
+			return 0;
+		entry->pollable = false;
+		unpollable++;
+	}
+
+	entries.push_back(std::move(entry));
+	active++;
+	return 1;
+}
+
+void GPSEventLoop::remove(GPSInputSource* source)
+{
+	for(auto it = entries.begin(); it != entries.end(); ++it)
+	{
+		if((*it)->source == source)
+		{
+			finish(**it);
+			entries.erase(it);
+			return;
+		}
+	}
+}
+
+void GPSEventLoop::finish(Entry& entry)
+{
+	if(entry.finished)
+		return;
+
+	if(entry.pollable)
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, entry.source->fd(), nullptr);
+	else
+		unpollable--;
+
+	totalSentences.fetch_add(entry.decoder->flush(), std::memory_order_relaxed);
+
+	entry.finished = true;
+	active--;
+}
+
+int GPSEventLoop::drain(Entry& entry, int maxChunks)
+{
+	int decoded = 0;
+
+	for(int chunk = 0; chunk < maxChunks; chunk++)
+	{
+		ssize_t length = entry.source->read(buffer.data(), buffer.size());
+
+		if(length > 0)
+		{
+			totalBytes.fetch_add(length, std::memory_order_relaxed);
+			decoded += entry.decoder->decode(buffer.data(), length);
+			continue;
+		}
+
+		if((length < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+			break;
+
+		//end of input, or the device went away
+		finish(entry);
+		break;
+	}
+	return decoded;
+}
+
+int GPSEventLoop::runOnce(int timeoutMs)
+{
+	if(epollFd < 0)
+		return -1;
+
+	//unpollable sources always have data, so never sleep while they do
+	if(unpollable > 0)
+		timeoutMs = 0;
+
+	//wake up in time to close an epoch after its burst
+	for(auto& entry : entries)
+		if(!entry->finished && entry->decoder->epochPending())
+			timeoutMs = (timeoutMs < 0) ? EPOCH_POLL_MS : std::min(timeoutMs, EPOCH_POLL_MS);
+
+	struct epoll_event events[MAX_EVENTS];
+	int count = epoll_wait(epollFd, events, MAX_EVENTS, timeoutMs);
+	if(count < 0)
+		return (errno == EINTR) ? 0 : -1;
+
+	int decoded = 0;
+	for(int i = 0; i < count; i++)
+	{
+		Entry* entry = (Entry*)events[i].data.ptr;
+		if(entry == nullptr)
+		{
+			uint64_t value;
+			ssize_t ignored = read(wakeFd, &value, sizeof(value));
+			(void)ignored;
+			continue;
+		}
+		if(!entry->finished)
+			decoded += drain(*entry, MAX_CHUNKS_PER_WAKE);
+	}
+
+	for(auto& entry : entries)
+	{
+		if(!entry->pollable && !entry->finished)
+			decoded += drain(*entry, 1);
+		if(!entry->finished)
+			entry->decoder->poll();
+	}
+
+	totalSentences.fetch_add(decoded, std::memory_order_relaxed);
+	return decoded;
+}
+
+void GPSEventLoop::run()
+{
+	while(!stopRequested && (active > 0))
+	{
+		if(runOnce(-1) < 0)
+			break;
+	}
+}
+
+void GPSEventLoop::stop()
+{
+	stopRequested = true;
+
+	uint64_t one = 1;
+	ssize_t ignored = write(wakeFd, &one, sizeof(one));
+	(void)ignored;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "GPSInputSource.h"
+
+class GPSDecoder;
+
+// epoll driven reader that feeds input sources into their decoders.
+//
+// The thread running the loop sleeps in epoll_wait() until one of its
+// sources has bytes, then drains it in READ_CHUNK sized read() calls
+// straight into GPSDecoder::decode(). Regular files cannot be polled, so
+// they are read one chunk per pass until they reach their end.
+//
+// Sources are added and removed while the loop is not running; stop() may
+// be called from any thread.
+
+class GPSEventLoop
+{
+public:
+	static const size_t READ_CHUNK = 64 << 10;
+
+	GPSEventLoop();
+	~GPSEventLoop();
+
+	// The loop does not own the source or the decoder. Returns 1 on success.
+	int add(GPSInputSource* source, GPSDecoder* decoder);
+	void remove(GPSInputSource* source);
+
+	// Sources that have not reached end of input or failed.
+	int activeSources() const { return active; }
+
+	// Waits up to timeoutMs (-1 = forever) and decodes whatever is waiting.
+	// Returns the number of sentences decoded, -1 if the loop is broken.
+	int runOnce(int timeoutMs);
+
+	// Runs until stop() or until every source has finished.
+	void run();
+	void stop();
+
+	// Totals for this loop, safe to read from any thread.
+	size_t bytesRead() const { return totalBytes.load(std::memory_order_relaxed); }
+	size_t sentencesDecoded() const { return totalSentences.load(std::memory_order_relaxed); }
+
+private:
+	struct Entry
+	{
+		GPSInputSource* source;
+		GPSDecoder* decoder;
+		bool pollable;
+		bool finished;
+	};
+
+	int drain(Entry& entry, int maxChunks);
+	void finish(Entry& entry);
+
+	int epollFd = -1;
+	int wakeFd = -1;
+
+	std::vector<std::unique_ptr<Entry>> entries;
+	std::vector<char> buffer;
+	int active = 0;
+	int unpollable = 0;
+	std::atomic<size_t> totalBytes{0};
+	std::atomic<size_t> totalSentences{0};
+
+	std::atomic<bool> stopRequested{false};
+};
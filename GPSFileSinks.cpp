@@ -0,0 +1,317 @@
+#include "GPSFileSinks.h"
+
+#include <charconv>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+bool endsWith(const std::string& text, const char* suffix)
+{
+	size_t length = strlen(suffix);
+	return (text.length() >= length) && !text.compare(text.length() - length, length, suffix);
+}
+
+GPSTextSink::~GPSTextSink()
+{
+	close();
+}
+
+int GPSTextSink::open(const std::string& path)
+{
+	close();
+
+	if(path == "-")
+	{
+		fd = STDOUT_FILENO;
+		ownsFd = false;
+	}
+	else
+	{
+		fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		ownsFd = true;
+	}
+	if(fd < 0)
+		return 0;
+
+	buffer.reserve(WRITE_SIZE + 1024);
+	buffer.clear();
+	begin();
+	return 1;
+}
+
+void GPSTextSink::flush()
+{
+	const char* p = buffer.data();
+	size_t length = buffer.size();
+	while((fd >= 0) && (length > 0))
+	{
+		ssize_t n = write(fd, p, length);
+		if(n <= 0)
+			break;
+		p += n;
+		length -= n;
+	}
+	buffer.clear();
+}
+
+void GPSTextSink::close()
+{
+	if(fd < 0)
+		return;
+
+	end();
+	flush();
+	if(ownsFd)
+		::close(fd);
+	fd = -1;
+}
+
+void GPSTextSink::done()
+{
+	if(buffer.size() >= WRITE_SIZE)
+		flush();
+}
+
+void GPSTextSink::putInt(int64_t value)
+{
+	char text[24];
+	std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+	buffer.append(text, result.ptr - text);
+}
+
+void GPSTextSink::putFixed(double value, int precision)
+{
+	char text[64];
+	std::to_chars_result result = std::to_chars(text, text + sizeof(text), value, std::chars_format::fixed, precision);
+	if(result.ec == std::errc())
+		buffer.append(text, result.ptr - text);
+	else
+		buffer.push_back('0');
+}
+
+static char* putDigits(char* p, int value, int digits)
+{
+	for(int i = digits - 1; i >= 0; i--)
+	{
+		p[i] = '0' + value % 10;
+		value /= 10;
+	}
+	return p + digits;
+}
+
+void GPSTextSink::putTime(const GPSFix& fix)
+{
+	char text[32];
+	char* p = text;
+
+	if(fix.date.valid)
+	{
+		p = putDigits(p, fix.date.year, 4);
+		*p++ = '-';
+		p = putDigits(p, fix.date.month, 2);
+		*p++ = '-';
+		p = putDigits(p, fix.date.day, 2);
+		*p++ = 'T';
+	}
+	p = putDigits(p, fix.time.hour, 2);
+	*p++ = ':';
+	p = putDigits(p, fix.time.minute, 2);
+	*p++ = ':';
+	p = putDigits(p, fix.time.second, 2);
+	*p++ = '.';
+	p = putDigits(p, fix.time.millisecond, 3);
+	if(fix.date.valid)
+		*p++ = 'Z';
+
+	buffer.append(text, p - text);
+}
+
+void GPSGPXSink::begin()
+{
+	put("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<gpx version=\"1.1\" creator=\"GPSDecoder\" xmlns=\"http://www.topografix.com/GPX/1/1\">\n"
+		"\t<trk>\n\t\t<trkseg>\n");
+}
+
+void GPSGPXSink::end()
+{
+	put("\t\t</trkseg>\n\t</trk>\n</gpx>\n");
+}
+
+void GPSGPXSink::fix(const GPSFix& fix)
+{
+	if(!fix.valid())
+		return;
+
+	put("\t\t\t<trkpt lat=\"");
+	putFixed(fix.latitude, 7);
+	put("\" lon=\"");
+	putFixed(fix.longitude, 7);
+	put("\"><ele>");
+	putFixed(fix.altitude, 3);
+	put("</ele>");
+	//GPX times need the date
+	if(fix.date.valid)
+	{
+		put("<time>");
+		putTime(fix);
+		put("</time>");
+	}
+	put("<sat>");
+	putInt(fix.satellitesUsed);
+	put("</sat><hdop>");
+	putFixed(fix.HDOP, 2);
+	put("</hdop></trkpt>\n");
+	done();
+}
+
+void GPSGeoJSONSink::fix(const GPSFix& fix)
+{
+	if(!fix.valid())
+		return;
+
+	put('\x1e');
+	put("{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[");
+	putFixed(fix.longitude, 7);
+	put(',');
+	putFixed(fix.latitude, 7);
+	put(',');
+	putFixed(fix.altitude, 3);
+	put("]},\"properties\":{\"time\":\"");
+	putTime(fix);
+	put("\",\"speed\":");
+	putFixed(fix.speedKnots, 2);
+	put(",\"course\":");
+	putFixed(fix.course, 2);
+	put(",\"quality\":");
+	putInt(fix.quality);
+	put(",\"satellites\":");
+	putInt(fix.satellitesUsed);
+	put(",\"hdop\":");
+	putFixed(fix.HDOP, 2);
+	put("}}\n");
+	done();
+}
+
+void GPSCSVSink::begin()
+{
+	put("time,latitude,longitude,altitude,speed,course,quality,satellites,hdop\n");
+}
+
+void GPSCSVSink::fix(const GPSFix& fix)
+{
+	if(!fix.valid())
+		return;
+
+	putTime(fix);
+	put(',');
+	putFixed(fix.latitude, 7);
+	put(',');
+	putFixed(fix.longitude, 7);
+	put(',');
+	putFixed(fix.altitude, 3);
+	put(',');
+	putFixed(fix.speedKnots, 2);
+	put(',');
+	putFixed(fix.course, 2);
+	put(',');
+	putInt(fix.quality);
+	put(',');
+	putInt(fix.satellitesUsed);
+	put(',');
+	putFixed(fix.HDOP, 2);
+	put('\n');
+	done();
+}
+
+GPSNMEASink::GPSNMEASink(std::string_view types)
+{
+	while(!types.empty() && (keyCount < MAX_TYPES))
+	{
+		size_t comma = types.find(',');
+		std::string_view type = types.substr(0, comma);
+		if(!type.empty())
+			keys[keyCount++] = nmeaSentenceKey(type);
+
+		types = (comma == std::string_view::npos) ? std::string_view() : types.substr(comma + 1);
+	}
+}
+
+bool GPSNMEASink::accepts(const char* data, size_t length) const
+{
+	if((keyCount == 0) || (length < 2))
+		return true;
+
+	//address is everything between the '$' and the first comma
+	std::string_view address(data + 1, length - 1);
+	address = address.substr(0, address.find(','));
+
+	std::string_view talker;
+	std::string_view type;
+	if(!nmeaSplitAddress(address, talker, type))
+		return false;
+
+	NMEASentenceKey full = nmeaSentenceKey(address);
+	NMEASentenceKey typeOnly = nmeaSentenceKey(type);
+	for(int i = 0; i < keyCount; i++)
+		if((keys[i] == full) || (keys[i] == typeOnly))
+			return true;
+	return false;
+}
+
+void GPSNMEASink::sentence(const char* data, size_t length)
+{
+	put(std::string_view(data, length));
+	put("\r\n");
+	done();
+}
+
+void GPSKMLSink::fix(const GPSFix& fix)
+{
+	if((fix.quality == 1) || (fix.quality == 2))
+		writer.add(fix);
+}
+
+void GPSTrackLogSink::fix(const GPSFix& fix)
+{
+	if(fix.valid())
+		writer.add(fix);
+}
+
+std::unique_ptr<GPSSink> makeFileSink(const std::string& path)
+{
+	if(endsWith(path, ".kml"))
+	{
+		std::unique_ptr<GPSKMLSink> sink(new GPSKMLSink());
+		GPSKMLConfig config;
+		config.path = path;
+		if(!sink->open(config))
+			return nullptr;
+		return sink;
+	}
+
+	if(endsWith(path, ".trk"))
+	{
+		std::unique_ptr<GPSTrackLogSink> sink(new GPSTrackLogSink());
+		if(!sink->open(path))
+			return nullptr;
+		return sink;
+	}
+
+	std::unique_ptr<GPSTextSink> sink;
+	if(endsWith(path, ".gpx"))
+		sink.reset(new GPSGPXSink());
+	else if(endsWith(path, ".geojson") || endsWith(path, ".geojsons"))
+		sink.reset(new GPSGeoJSONSink());
+	else if(endsWith(path, ".csv"))
+		sink.reset(new GPSCSVSink());
+	else if(endsWith(path, ".nmea"))
+		sink.reset(new GPSNMEASink());
+	else
+		return nullptr;
+
+	if(!sink->open(path))
+		return nullptr;
+	return sink;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "GPSKMLWriter.h"
+#include "GPSSink.h"
+#include "GPSTrackLog.h"
+#include "NMEADispatch.h"
+
+// Base of the sinks that write text. Each record is formatted into a
+// buffer that lives as long as the sink, and the buffer is written to the
+// file once it holds WRITE_SIZE bytes, on flush() and on close(). Numbers
+// go through std::to_chars, so the output does not depend on iostreams
+// or the C locale.
+
+class GPSTextSink : public GPSSink
+{
+public:
+	static const size_t WRITE_SIZE = 64 << 10;
+
+	~GPSTextSink();
+
+	// "-" writes to stdout.
+	int open(const std::string& path);
+
+	void flush() override;
+	void close() override;
+
+protected:
+	virtual void begin() {}
+	virtual void end() {}
+
+	void put(std::string_view text) { buffer.append(text); }
+	void put(char c) { buffer.push_back(c); }
+	void putInt(int64_t value);
+	void putFixed(double value, int precision);
+
+	// yyyy-mm-ddThh:mm:ss.sssZ, or just the time without a valid date.
+	void putTime(const GPSFix& fix);
+
+	// Ends a record; writes the buffer out once it is big enough.
+	void done();
+
+	std::string buffer;
+
+private:
+	int fd = -1;
+	bool ownsFd = false;
+};
+
+class GPSGPXSink : public GPSTextSink
+{
+public:
+	~GPSGPXSink() { close(); }
+
+	void fix(const GPSFix&) override;
+
+protected:
+	void begin() override;
+	void end() override;
+};
+
+// GeoJSON text sequence (RFC 8142), one Point feature per fix.
+class GPSGeoJSONSink : public GPSTextSink
+{
+public:
+	void fix(const GPSFix&) override;
+};
+
+class GPSCSVSink : public GPSTextSink
+{
+public:
+	void fix(const GPSFix&) override;
+
+protected:
+	void begin() override;
+};
+
+// Passes the received sentences through unchanged, optionally only some
+// of them. types is a comma separated list matched like the dispatcher
+// does: "GGA,RMC" for every talker, "GPGSV" for one; empty passes all.
+class GPSNMEASink : public GPSTextSink
+{
+public:
+	static const int MAX_TYPES = 16;
+
+	GPSNMEASink(std::string_view types = std::string_view());
+
+	void sentence(const char* data, size_t length) override;
+	bool wantsSentences() const override { return true; }
+	bool accepts(const char* data, size_t length) const override;
+
+private:
+	NMEASentenceKey keys[MAX_TYPES];
+	int keyCount = 0;
+};
+
+class GPSKMLSink : public GPSSink
+{
+public:
+	int open(const GPSKMLConfig& config) { return writer.open(config); }
+
+	void fix(const GPSFix&) override;
+	void flush() override { writer.flush(); }
+	void close() override { writer.close(); }
+
+private:
+	GPSKMLWriter writer;
+};
+
+class GPSTrackLogSink : public GPSSink
+{
+public:
+	int open(const std::string& path) { return writer.open(path); }
+
+	void fix(const GPSFix&) override;
+	void close() override { writer.close(); }
+
+private:
+	GPSTrackWriter writer;
+};
+
+bool endsWith(const std::string& text, const char* suffix);
+
+// Opens the sink matching the extension of path: .kml, .gpx, .geojson,
+// .csv, .trk or .nmea. Returns nullptr for anything else or when the file
+// cannot be created.
+std::unique_ptr<GPSSink> makeFileSink(const std::string& path);
@@ -0,0 +1,170 @@
+#include "GPSFilter.h"
+
+#include <cmath>
+
+#include "GPSTrackLog.h"
+
+static const double RADIANS = M_PI / 180.0;
+static const int64_t MILLIS_PER_DAY = 86400000;
+
+//the local frame follows the track once it is this far from its origin
+static const double MAX_ORIGIN_DISTANCE2 = 10000.0 * 10000.0;
+
+//velocity variance to start from, (m/s)², with and without a speed from
+//the receiver
+static const double KNOWN_VELOCITY_VARIANCE = 1;
+static const double UNKNOWN_VELOCITY_VARIANCE = 100;
+
+static inline bool hasVelocity(const GPSFix& fix)
+{
+	return fix.sentences & (FIX_RMC | FIX_VTG | FIX_PVT);
+}
+
+static inline double ellipsoidHeight(const GPSFix& fix)
+{
+	return (double)fix.altitude + fix.heightOfGeoid;
+}
+
+uint64_t GPSFixFilter::rejected() const
+{
+	uint64_t total = 0;
+	for(int i = FILTER_ACCEPTED + 1; i < FILTER_RESULTS; i++)
+		total += counts[i].get();
+	return total;
+}
+
+double GPSFixFilter::measurementVariance(const GPSFix& fix) const
+{
+	double sigma = config.positionSigma * ((fix.HDOP > 0) ? fix.HDOP : 1);
+	return sigma * sigma;
+}
+
+GPSFilterResult GPSFixFilter::reject(GPSFilterResult result)
+{
+	if((result == FILTER_SPEED) || (result == FILTER_OUTLIER))
+		dropsInRow++;
+	counts[result].add();
+	return result;
+}
+
+void GPSFixFilter::start(const GPSFix& fix, int64_t time)
+{
+	started = true;
+	local.setOrigin(fix.latitude, fix.longitude, ellipsoidHeight(fix));
+	east = 0;
+	north = 0;
+
+	if(hasVelocity(fix))
+	{
+		double speed = fix.speedKnots * GPS_METRES_PER_SECOND_PER_KNOT;
+		velocityEast = speed * std::sin(fix.course * RADIANS);
+		velocityNorth = speed * std::cos(fix.course * RADIANS);
+		P11 = KNOWN_VELOCITY_VARIANCE;
+	}
+	else
+	{
+		velocityEast = 0;
+		velocityNorth = 0;
+		P11 = UNKNOWN_VELOCITY_VARIANCE;
+	}
+	P00 = measurementVariance(fix);
+	P01 = 0;
+
+	lastTime = time;
+	lastLatitude = fix.latitude;
+	lastLongitude = fix.longitude;
+	dropsInRow = 0;
+}
+
+GPSFilterResult GPSFixFilter::add(const GPSFix& fix, GPSFix& out)
+{
+	if(!fix.valid())
+		return reject(FILTER_INVALID);
+	if((config.maxHDOP > 0) && (fix.HDOP > config.maxHDOP))
+		return reject(FILTER_DOP);
+	if((config.maxPDOP > 0) && (fix.PDOP > config.maxPDOP))
+		return reject(FILTER_DOP);
+	if((config.minSatellites > 0) && (fix.sentences & (FIX_GGA | FIX_PVT)) && (fix.satellitesUsed < config.minSatellites))
+		return reject(FILTER_SATELLITES);
+
+	out = fix;
+	int64_t time = gpsFixTime(fix.date, fix.time);
+
+	//without a date the time of day wraps at midnight
+	int64_t millis = time - lastTime;
+	if(!fix.date.valid && (millis < -MILLIS_PER_DAY / 2))
+		millis += MILLIS_PER_DAY;
+
+	bool restart = !started || (millis < 0) || (millis > config.maxGapMillis)
+		|| ((config.resetAfter > 0) && (dropsInRow >= config.resetAfter));
+	if(restart)
+	{
+		start(fix, time);
+		counts[FILTER_ACCEPTED].add();
+		return FILTER_ACCEPTED;
+	}
+
+	double seconds = millis / 1000.0;
+	if((config.maxSpeed > 0) && (millis > 0)
+		&& (gpsDistance(lastLatitude, lastLongitude, fix.latitude, fix.longitude) > config.maxSpeed * seconds))
+		return reject(FILTER_SPEED);
+
+	if(config.smooth)
+	{
+		//predict, white acceleration over the interval
+		double q = config.accelerationSigma * config.accelerationSigma;
+		double dt2 = seconds * seconds;
+		double p00 = P00 + 2 * seconds * P01 + dt2 * P11 + q * dt2 * dt2 / 4;
+		double p01 = P01 + seconds * P11 + q * dt2 * seconds / 2;
+		double p11 = P11 + q * dt2;
+		double predictedEast = east + seconds * velocityEast;
+		double predictedNorth = north + seconds * velocityNorth;
+
+		GPSENU measured = local.toENU(fix.latitude, fix.longitude, ellipsoidHeight(fix));
+		double innovationEast = measured.east - predictedEast;
+		double innovationNorth = measured.north - predictedNorth;
+		double S = p00 + measurementVariance(fix);
+
+		if((config.innovationGate > 0)
+			&& ((innovationEast*innovationEast + innovationNorth*innovationNorth) / S > config.innovationGate))
+			return reject(FILTER_OUTLIER);
+
+		//update
+		double K0 = p00 / S;
+		double K1 = p01 / S;
+		east = predictedEast + K0 * innovationEast;
+		north = predictedNorth + K0 * innovationNorth;
+		velocityEast += K1 * innovationEast;
+		velocityNorth += K1 * innovationNorth;
+		P00 = (1 - K0) * p00;
+		P01 = (1 - K0) * p01;
+		P11 = p11 - K1 * p01;
+
+		//the height stays as measured, only the horizontal is filtered
+		GPSENU estimate{east, north, measured.up};
+		double height;
+		gpsFromECEF(local.toECEF(estimate), out.latitude, out.longitude, height);
+
+		if(!hasVelocity(fix))
+		{
+			double speed = std::sqrt(velocityEast*velocityEast + velocityNorth*velocityNorth);
+			double course = std::atan2(velocityEast, velocityNorth) / RADIANS;
+			out.speedKnots = speed / GPS_METRES_PER_SECOND_PER_KNOT;
+			out.course = (course < 0) ? course + 360 : course;
+		}
+
+		if(east*east + north*north > MAX_ORIGIN_DISTANCE2)
+		{
+			local.setOrigin(out.latitude, out.longitude, height);
+			east = 0;
+			north = 0;
+		}
+	}
+
+	lastTime = time;
+	lastLatitude = fix.latitude;
+	lastLongitude = fix.longitude;
+	dropsInRow = 0;
+	counts[FILTER_ACCEPTED].add();
+	return FILTER_ACCEPTED;
+}
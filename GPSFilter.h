@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+
+#include "GPSFix.h"
+#include "GPSGeodesy.h"
+#include "GPSStats.h"
+
+struct GPSFilterConfig
+{
+	// Fixes with a higher dilution of precision are dropped, 0 disables.
+	// A fix that does not report the DOP is not held to it.
+	float maxHDOP = 0;
+	float maxPDOP = 0;
+
+	// Fixes from fewer satellites are dropped, 0 disables.
+	int minSatellites = 0;
+
+	// Fixes further from the last accepted one than this speed in m/s
+	// could have carried the receiver are dropped, 0 disables.
+	double maxSpeed = 0;
+
+	// Runs the constant velocity Kalman filter over the accepted fixes
+	// and replaces their positions with its estimate.
+	bool smooth = false;
+
+	// Horizontal position error in metres at HDOP 1, and how hard the
+	// receiver accelerates in m/s², as standard deviations.
+	double positionSigma = 3;
+	double accelerationSigma = 1;
+
+	// Fixes whose squared innovation, in units of its variance, is over
+	// this are dropped as outliers, 0 disables. 13.8 leaves 1 in 1000
+	// good fixes out. Only with smooth.
+	double innovationGate = 0;
+
+	// After this many fixes in a row dropped by the speed or innovation
+	// gate, the next one starts the track over: the receiver really has
+	// moved, e.g. out of a tunnel.
+	int resetAfter = 5;
+
+	// A gap this long between fixes also starts the track over.
+	int64_t maxGapMillis = 10000;
+
+	bool enabled() const
+	{
+		return (maxHDOP > 0) || (maxPDOP > 0) || (minSatellites > 0) || (maxSpeed > 0) || smooth;
+	}
+};
+
+// What GPSFixFilter::add() did with a fix.
+enum GPSFilterResult
+{
+	FILTER_ACCEPTED,
+	FILTER_INVALID,			//no valid position
+	FILTER_DOP,
+	FILTER_SATELLITES,
+	FILTER_SPEED,			//implausible jump
+	FILTER_OUTLIER,			//outside the innovation gate
+	FILTER_RESULTS
+};
+
+// Streaming fix quality filter and smoother, between the decoder and
+// whatever writes the track.
+//
+// Each fix is first held to the DOP, satellite count and speed limits of
+// the config. With smooth, those that pass go through a constant velocity
+// Kalman filter in the east-north plane of a GPSLocalFrame: state east,
+// north and their velocities, a white acceleration process and the
+// position measured with an error of positionSigma times HDOP. East and
+// north share the same model and noise, so their covariances stay equal
+// and the 4x4 filter runs as one 2x2 covariance with two states, a few
+// dozen flops per fix. The frame moves along when the track gets more
+// than 10 km from its origin. Nothing is allocated after construction.
+
+class GPSFixFilter
+{
+public:
+	void setConfig(const GPSFilterConfig& newConfig) { config = newConfig; }
+	const GPSFilterConfig& getConfig() const { return config; }
+
+	// out is the fix to pass on when the result is FILTER_ACCEPTED: the
+	// fix itself, with the filtered position when smoothing, and a speed
+	// and course from the filter when the receiver gave none.
+	GPSFilterResult add(const GPSFix& fix, GPSFix& out);
+
+	// Starts a new track, keeping the config and the counts.
+	void reset() { started = false; }
+
+	// Fixes by result, safe to read from any thread.
+	uint64_t count(GPSFilterResult result) const { return counts[result].get(); }
+	uint64_t accepted() const { return count(FILTER_ACCEPTED); }
+	uint64_t rejected() const;
+
+private:
+	void start(const GPSFix& fix, int64_t time);
+	GPSFilterResult reject(GPSFilterResult result);
+	double measurementVariance(const GPSFix& fix) const;
+
+	GPSFilterConfig config;
+
+	bool started = false;
+	int64_t lastTime = 0;
+	double lastLatitude = 0;		//last accepted fix as reported
+	double lastLongitude = 0;
+	int dropsInRow = 0;
+
+	//Kalman state, per axis position and velocity, and the covariance
+	//both axes share
+	GPSLocalFrame local;
+	double east = 0;
+	double north = 0;
+	double velocityEast = 0;
+	double velocityNorth = 0;
+	double P00 = 0;
+	double P01 = 0;
+	double P11 = 0;
+
+	GPSCounter counts[FILTER_RESULTS];
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+#include "NMEADispatch.h"
+#include "NMEANumeric.h"
+
+// Sentence types that contributed to a fix.
+enum GPSFixSentence
+{
+	FIX_GGA = 1 << 0,
+	FIX_RMC = 1 << 1,
+	FIX_GSA = 1 << 2,
+	FIX_GSV = 1 << 3,
+	FIX_VTG = 1 << 4,
+	FIX_GLL = 1 << 5,
+	FIX_PVT = 1 << 6,		//UBX NAV-PVT, a whole epoch on its own
+};
+
+// One receiver epoch: everything reported for one fix time, merged from
+// the GGA, RMC, GSA, GSV, VTG and GLL sentences of the same burst, or
+// read from one UBX NAV-PVT message.
+struct GPSFix
+{
+	NMEATalker talker;
+	NMEATime time;
+	NMEADate date;
+
+	double latitude = 0;		//degrees, negative South
+	double longitude = 0;		//degrees, negative West
+	float altitude = 0;			//metres above mean sea level
+	float heightOfGeoid = 0;	//metres, mean sea level above WGS84
+
+	float speedKnots = 0;
+	float course = 0;			//degrees true
+
+	int quality = 0;			//GGA fix quality, 0 = invalid
+	int fixType = 0;			//GSA 1 = no fix, 2 = 2D, 3 = 3D
+	char status = 0;			//RMC/GLL A = active, V = void
+
+	float PDOP = 0;
+	float HDOP = 0;
+	float VDOP = 0;
+
+	int satellitesUsed = 0;
+	int satellitesInView = 0;
+
+	uint32_t sentences = 0;		//GPSFixSentence bits
+
+	bool hasPosition() const
+	{
+		return (sentences & (FIX_GGA | FIX_RMC | FIX_GLL | FIX_PVT)) && ((latitude != 0) || (longitude != 0));
+	}
+
+	bool valid() const
+	{
+		return hasPosition() && ((quality > 0) || (status == 'A'));
+	}
+};
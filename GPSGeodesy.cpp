@@ -0,0 +1,343 @@
+#include "GPSGeodesy.h"
+
+#include <algorithm>
+#include <cmath>
+
+//WGS84
+static const double SEMI_MAJOR_AXIS = 6378137.0;
+static const double FLATTENING = 1 / 298.257223563;
+static const double ECCENTRICITY2 = FLATTENING * (2 - FLATTENING);
+
+static const double RADIANS = M_PI / 180.0;
+
+//points converted per block by the batch functions
+static const size_t BLOCK = 256;
+
+static inline double ellipsoidHeight(const GPSFix& fix)
+{
+	return (double)fix.altitude + fix.heightOfGeoid;
+}
+
+static inline GPSECEF ecefFromTrig(double sinLatitude, double cosLatitude, double sinLongitude, double cosLongitude, double height)
+{
+	//prime vertical radius of curvature
+	double N = SEMI_MAJOR_AXIS / std::sqrt(1 - ECCENTRICITY2 * sinLatitude * sinLatitude);
+
+	GPSECEF out;
+	out.x = (N + height) * cosLatitude * cosLongitude;
+	out.y = (N + height) * cosLatitude * sinLongitude;
+	out.z = (N * (1 - ECCENTRICITY2) + height) * sinLatitude;
+	return out;
+}
+
+GPSECEF gpsToECEF(double latitude, double longitude, double height)
+{
+	double phi = latitude * RADIANS;
+	double lambda = longitude * RADIANS;
+	return ecefFromTrig(std::sin(phi), std::cos(phi), std::sin(lambda), std::cos(lambda), height);
+}
+
+GPSECEF gpsToECEF(const GPSFix& fix)
+{
+	return gpsToECEF(fix.latitude, fix.longitude, ellipsoidHeight(fix));
+}
+
+void gpsFromECEF(const GPSECEF& point, double& latitude, double& longitude, double& height)
+{
+	const double b = SEMI_MAJOR_AXIS * (1 - FLATTENING);
+	const double secondEccentricity2 = ECCENTRICITY2 / (1 - ECCENTRICITY2);
+
+	double p = std::sqrt(point.x*point.x + point.y*point.y);
+	double theta = std::atan2(point.z * SEMI_MAJOR_AXIS, p * b);
+	double sinTheta = std::sin(theta);
+	double cosTheta = std::cos(theta);
+
+	double phi = std::atan2(point.z + secondEccentricity2 * b * sinTheta * sinTheta * sinTheta,
+		p - ECCENTRICITY2 * SEMI_MAJOR_AXIS * cosTheta * cosTheta * cosTheta);
+	double sinPhi = std::sin(phi);
+	double N = SEMI_MAJOR_AXIS / std::sqrt(1 - ECCENTRICITY2 * sinPhi * sinPhi);
+
+	latitude = phi / RADIANS;
+	longitude = std::atan2(point.y, point.x) / RADIANS;
+
+	//near the poles p / cos is unstable, go through z instead
+	double cosPhi = std::cos(phi);
+	if(std::fabs(cosPhi) > 1e-3)
+		height = p / cosPhi - N;
+	else
+		height = point.z / sinPhi - N * (1 - ECCENTRICITY2);
+}
+
+static inline double wrapLongitude(double degrees)
+{
+	if(degrees > 180)
+		return degrees - 360;
+	if(degrees < -180)
+		return degrees + 360;
+	return degrees;
+}
+
+// Metres north and east from 1 to 2 on the radii of their mean latitude,
+// given the squared sine of each latitude.
+static inline void localStep(double latitude1, double longitude1, double sin2Latitude1,
+	double latitude2, double longitude2, double sin2Latitude2, double& north, double& east)
+{
+	double sin2 = 0.5 * (sin2Latitude1 + sin2Latitude2);
+	double w = 1 - ECCENTRICITY2 * sin2;
+	double N = SEMI_MAJOR_AXIS / std::sqrt(w);
+	double M = N * (1 - ECCENTRICITY2) / w;
+
+	north = M * (latitude2 - latitude1) * RADIANS;
+	east = N * std::sqrt(1 - sin2) * wrapLongitude(longitude2 - longitude1) * RADIANS;
+}
+
+static inline double sin2(double latitude)
+{
+	double s = std::sin(latitude * RADIANS);
+	return s * s;
+}
+
+double gpsDistance(double latitude1, double longitude1, double latitude2, double longitude2)
+{
+	double north, east;
+	localStep(latitude1, longitude1, sin2(latitude1), latitude2, longitude2, sin2(latitude2), north, east);
+	return std::sqrt(north*north + east*east);
+}
+
+double gpsBearing(double latitude1, double longitude1, double latitude2, double longitude2)
+{
+	double north, east;
+	localStep(latitude1, longitude1, sin2(latitude1), latitude2, longitude2, sin2(latitude2), north, east);
+
+	double bearing = std::atan2(east, north) / RADIANS;
+	return (bearing < 0) ? bearing + 360 : bearing;
+}
+
+double gpsTrackDistance(const GPSTrackPoint* points, size_t count, double* cumulative)
+{
+	if(count == 0)
+		return 0;
+	if(cumulative)
+		cumulative[0] = 0;
+
+	//each point's sine serves both of its steps
+	double total = 0;
+	double latitude = points[0].latitude * 1e-7;
+	double longitude = points[0].longitude * 1e-7;
+	double s2 = sin2(latitude);
+
+	for(size_t i = 1; i < count; i++)
+	{
+		double nextLatitude = points[i].latitude * 1e-7;
+		double nextLongitude = points[i].longitude * 1e-7;
+		double nextS2 = sin2(nextLatitude);
+
+		double north, east;
+		localStep(latitude, longitude, s2, nextLatitude, nextLongitude, nextS2, north, east);
+		total += std::sqrt(north*north + east*east);
+		if(cumulative)
+			cumulative[i] = total;
+
+		latitude = nextLatitude;
+		longitude = nextLongitude;
+		s2 = nextS2;
+	}
+	return total;
+}
+
+void GPSLocalFrame::setOrigin(double latitude, double longitude, double height)
+{
+	double phi = latitude * RADIANS;
+	double lambda = longitude * RADIANS;
+	sinLatitude = std::sin(phi);
+	cosLatitude = std::cos(phi);
+	sinLongitude = std::sin(lambda);
+	cosLongitude = std::cos(lambda);
+	originECEF = ecefFromTrig(sinLatitude, cosLatitude, sinLongitude, cosLongitude, height);
+}
+
+GPSENU GPSLocalFrame::toENU(const GPSECEF& point) const
+{
+	double dx = point.x - originECEF.x;
+	double dy = point.y - originECEF.y;
+	double dz = point.z - originECEF.z;
+
+	GPSENU out;
+	out.east = -sinLongitude * dx + cosLongitude * dy;
+	out.north = -sinLatitude * cosLongitude * dx - sinLatitude * sinLongitude * dy + cosLatitude * dz;
+	out.up = cosLatitude * cosLongitude * dx + cosLatitude * sinLongitude * dy + sinLatitude * dz;
+	return out;
+}
+
+GPSECEF GPSLocalFrame::toECEF(const GPSENU& point) const
+{
+	GPSECEF out;
+	out.x = originECEF.x - sinLongitude * point.east - sinLatitude * cosLongitude * point.north + cosLatitude * cosLongitude * point.up;
+	out.y = originECEF.y + cosLongitude * point.east - sinLatitude * sinLongitude * point.north + cosLatitude * sinLongitude * point.up;
+	out.z = originECEF.z + cosLatitude * point.north + sinLatitude * point.up;
+	return out;
+}
+
+void GPSLocalFrame::toENU(const double* latitude, const double* longitude, const double* height, size_t count,
+	double* east, double* north, double* up) const
+{
+	double x[BLOCK];
+	double y[BLOCK];
+	double z[BLOCK];
+
+	//the rotation, hoisted out of the loop
+	const double ex = -sinLongitude, ey = cosLongitude;
+	const double nx = -sinLatitude * cosLongitude, ny = -sinLatitude * sinLongitude, nz = cosLatitude;
+	const double ux = cosLatitude * cosLongitude, uy = cosLatitude * sinLongitude, uz = sinLatitude;
+
+	for(size_t start = 0; start < count; start += BLOCK)
+	{
+		size_t n = std::min(BLOCK, count - start);
+
+		//per point trigonometry into offsets from the origin
+		for(size_t i = 0; i < n; i++)
+		{
+			double phi = latitude[start + i] * RADIANS;
+			double lambda = longitude[start + i] * RADIANS;
+			GPSECEF p = ecefFromTrig(std::sin(phi), std::cos(phi), std::sin(lambda), std::cos(lambda), height ? height[start + i] : 0);
+			x[i] = p.x - originECEF.x;
+			y[i] = p.y - originECEF.y;
+			z[i] = p.z - originECEF.z;
+		}
+
+		//plain multiply-adds over arrays
+		for(size_t i = 0; i < n; i++)
+		{
+			east[start + i] = ex * x[i] + ey * y[i];
+			north[start + i] = nx * x[i] + ny * y[i] + nz * z[i];
+			up[start + i] = ux * x[i] + uy * y[i] + uz * z[i];
+		}
+	}
+}
+
+void GPSLocalFrame::toENU(const GPSTrackPoint* points, size_t count, GPSENU* out) const
+{
+	double latitude[BLOCK];
+	double longitude[BLOCK];
+	double height[BLOCK];
+	double east[BLOCK];
+	double north[BLOCK];
+	double up[BLOCK];
+
+	for(size_t start = 0; start < count; start += BLOCK)
+	{
+		size_t n = std::min(BLOCK, count - start);
+
+		//track logs keep heights above mean sea level only
+		for(size_t i = 0; i < n; i++)
+		{
+			latitude[i] = points[start + i].latitude * 1e-7;
+			longitude[i] = points[start + i].longitude * 1e-7;
+			height[i] = points[start + i].altitude * 1e-3;
+		}
+
+		toENU(latitude, longitude, height, n, east, north, up);
+
+		for(size_t i = 0; i < n; i++)
+		{
+			out[start + i].east = east[i];
+			out[start + i].north = north[i];
+			out[start + i].up = up[i];
+		}
+	}
+}
+
+void GPSMotionTracker::setOrigin(double latitude, double longitude, double height)
+{
+	local.setOrigin(latitude, longitude, height);
+	originGiven = true;
+}
+
+void GPSMotionTracker::reset()
+{
+	current = GPSMotion();
+	lastTime = 0;
+	headingEast = 0;
+	headingNorth = 0;
+}
+
+const GPSMotion& GPSMotionTracker::add(const GPSFix& fix)
+{
+	if(!fix.valid())
+		return current;
+
+	double phi = fix.latitude * RADIANS;
+	double lambda = fix.longitude * RADIANS;
+	double sinLatitude = std::sin(phi);
+	double height = ellipsoidHeight(fix);
+
+	if((current.fixes == 0) && !originGiven)
+		local.setOrigin(fix.latitude, fix.longitude, height);
+
+	current.ecef = ecefFromTrig(sinLatitude, std::cos(phi), std::sin(lambda), std::cos(lambda), height);
+	current.enu = local.toENU(current.ecef);
+
+	Position here{fix.latitude, fix.longitude, sinLatitude * sinLatitude};
+	int64_t time = gpsFixTime(fix.date, fix.time);
+
+	if(current.fixes++ == 0)
+	{
+		current.speed = fix.speedKnots * GPS_METRES_PER_SECOND_PER_KNOT;
+		current.heading = fix.course;
+		headingEast = std::sin(fix.course * RADIANS);
+		headingNorth = std::cos(fix.course * RADIANS);
+		last = counted = here;
+		lastTime = time;
+		return current;
+	}
+
+	//a repeated or out of order time still moves the position, but says
+	//nothing about speed
+	double seconds = (time - lastTime) / 1000.0;
+	lastTime = time;
+
+	double north, east;
+	localStep(last.latitude, last.longitude, last.sin2Latitude, here.latitude, here.longitude, here.sin2Latitude, north, east);
+	double step = std::sqrt(north*north + east*east);
+
+	double speed;
+	double headingE = east;
+	double headingN = north;
+	if(fix.sentences & (FIX_RMC | FIX_VTG | FIX_PVT))
+	{
+		speed = fix.speedKnots * GPS_METRES_PER_SECOND_PER_KNOT;
+		headingE = std::sin(fix.course * RADIANS);
+		headingN = std::cos(fix.course * RADIANS);
+	}
+	else
+		speed = (seconds > 0) ? step / seconds : current.speed;
+
+	double alpha = 1;
+	if((config.smoothingSeconds > 0) && (seconds > 0))
+		alpha = 1 - std::exp(-seconds / config.smoothingSeconds);
+	else if(config.smoothingSeconds > 0)
+		alpha = 0;
+
+	current.speed += alpha * (speed - current.speed);
+
+	bool moving = speed >= config.stationarySpeed;
+	double length = std::sqrt(headingE*headingE + headingN*headingN);
+	if(moving && (length > 0))
+	{
+		headingEast += alpha * (headingE / length - headingEast);
+		headingNorth += alpha * (headingN / length - headingNorth);
+		double heading = std::atan2(headingEast, headingNorth) / RADIANS;
+		current.heading = (heading < 0) ? heading + 360 : heading;
+	}
+
+	//standing still, the jitter stays out of the distance
+	if(moving)
+	{
+		localStep(counted.latitude, counted.longitude, counted.sin2Latitude, here.latitude, here.longitude, here.sin2Latitude, north, east);
+		current.distance += std::sqrt(north*north + east*east);
+		counted = here;
+	}
+
+	last = here;
+	return current;
+}
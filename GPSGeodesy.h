@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "GPSFix.h"
+#include "GPSTrackLog.h"
+
+// WGS84 geodesy shared by everything that needs metres rather than
+// degrees: earth-centred (ECEF) and local east-north-up (ENU) coordinates,
+// distances and bearings, and a tracker that keeps distance, speed and
+// heading up to date one fix at a time.
+//
+// Heights are above the ellipsoid; for a GPSFix that is altitude plus
+// heightOfGeoid.
+
+static const double GPS_METRES_PER_SECOND_PER_KNOT = 0.514444;
+
+struct GPSECEF
+{
+	double x = 0;
+	double y = 0;
+	double z = 0;
+};
+
+struct GPSENU
+{
+	double east = 0;
+	double north = 0;
+	double up = 0;
+};
+
+GPSECEF gpsToECEF(double latitude, double longitude, double height);
+GPSECEF gpsToECEF(const GPSFix& fix);
+
+// Back to latitude, longitude and height, Bowring's method: one step,
+// well under a millimetre anywhere near the surface.
+void gpsFromECEF(const GPSECEF& point, double& latitude, double& longitude, double& height);
+
+// Metres between two points over the ellipsoid, from the meridian and
+// prime vertical radii at their mean latitude. Within a millimetre per
+// kilometre for points up to 10 km apart below 60 degrees latitude, the
+// error growing with the square of the distance; one sine per point
+// instead of a haversine per pair.
+double gpsDistance(double latitude1, double longitude1, double latitude2, double longitude2);
+
+// Degrees true from the first point towards the second, same model.
+double gpsBearing(double latitude1, double longitude1, double latitude2, double longitude2);
+
+// Metres along a recorded track. With cumulative, also the distance up to
+// each point, cumulative[0] being 0.
+double gpsTrackDistance(const GPSTrackPoint* points, size_t count, double* cumulative = nullptr);
+
+// East-north-up around a fixed origin. The origin's sines, cosines and
+// ECEF position are worked out once, so a conversion costs only the
+// point's own trigonometry and a rotation.
+
+class GPSLocalFrame
+{
+public:
+	GPSLocalFrame() { setOrigin(0, 0, 0); }
+	GPSLocalFrame(double latitude, double longitude, double height) { setOrigin(latitude, longitude, height); }
+
+	void setOrigin(double latitude, double longitude, double height);
+	const GPSECEF& origin() const { return originECEF; }
+
+	GPSENU toENU(const GPSECEF& point) const;
+	GPSENU toENU(double latitude, double longitude, double height) const { return toENU(gpsToECEF(latitude, longitude, height)); }
+	GPSECEF toECEF(const GPSENU& point) const;
+
+	// count points at once from and to separate arrays, in blocks that
+	// keep the trigonometry apart from the rotation so the compiler can
+	// vectorize the latter. Heights may be nullptr for 0.
+	void toENU(const double* latitude, const double* longitude, const double* height, size_t count,
+		double* east, double* north, double* up) const;
+	void toENU(const GPSTrackPoint* points, size_t count, GPSENU* out) const;
+
+private:
+	double sinLatitude;
+	double cosLatitude;
+	double sinLongitude;
+	double cosLongitude;
+	GPSECEF originECEF;
+};
+
+struct GPSMotionConfig
+{
+	// Time constant of the speed and heading smoothing, 0 for none.
+	double smoothingSeconds = 2;
+
+	// Below this speed in m/s the receiver counts as standing still: its
+	// position jitter is not added to the distance and the heading holds.
+	double stationarySpeed = 0.5;
+};
+
+// Where a vehicle has got to, as of its last valid fix.
+struct GPSMotion
+{
+	uint64_t fixes = 0;			//valid fixes taken
+	double distance = 0;		//metres along the track
+	double speed = 0;			//m/s, smoothed
+	double heading = 0;			//degrees true, smoothed
+	GPSECEF ecef;
+	GPSENU enu;					//around the origin
+};
+
+// Keeps a GPSMotion up to date one fix at a time.
+//
+// Speed and heading come from the fix when the receiver reported them
+// (RMC, VTG or NAV-PVT) and from the step since the previous fix
+// otherwise, and are smoothed exponentially over time so that a changing
+// fix rate does not change the smoothing. Heading is smoothed as a unit
+// vector, so it passes through north without swinging round. The ENU
+// origin is the first valid fix unless one was set.
+
+class GPSMotionTracker
+{
+public:
+	void setConfig(const GPSMotionConfig& newConfig) { config = newConfig; }
+	void setOrigin(double latitude, double longitude, double height);
+
+	// Invalid fixes are ignored.
+	const GPSMotion& add(const GPSFix& fix);
+
+	const GPSMotion& motion() const { return current; }
+	const GPSLocalFrame& frame() const { return local; }
+
+	// Starts a new track, keeping the config and any origin set.
+	void reset();
+
+private:
+	struct Position
+	{
+		double latitude;
+		double longitude;
+		double sin2Latitude;
+	};
+
+	GPSMotionConfig config;
+	GPSLocalFrame local;
+	bool originGiven = false;
+
+	GPSMotion current;
+	int64_t lastTime = 0;
+	Position last;
+	Position counted;			//last position added to the distance
+
+	//heading as a smoothed unit vector
+	double headingEast = 0;
+	double headingNorth = 0;
+};
@@ -0,0 +1,322 @@
+#include "GPSInputSource.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+struct BaudRate
+{
+	int baud;
+	speed_t speed;
+};
+
+static const BaudRate baudRates[] = {
+	{4800, B4800}, {9600, B9600}, {19200, B19200}, {38400, B38400},
+	{57600, B57600}, {115200, B115200}, {230400, B230400},
+	{460800, B460800}, {921600, B921600},
+};
+
+static int setNonBlocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+	return (flags >= 0) && (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0);
+}
+
+int parseSourceSpec(const std::string& spec, GPSSourceConfig& config)
+{
+	config = GPSSourceConfig();
+
+	if(spec == "-")
+	{
+		config.type = GPSSourceConfig::PIPE;
+		config.path = spec;
+		return 1;
+	}
+	if(spec == "pty")
+	{
+		config.type = GPSSourceConfig::PTY;
+		config.path.clear();
+		return 1;
+	}
+	if(spec.compare(0, 4, "udp:") == 0)
+	{
+		config.type = GPSSourceConfig::UDP;
+		config.port = atoi(spec.c_str() + 4);
+		return (config.port > 0) && (config.port < 65536);
+	}
+	if(spec.compare(0, 5, "fifo:") == 0)
+	{
+		config.type = GPSSourceConfig::PIPE;
+		config.path = spec.substr(5);
+		return 1;
+	}
+
+	struct stat st;
+	if(stat(spec.c_str(), &st) == 0)
+	{
+		if(S_ISREG(st.st_mode))
+		{
+			config.type = GPSSourceConfig::FILE;
+			config.path = spec;
+			return 1;
+		}
+		if(S_ISFIFO(st.st_mode))
+		{
+			config.type = GPSSourceConfig::PIPE;
+			config.path = spec;
+			return 1;
+		}
+	}
+
+	//anything else is a serial device, optionally with @baud
+	config.type = GPSSourceConfig::SERIAL;
+	size_t at = spec.rfind('@');
+	config.path = spec.substr(0, at);
+	if(at != std::string::npos)
+		config.baud = atoi(spec.c_str() + at + 1);
+	return !config.path.empty();
+}
+
+GPSInputSource::~GPSInputSource()
+{
+	close();
+}
+
+void GPSInputSource::close()
+{
+	if(sourceFd >= 0)
+		::close(sourceFd);
+	sourceFd = -1;
+}
+
+ssize_t GPSInputSource::read(char* buffer, size_t length)
+{
+	return ::read(sourceFd, buffer, length);
+}
+
+ssize_t GPSInputSource::write(const char* data, size_t length)
+{
+	return ::write(sourceFd, data, length);
+}
+
+GPSSerialSource::GPSSerialSource(const std::string& device, int baud)
+	: device(device), baud(baud)
+{
+}
+
+int GPSSerialSource::open()
+{
+	close();
+
+	speed_t speed = 0;
+	for(const BaudRate& rate : baudRates)
+		if(rate.baud == baud)
+			speed = rate.speed;
+	if(speed == 0)
+		return 0;
+
+	sourceFd = ::open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if(sourceFd < 0)
+		return 0;
+
+	//raw 8N1, no echo or line processing, reads return whatever is waiting
+	struct termios tty;
+	if(tcgetattr(sourceFd, &tty) < 0)
+	{
+		close();
+		return 0;
+	}
+
+	cfmakeraw(&tty);
+	tty.c_cflag |= CLOCAL | CREAD;
+	tty.c_cflag &= ~(CSTOPB | CRTSCTS);
+	tty.c_cc[VMIN] = 0;
+	tty.c_cc[VTIME] = 0;
+	cfsetispeed(&tty, speed);
+	cfsetospeed(&tty, speed);
+
+	if(tcsetattr(sourceFd, TCSANOW, &tty) < 0)
+	{
+		close();
+		return 0;
+	}
+
+	tcflush(sourceFd, TCIFLUSH);
+	return 1;
+}
+
+GPSFileSource::GPSFileSource(const std::string& path) : path(path)
+{
+}
+
+GPSFileSource::~GPSFileSource()
+{
+	close();
+}
+
+int GPSFileSource::open()
+{
+	close();
+
+	if(path == "-")
+	{
+		//do not take ownership of stdin, and give it back blocking as it
+		//was, O_NONBLOCK is on the file description both share
+		int fd = dup(STDIN_FILENO);
+		if(fd < 0)
+			return 0;
+		sourceFd = fd;
+		stdinFlags = fcntl(fd, F_GETFL, 0);
+	}
+	else
+	{
+		//a named pipe is held open for writing too, so it never reads as
+		//ended between one writer closing and the next one opening
+		struct stat st;
+		bool fifo = (stat(path.c_str(), &st) == 0) && S_ISFIFO(st.st_mode);
+		sourceFd = ::open(path.c_str(), (fifo ? O_RDWR : O_RDONLY) | O_NONBLOCK);
+	}
+
+	if(sourceFd < 0)
+		return 0;
+
+	if(!setNonBlocking(sourceFd))
+	{
+		close();
+		return 0;
+	}
+	return 1;
+}
+
+void GPSFileSource::close()
+{
+	if((stdinFlags >= 0) && (sourceFd >= 0))
+		fcntl(sourceFd, F_SETFL, stdinFlags);
+	stdinFlags = -1;
+	GPSInputSource::close();
+}
+
+ssize_t GPSFileSource::write(const char*, size_t)
+{
+	//stdin may be a terminal, which is no receiver
+	errno = EBADF;
+	return -1;
+}
+
+GPSPtySource::~GPSPtySource()
+{
+	close();
+}
+
+void GPSPtySource::close()
+{
+	if(slaveFd >= 0)
+		::close(slaveFd);
+	slaveFd = -1;
+	GPSInputSource::close();
+}
+
+int GPSPtySource::open()
+{
+	close();
+
+	sourceFd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if(sourceFd < 0)
+		return 0;
+
+	if((grantpt(sourceFd) < 0) || (unlockpt(sourceFd) < 0))
+	{
+		close();
+		return 0;
+	}
+
+	char name[128];
+	if(ptsname_r(sourceFd, name, sizeof(name)) != 0)
+	{
+		close();
+		return 0;
+	}
+	slave = name;
+
+	slaveFd = ::open(name, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if(slaveFd < 0)
+	{
+		close();
+		return 0;
+	}
+
+	//the line discipline must not echo, translate or buffer by line
+	struct termios tty;
+	if(tcgetattr(slaveFd, &tty) == 0)
+	{
+		cfmakeraw(&tty);
+		tcsetattr(slaveFd, TCSANOW, &tty);
+	}
+	return 1;
+}
+
+GPSUDPSource::GPSUDPSource(int port) : port(port)
+{
+}
+
+int GPSUDPSource::open()
+{
+	close();
+
+	sourceFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	if(sourceFd < 0)
+		return 0;
+
+	int reuse = 1;
+	setsockopt(sourceFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if(bind(sourceFd, (struct sockaddr*)&address, sizeof(address)) < 0)
+	{
+		close();
+		return 0;
+	}
+	return 1;
+}
+
+ssize_t GPSUDPSource::read(char* buffer, size_t length)
+{
+	//an empty datagram is not the end of a socket that never ends
+	ssize_t n = recv(sourceFd, buffer, length, 0);
+	if(n == 0)
+	{
+		errno = EAGAIN;
+		return -1;
+	}
+	return n;
+}
+
+std::unique_ptr<GPSInputSource> makeInputSource(const GPSSourceConfig& config)
+{
+	switch(config.type)
+	{
+	case GPSSourceConfig::SERIAL:
+		return std::unique_ptr<GPSInputSource>(new GPSSerialSource(config.path, config.baud));
+	case GPSSourceConfig::FILE:
+	case GPSSourceConfig::PIPE:
+		return std::unique_ptr<GPSInputSource>(new GPSFileSource(config.path));
+	case GPSSourceConfig::PTY:
+		return std::unique_ptr<GPSInputSource>(new GPSPtySource());
+	case GPSSourceConfig::UDP:
+		return std::unique_ptr<GPSInputSource>(new GPSUDPSource(config.port));
+	}
+	return nullptr;
+}
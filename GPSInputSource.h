@@ -0,0 +1,124 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <sys/types.h>
+
+// Where the decoder's bytes come from.
+//
+// Every source is a non-blocking file descriptor that GPSEventLoop waits
+// on, so a worker thread sleeps until bytes arrive and then drains them in
+// large read() chunks.
+//
+//  /dev/ttyACM0@38400   serial tty in raw mode at the given baud rate
+//  log.nmea             regular file, read once to the end
+//  -                    stdin, e.g. piped from another program
+//  fifo:/tmp/gps        named pipe, which stays open across writers
+//                       coming and going and so never ends
+//  pty                  pseudo-terminal master, write NMEA to slaveName()
+//  udp:10110            UDP datagrams sent to 127.0.0.1:10110
+
+struct GPSSourceConfig
+{
+	enum Type { SERIAL, FILE, PIPE, PTY, UDP };
+
+	Type type = SERIAL;
+	std::string path = "/dev/ttyACM0";
+	int baud = 38400;
+	int port = 10110;
+};
+
+// Fills config from a source string as listed above. Returns 1 on success.
+int parseSourceSpec(const std::string& spec, GPSSourceConfig& config);
+
+class GPSInputSource
+{
+public:
+	virtual ~GPSInputSource();
+
+	// Returns 1 when the source is open and ready to be polled.
+	virtual int open() = 0;
+	virtual void close();
+
+	// Same contract as ::read(): bytes read, 0 at end of input, -1 with
+	// errno EAGAIN when nothing is waiting.
+	virtual ssize_t read(char* buffer, size_t length);
+
+	// Bytes for the receiver, e.g. configuration. Same contract as
+	// ::write(); -1 on sources that only read.
+	virtual ssize_t write(const char* data, size_t length);
+
+	bool isOpen() const { return sourceFd >= 0; }
+	int fd() const { return sourceFd; }
+	virtual std::string name() const = 0;
+
+protected:
+	int sourceFd = -1;
+};
+
+class GPSSerialSource : public GPSInputSource
+{
+public:
+	GPSSerialSource(const std::string& device, int baud);
+
+	int open() override;
+	std::string name() const override { return device; }
+
+private:
+	std::string device;
+	int baud;
+};
+
+// Regular files and named pipes; "-" is stdin.
+class GPSFileSource : public GPSInputSource
+{
+public:
+	GPSFileSource(const std::string& path);
+	~GPSFileSource();
+
+	int open() override;
+	void close() override;
+	ssize_t write(const char* data, size_t length) override;
+	std::string name() const override { return path; }
+
+private:
+	std::string path;
+
+	//stdin's flags before open(), which its duplicate shares
+	int stdinFlags = -1;
+};
+
+class GPSPtySource : public GPSInputSource
+{
+public:
+	~GPSPtySource();
+
+	int open() override;
+	void close() override;
+	std::string name() const override { return slave; }
+
+	// Device a simulator or replay tool should write NMEA to.
+	const std::string& slaveName() const { return slave; }
+
+private:
+	std::string slave;
+
+	//held open so the master never reports a hang up between writers
+	int slaveFd = -1;
+};
+
+class GPSUDPSource : public GPSInputSource
+{
+public:
+	GPSUDPSource(int port);
+
+	int open() override;
+	ssize_t read(char* buffer, size_t length) override;
+	std::string name() const override { return "udp:" + std::to_string(port); }
+
+private:
+	int port;
+};
+
+std::unique_ptr<GPSInputSource> makeInputSource(const GPSSourceConfig& config);
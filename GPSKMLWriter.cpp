@@ -0,0 +1,315 @@
+#include "GPSKMLWriter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char KML_HEADER[] =
+	"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	"<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n"
+	"\t<Document>\n"
+	"\t\t<name>testing kml</name>\n"
+	"\t\t<description/>\n"
+	"\t\t<Style id=\"test_line\">"
+	"\t\t\t<IconStyle><Icon>\n"
+	"\t\t\t\t<href>http://maps.google.com/mapfiles/kml/pal3/icon19.png</href>\n"
+	"\t\t\t</Icon></IconStyle>\n"
+	"\t\t\t<LineStyle><color>ff0000ff</color><width>8</width></LineStyle>\n"
+	"\t\t</Style>\n"
+	"\t\t\t<Placemark>\n"
+	"\t\t\t\t<name>Placemark Name</name>\n"
+	"\t\t\t\t<styleUrl>#test_line</styleUrl>\n"
+	"\t\t\t\t<LineString>\n"
+	"\t\t\t\t\t<tessellate>1</tessellate>\n"
+	"\t\t\t\t\t<coordinates>\n";
+
+static const char KML_TRAILER[] =
+	"\t\t\t\t\t</coordinates>\n"
+	"\t\t\t\t</LineString>\n"
+	"\t\t\t</Placemark>\n"
+	"\t</Document>\n"
+	"</kml>\n";
+
+static const char POINT_INDENT[] = "\t\t\t\t\t\t";
+
+//how much of the end of a track recover() looks at
+static const size_t RECOVER_WINDOW = 4096;
+
+static int writeAll(int fd, const char* data, size_t length, uint64_t offset)
+{
+	while(length > 0)
+	{
+		ssize_t n = pwrite(fd, data, length, offset);
+		if(n <= 0)
+			return 0;
+		data += n;
+		length -= n;
+		offset += n;
+	}
+	return 1;
+}
+
+// KMLOutput.kml -> KMLOutput.2.kml
+static std::string numberedPath(const std::string& path, int index)
+{
+	if(index == 0)
+		return path;
+
+	size_t dot = path.rfind('.');
+	size_t slash = path.rfind('/');
+	if((dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash)))
+		return path + "." + std::to_string(index);
+	return path.substr(0, dot) + "." + std::to_string(index) + path.substr(dot);
+}
+
+// A line written by add(), without its newline.
+static bool isPointLine(const char* line, size_t length)
+{
+	size_t indent = sizeof(POINT_INDENT) - 1;
+	if((length <= indent) || memcmp(line, POINT_INDENT, indent))
+		return false;
+
+	for(size_t i = indent; i < length; i++)
+		if(!strchr("0123456789.,-+eE", line[i]))
+			return false;
+	return true;
+}
+
+GPSKMLWriter::~GPSKMLWriter()
+{
+	close();
+}
+
+int GPSKMLWriter::open(const GPSKMLConfig& newConfig)
+{
+	close();
+
+	config = newConfig;
+	fileIndex = 0;
+
+	//carry on in the last file an earlier run rotated into
+	bool rotating = config.rotateBytes || (config.rotateAfter.count() > 0);
+	while(config.append && rotating && (access(numberedPath(config.path, fileIndex + 1).c_str(), F_OK) == 0))
+		fileIndex++;
+
+	if(!openFile(numberedPath(config.path, fileIndex), config.append))
+		return 0;
+
+	pending.reserve(config.bufferSize + 64);
+	writing.reserve(config.bufferSize + 64 + sizeof(KML_TRAILER));
+	flushRequested = false;
+	stopping = false;
+	points = 0;
+	dropped = 0;
+	accepting = true;
+
+	writer = std::thread(&GPSKMLWriter::writerThread, this);
+	return 1;
+}
+
+int GPSKMLWriter::openFile(const std::string& path, bool append)
+{
+	int flags = O_RDWR | O_CREAT | O_CLOEXEC | (append ? 0 : O_TRUNC);
+	int newFd = ::open(path.c_str(), flags, 0644);
+	if(newFd < 0)
+		return 0;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		currentPath = path;
+	}
+	fd = newFd;
+	fileOpened = std::chrono::steady_clock::now();
+
+	if(append && recover())
+		return 1;
+
+	//new track, or nothing worth keeping in the old one
+	dataEnd = sizeof(KML_HEADER) - 1;
+	if((ftruncate(fd, 0) < 0) ||
+		!writeAll(fd, KML_HEADER, dataEnd, 0) ||
+		!writeAll(fd, KML_TRAILER, sizeof(KML_TRAILER) - 1, dataEnd))
+	{
+		::close(fd);
+		fd = -1;
+		return 0;
+	}
+	return 1;
+}
+
+int GPSKMLWriter::recover()
+{
+	struct stat st;
+	size_t headerLength = sizeof(KML_HEADER) - 1;
+	if((fstat(fd, &st) < 0) || ((size_t)st.st_size < headerLength))
+		return 0;
+
+	char header[sizeof(KML_HEADER)];
+	if((pread(fd, header, headerLength, 0) != (ssize_t)headerLength) || memcmp(header, KML_HEADER, headerLength))
+		return 0;
+
+	uint64_t start = headerLength;
+	if(st.st_size - start > RECOVER_WINDOW)
+		start = st.st_size - RECOVER_WINDOW;
+
+	char tail[RECOVER_WINDOW];
+	ssize_t length = pread(fd, tail, st.st_size - start, start);
+	if(length < 0)
+		return 0;
+
+	//skip the partial line at the start of the window
+	const char* p = tail;
+	const char* end = tail + length;
+	if(start > headerLength)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		p = newline ? newline + 1 : end;
+	}
+
+	//keep every whole point; stop at the closing tags or at whatever a
+	//crash left behind
+	const char* kept = p;
+	while(p < end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		if(!newline || !isPointLine(p, newline - p))
+			break;
+		p = newline + 1;
+		kept = p;
+	}
+
+	dataEnd = start + (kept - tail);
+	if(ftruncate(fd, dataEnd) < 0)
+		return 0;
+	return writeAll(fd, KML_TRAILER, sizeof(KML_TRAILER) - 1, dataEnd);
+}
+
+void GPSKMLWriter::close()
+{
+	if(!writer.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+		accepting = false;
+	}
+	wake.notify_one();
+	writer.join();
+
+	if(fd >= 0)
+	{
+		fdatasync(fd);
+		::close(fd);
+	}
+	fd = -1;
+}
+
+int GPSKMLWriter::add(const GPSFix& fix)
+{
+	char line[96];
+	int length = snprintf(line, sizeof(line), "%s%.10g,%.10g,0\n", POINT_INDENT, fix.longitude, fix.latitude);
+
+	bool full;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if(!accepting)
+			return 0;
+
+		pending.append(line, length);
+		points++;
+		full = pending.size() >= config.bufferSize;
+	}
+
+	if(full)
+		wake.notify_one();
+	return 1;
+}
+
+void GPSKMLWriter::flush()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		flushRequested = true;
+	}
+	wake.notify_one();
+}
+
+std::string GPSKMLWriter::path() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return currentPath;
+}
+
+uint64_t GPSKMLWriter::pointCount() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return points;
+}
+
+void GPSKMLWriter::writeOut()
+{
+	if(writing.empty())
+		return;
+
+	//the points go where the closing tags were, followed by new ones
+	size_t length = writing.size();
+	uint64_t lines = std::count(writing.begin(), writing.end(), '\n');
+	writing.append(KML_TRAILER, sizeof(KML_TRAILER) - 1);
+	if((fd >= 0) && writeAll(fd, writing.data(), writing.size(), dataEnd))
+		dataEnd += length;
+	else
+		dropped += lines;
+	writing.clear();
+}
+
+void GPSKMLWriter::rotate()
+{
+	//the last open failed, try the same file again
+	if(fd >= 0)
+	{
+		bool tooBig = config.rotateBytes && (dataEnd + sizeof(KML_TRAILER) >= config.rotateBytes);
+		bool tooOld = (config.rotateAfter.count() > 0) && (std::chrono::steady_clock::now() - fileOpened >= config.rotateAfter);
+		if(!tooBig && !tooOld)
+			return;
+
+		fdatasync(fd);
+		::close(fd);
+		fd = -1;
+		fileIndex++;
+	}
+
+	openFile(numberedPath(config.path, fileIndex), config.append);
+}
+
+void GPSKMLWriter::writerThread()
+{
+	auto ready = [this]{ return stopping || flushRequested || (pending.size() >= config.bufferSize); };
+
+	std::unique_lock<std::mutex> guard(lock);
+	for(;;)
+	{
+		if(config.flushInterval.count() > 0)
+			wake.wait_for(guard, config.flushInterval, ready);
+		else
+			wake.wait(guard, ready);
+
+		//write without holding up add()
+		writing.swap(pending);
+		flushRequested = false;
+		bool last = stopping;
+		guard.unlock();
+
+		writeOut();
+		if(!last)
+			rotate();
+
+		guard.lock();
+		if(last)
+			break;
+	}
+}
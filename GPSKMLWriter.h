@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "GPSFix.h"
+
+struct GPSKMLConfig
+{
+	std::string path = "KMLOutput.kml";
+
+	// Continue the track already in path instead of starting a new one.
+	// With rotation, that is the last of the numbered files, and no file
+	// rotated into is truncated.
+	bool append = false;
+
+	// Points are written once this much is buffered or flushInterval has
+	// passed, whichever comes first.
+	size_t bufferSize = 64 << 10;
+	std::chrono::milliseconds flushInterval{5000};
+
+	// Start a new file, KMLOutput.1.kml, KMLOutput.2.kml..., once the
+	// current one reaches rotateBytes or has been open for rotateAfter.
+	// 0 disables either limit.
+	uint64_t rotateBytes = 0;
+	std::chrono::seconds rotateAfter{0};
+};
+
+// Writes fixes as a KML LineString track.
+//
+// The file stays open for the whole track. add() only formats the point
+// into a memory buffer; a background thread writes the buffer out and
+// rewrites the closing tags after it each time, so the file on disk is a
+// complete KML document after every flush and a crash loses at most the
+// points still buffered. Reopening a track with append set finds the
+// closing tags, or the last complete point if a write was cut short, and
+// carries on from there.
+
+class GPSKMLWriter
+{
+public:
+	GPSKMLWriter() = default;
+	~GPSKMLWriter();
+
+	GPSKMLWriter(const GPSKMLWriter&) = delete;
+	GPSKMLWriter& operator=(const GPSKMLWriter&) = delete;
+
+	int open(const GPSKMLConfig& config);
+
+	// Writes what is buffered and closes the file.
+	void close();
+
+	// Queues one point. Returns 0 when the writer is not open.
+	int add(const GPSFix& fix);
+
+	// Asks the writer thread to write the buffer now.
+	void flush();
+
+	bool isOpen() const { return accepting; }
+
+	// File currently being written, which changes on rotation.
+	std::string path() const;
+
+	// Points queued since open().
+	uint64_t pointCount() const;
+
+	// Points lost because a file could not be opened or written. The writer
+	// tries the file again on its next flush.
+	uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+	int openFile(const std::string& path, bool append);
+	int recover();
+	void writeOut();
+	void rotate();
+	void writerThread();
+
+	GPSKMLConfig config;
+
+	int fd = -1;
+	std::string currentPath;
+	int fileIndex = 0;
+	uint64_t dataEnd = 0;			//where the closing tags start
+	std::chrono::steady_clock::time_point fileOpened;
+
+	mutable std::mutex lock;
+	std::condition_variable wake;
+	std::string pending;
+	bool flushRequested = false;
+	bool stopping = false;
+	std::atomic<bool> accepting{false};
+
+	std::string writing;			//owned by the writer thread
+	uint64_t points = 0;
+	std::atomic<uint64_t> dropped{0};
+
+	std::thread writer;
+};
@@ -0,0 +1,135 @@
+#include "GPSLogReplay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "NMEAFields.h"
+#include "NMEANumeric.h"
+
+//large enough to amortize the call, small enough to notice stop() quickly
+static const size_t CHUNK_SIZE = 4 << 20;
+
+static const int32_t MILLIS_PER_DAY = 24*60*60*1000;
+
+GPSLogReplay::GPSLogReplay(GPSDecoder& decoder) : decoder(decoder)
+{
+}
+
+GPSLogReplay::~GPSLogReplay()
+{
+	close();
+}
+
+int GPSLogReplay::open(const std::string& path)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return 0;
+
+	struct stat st;
+	if((fstat(fd, &st) < 0) || (st.st_size == 0))
+	{
+		::close(fd);
+		return 0;
+	}
+
+	void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(mapped == MAP_FAILED)
+		return 0;
+
+	madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+
+	map = (const char*)mapped;
+	mapLength = st.st_size;
+	done = false;
+	return 1;
+}
+
+void GPSLogReplay::close()
+{
+	if(map)
+		munmap((void*)map, mapLength);
+	map = nullptr;
+	mapLength = 0;
+}
+
+size_t GPSLogReplay::run(bool paced)
+{
+	running = true;
+	size_t decoded = paced ? runPaced() : runFast();
+
+	decoded += decoder.flush();
+
+	done = true;
+	return decoded;
+}
+
+size_t GPSLogReplay::runFast()
+{
+	size_t decoded = 0;
+
+	for(size_t offset = 0; running && (offset < mapLength); offset += CHUNK_SIZE)
+	{
+		size_t length = std::min(CHUNK_SIZE, mapLength - offset);
+		decoded += decoder.decode(map + offset, length);
+	}
+	return decoded;
+}
+
+size_t GPSLogReplay::runPaced()
+{
+	auto start = std::chrono::steady_clock::now();
+	int32_t firstTime = -1;
+	int32_t lastTime = -1;
+	int64_t dayOffset = 0;
+	size_t decoded = 0;
+
+	const char* p = map;
+	const char* end = map + mapLength;
+
+	while(running && (p < end))
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		const char* stop = newline ? newline + 1 : end;
+
+		//a new time waits for its moment before the line is decoded
+		int32_t time = lineTime(p, stop - p);
+		if((time >= 0) && (time != lastTime))
+		{
+			//the log crossed midnight UTC
+			if(lastTime >= 0 && time < lastTime - MILLIS_PER_DAY/2)
+				dayOffset += MILLIS_PER_DAY;
+			lastTime = time;
+
+			if(firstTime < 0)
+				firstTime = time;
+
+			std::this_thread::sleep_until(start + std::chrono::milliseconds(dayOffset + time - firstTime));
+		}
+
+		decoded += decoder.decode(p, stop - p);
+		p = stop;
+	}
+	return decoded;
+}
+
+int32_t GPSLogReplay::lineTime(const char* line, size_t length)
+{
+	if((length < 7) || (line[0] != '$') || (memcmp(line + 3, "GGA", 3) && memcmp(line + 3, "RMC", 3)))
+		return -1;
+
+	NMEAFields fields(line, length);
+	NMEATime time;
+	nmeaParseTime(fields[1], time);
+	return time.millisOfDay();
+}
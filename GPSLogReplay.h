@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+#include "GPSDecoder.h"
+
+// Replays a raw NMEA log file through a GPSDecoder.
+//
+// The log is memory mapped and handed to GPSDecoder::decode() in place, so
+// no byte is copied on the way in. By default the log is decoded as fast
+// as the CPU allows; paced replay sleeps between fixes so they come out at
+// the rate they were recorded, using the GGA/RMC fix times.
+
+class GPSLogReplay
+{
+public:
+	GPSLogReplay(GPSDecoder& decoder);
+	~GPSLogReplay();
+
+	int open(const std::string& path);
+	void close();
+
+	// Decodes the whole log and returns the number of sentences decoded.
+	size_t run(bool paced = false);
+	void stop() { running = false; }
+
+	bool finished() const { return done; }
+	size_t size() const { return mapLength; }
+
+private:
+	size_t runFast();
+	size_t runPaced();
+
+	// Time of day of a GGA or RMC line, -1 for any other.
+	static int32_t lineTime(const char* line, size_t length);
+
+	GPSDecoder& decoder;
+
+	const char* map = nullptr;
+	size_t mapLength = 0;
+
+	std::atomic<bool> running{false};
+	std::atomic<bool> done{false};
+};
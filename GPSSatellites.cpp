@@ -0,0 +1,218 @@
+#include "GPSSatellites.h"
+
+GPSConstellation gpsConstellation(const NMEATalker& talker, int prn)
+{
+	if(talker == "GL")
+		return CONSTELLATION_GLONASS;
+	if(talker == "GA")
+		return CONSTELLATION_GALILEO;
+	if((talker == "GB") || (talker == "BD"))
+		return CONSTELLATION_BEIDOU;
+	if(talker == "GQ")
+		return CONSTELLATION_QZSS;
+	if(!(talker == "GP") && !(talker == "GN"))
+		return CONSTELLATION_UNKNOWN;
+
+	//NMEA 4.0 numbering
+	if((prn >= 1) && (prn <= 32))
+		return CONSTELLATION_GPS;
+	if((prn >= 33) && (prn <= 64))
+		return CONSTELLATION_SBAS;
+	if((prn >= 65) && (prn <= 96))
+		return CONSTELLATION_GLONASS;
+	if((prn >= 193) && (prn <= 200))
+		return CONSTELLATION_QZSS;
+	return CONSTELLATION_UNKNOWN;
+}
+
+const char* gpsConstellationName(int constellation)
+{
+	static const char* names[CONSTELLATION_COUNT] = {"??", "GPS", "SBAS", "GLONASS", "Galileo", "BeiDou", "QZSS"};
+
+	if((constellation < 0) || (constellation >= CONSTELLATION_COUNT))
+		return names[CONSTELLATION_UNKNOWN];
+	return names[constellation];
+}
+
+int GPSSatTable::find(int constellationID, int PRN) const
+{
+	for(int i = 0; i < count; i++)
+		if((prn[i] == PRN) && (constellation[i] == constellationID))
+			return i;
+	return -1;
+}
+
+int GPSSatTable::tracked() const
+{
+	int n = 0;
+	for(int i = 0; i < count; i++)
+		n += SNR[i] > 0;
+	return n;
+}
+
+float GPSSatTable::meanSNR() const
+{
+	int sum = 0;
+	int n = 0;
+	for(int i = 0; i < count; i++)
+	{
+		sum += SNR[i];
+		n += SNR[i] > 0;
+	}
+	return n ? (float)sum / n : 0;
+}
+
+int GPSSatelliteTracker::groupIndex(const NMEATalker& talker)
+{
+	for(int i = 0; i < groupCount; i++)
+		if(groups[i].talker.view() == talker.view())
+			return i;
+
+	if(groupCount == MAX_TALKERS)
+		return -1;
+
+	Group& group = groups[groupCount];
+	group.talker = talker;
+	group.total = 0;
+	group.next = 0;
+	group.count = 0;
+	return groupCount++;
+}
+
+bool GPSSatelliteTracker::add(const GSVStruct& GSV)
+{
+	int index = groupIndex(GSV.talker);
+	if(index < 0)
+		return false;
+
+	Group& group = groups[index];
+
+	if(GSV.sentence == 1)
+	{
+		group.total = GSV.fullDataSentNum;
+		group.next = 1;
+		group.count = 0;
+	}
+
+	//lost or reordered sentence, wait for the next group
+	if((group.next == 0) || (GSV.sentence != group.next) || (GSV.fullDataSentNum != group.total))
+	{
+		group.next = 0;
+		return false;
+	}
+
+	for(int i = 0; (i < GSV.satCount) && (group.count < MAX_GROUP_SATELLITES); i++)
+	{
+		if(GSV.satPRNNum[i] <= 0)
+			continue;
+
+		group.prn[group.count] = GSV.satPRNNum[i];
+		group.elevation[group.count] = GSV.elevation[i];
+		group.azimuth[group.count] = GSV.azimuth[i];
+		group.SNR[group.count] = GSV.SNR[i];
+		group.count++;
+	}
+
+	if(group.next++ < group.total)
+		return false;
+
+	group.next = 0;
+	commit(index);
+	return true;
+}
+
+bool GPSSatelliteTracker::sameState(const GPSSatelliteTracker& other) const
+{
+	if((groupCount != other.groupCount) || (complete.count != other.complete.count))
+		return false;
+
+	//talkers may have been first seen in another order
+	int match[MAX_TALKERS];
+	for(int i = 0; i < groupCount; i++)
+	{
+		const Group& a = groups[i];
+		match[i] = -1;
+		for(int j = 0; j < other.groupCount; j++)
+			if(other.groups[j].talker.view() == a.talker.view())
+				match[i] = j;
+		if(match[i] < 0)
+			return false;
+
+		const Group& b = other.groups[match[i]];
+		if((a.total != b.total) || (a.next != b.next) || (a.count != b.count))
+			return false;
+	}
+
+	//each talker's share of the table
+	int counts[MAX_TALKERS] = {0};
+	for(int i = 0; i < other.complete.count; i++)
+		counts[other.complete.talker[i]]++;
+	for(int i = 0; i < complete.count; i++)
+		counts[match[complete.talker[i]]]--;
+	for(int i = 0; i < groupCount; i++)
+		if(counts[i] != 0)
+			return false;
+	return true;
+}
+
+void GPSSatelliteTracker::drop(int index)
+{
+	//the source's previous satellites, keeping the others in order
+	int kept = 0;
+	for(int i = 0; i < complete.count; i++)
+	{
+		if(complete.talker[i] == index)
+			continue;
+
+		complete.constellation[kept] = complete.constellation[i];
+		complete.talker[kept] = complete.talker[i];
+		complete.prn[kept] = complete.prn[i];
+		complete.elevation[kept] = complete.elevation[i];
+		complete.azimuth[kept] = complete.azimuth[i];
+		complete.SNR[kept] = complete.SNR[i];
+		kept++;
+	}
+	complete.count = kept;
+}
+
+void GPSSatelliteTracker::commit(int index)
+{
+	const Group& group = groups[index];
+	drop(index);
+
+	for(int i = 0; (i < group.count) && (complete.count < GPSSatTable::CAPACITY); i++)
+	{
+		int n = complete.count++;
+		complete.constellation[n] = gpsConstellation(group.talker, group.prn[i]);
+		complete.talker[n] = index;
+		complete.prn[n] = group.prn[i];
+		complete.elevation[n] = group.elevation[i];
+		complete.azimuth[n] = group.azimuth[i];
+		complete.SNR[n] = group.SNR[i];
+	}
+
+	published.publish(complete);
+}
+
+bool GPSSatelliteTracker::replace(const NMEATalker& source, const GPSSatTable& satellites)
+{
+	int index = groupIndex(source);
+	if(index < 0)
+		return false;
+
+	drop(index);
+
+	for(int i = 0; (i < satellites.count) && (complete.count < GPSSatTable::CAPACITY); i++)
+	{
+		int n = complete.count++;
+		complete.constellation[n] = satellites.constellation[i];
+		complete.talker[n] = index;
+		complete.prn[n] = satellites.prn[i];
+		complete.elevation[n] = satellites.elevation[i];
+		complete.azimuth[n] = satellites.azimuth[i];
+		complete.SNR[n] = satellites.SNR[i];
+	}
+
+	published.publish(complete);
+	return true;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+
+#include "GPSSentences.h"
+#include "GPSSeqLock.h"
+
+enum GPSConstellation
+{
+	CONSTELLATION_UNKNOWN,
+	CONSTELLATION_GPS,
+	CONSTELLATION_SBAS,
+	CONSTELLATION_GLONASS,
+	CONSTELLATION_GALILEO,
+	CONSTELLATION_BEIDOU,
+	CONSTELLATION_QZSS,
+	CONSTELLATION_COUNT
+};
+
+// Constellation of a satellite from the GSV talker, falling back on the
+// NMEA 4.0 PRN ranges for combined (GN) and GPS talkers.
+GPSConstellation gpsConstellation(const NMEATalker& talker, int prn);
+const char* gpsConstellationName(int constellation);
+
+// Every satellite in view, stored as parallel arrays so statistics over
+// one attribute (SNR for antenna health, elevation for sky plots) walk a
+// single contiguous array. Fixed size, so it is copied, never allocated.
+struct GPSSatTable
+{
+	static const int CAPACITY = 128;
+
+	int count = 0;
+	uint8_t constellation[CAPACITY];
+	uint8_t talker[CAPACITY];		//internal group index, see GPSSatelliteTracker
+	uint16_t prn[CAPACITY];
+	int8_t elevation[CAPACITY];		//degrees
+	uint16_t azimuth[CAPACITY];		//degrees true
+	uint8_t SNR[CAPACITY];			//dB-Hz, 0 when not tracked
+
+	// Index of the satellite or -1.
+	int find(int constellationID, int PRN) const;
+
+	int tracked() const;
+	float meanSNR() const;
+};
+
+// Builds a GPSSatTable from the N of M GSV groups of every talker.
+//
+// Each talker's group is staged on its own; when the last sentence of the
+// group arrives its satellites replace that talker's previous ones and the
+// whole table is published through a GPSSeqLock, so readers only ever see
+// complete groups. A group with a missing or out of order sentence is
+// dropped and the talker keeps its previous satellites. Binary protocols
+// hand over whole tables, which stand in for one talker's group.
+
+class GPSSatelliteTracker
+{
+public:
+	static const int MAX_TALKERS = 8;
+	static const int MAX_GROUP_SATELLITES = 36;		//9 sentences of 4
+
+	// Returns true when the sentence completed a group.
+	bool add(const GSVStruct& GSV);
+
+	// Replaces source's satellites with a table that is complete already,
+	// e.g. from a UBX NAV-SAT, constellations and all. Other sources keep
+	// theirs. Returns false when there are too many sources.
+	bool replace(const NMEATalker& source, const GPSSatTable& satellites);
+
+	// Table as of the last complete group, for the decoding thread.
+	const GPSSatTable& table() const { return complete; }
+
+	// Latest complete table, safe from any thread. Returns 0 before the
+	// first group completes.
+	uint64_t read(GPSSatTable& out) const { return published.read(out); }
+
+	// True when both hold the same talkers, with the same groups under
+	// way and the same number of satellites each: as far as a fix goes,
+	// they track the same from here on. The order the talkers were first
+	// seen in only orders the table and may differ.
+	bool sameState(const GPSSatelliteTracker& other) const;
+
+private:
+	struct Group
+	{
+		NMEATalker talker;
+		int total;
+		int next;					//0 while waiting for sentence 1
+
+		int count;
+		uint16_t prn[MAX_GROUP_SATELLITES];
+		int8_t elevation[MAX_GROUP_SATELLITES];
+		uint16_t azimuth[MAX_GROUP_SATELLITES];
+		uint8_t SNR[MAX_GROUP_SATELLITES];
+	};
+
+	int groupIndex(const NMEATalker& talker);
+	void commit(int index);
+	void drop(int index);
+
+	Group groups[MAX_TALKERS];
+	int groupCount = 0;
+
+	GPSSatTable complete;
+	GPSSeqLock<GPSSatTable, 2> published;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Single writer, many reader publication of a trivially copyable value.
+//
+// The writer fills the next slot of a small ring and then makes it the
+// latest, so it never waits for readers and readers never take a lock.
+// A reader copies the latest slot and checks the slot's sequence number
+// did not move underneath it; it only has to retry when the writer has
+// lapped the whole ring during that one copy, which at fix rates does not
+// happen in practice.
+
+template<typename T, int SLOTS = 4>
+class GPSSeqLock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "published values are copied with memcpy");
+	static_assert((SLOTS & (SLOTS - 1)) == 0, "SLOTS must be a power of two");
+
+public:
+	// Writer side, one thread only. Returns the publication number.
+	uint64_t publish(const T& value)
+	{
+		uint64_t next = published.load(std::memory_order_relaxed) + 1;
+		Slot& slot = slots[next & (SLOTS - 1)];
+
+		//odd while the slot is being written
+		uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+		slot.seq.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		memcpy(&slot.value, &value, sizeof(T));
+
+		slot.seq.store(seq + 2, std::memory_order_release);
+		published.store(next, std::memory_order_release);
+		return next;
+	}
+
+	// Copies the latest value into out. Returns its publication number,
+	// or 0 (leaving out untouched) when nothing has been published yet.
+	uint64_t read(T& out) const
+	{
+		for(;;)
+		{
+			uint64_t latest = published.load(std::memory_order_acquire);
+			if(latest == 0)
+				return 0;
+
+			const Slot& slot = slots[latest & (SLOTS - 1)];
+			uint64_t before = slot.seq.load(std::memory_order_acquire);
+			if(before & 1)
+				continue;
+
+			memcpy(&out, &slot.value, sizeof(T));
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if(slot.seq.load(std::memory_order_relaxed) == before)
+				return latest;
+		}
+	}
+
+	uint64_t count() const { return published.load(std::memory_order_acquire); }
+
+private:
+	struct alignas(64) Slot
+	{
+		std::atomic<uint64_t> seq{0};
+		T value;
+	};
+
+	Slot slots[SLOTS];
+	alignas(64) std::atomic<uint64_t> published{0};
+};
@@ -0,0 +1,236 @@
+#include "GPSSimplify.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+//mean earth radius, good to a fraction of a percent for tolerances
+static const double METRES_PER_DEGREE = 6371008.8 * M_PI / 180.0;
+
+//below this a chunk is not worth a thread
+static const size_t MIN_CHUNK = 1 << 16;
+
+static const int64_t MILLIS_PER_DAY = 86400000;
+
+struct LocalPoint
+{
+	double x;
+	double y;
+};
+
+// Equirectangular projection around an origin, in metres. Plenty for the
+// distances within one window or chunk.
+static LocalPoint project(double latitude, double longitude, double originLatitude, double originLongitude, double cosOrigin)
+{
+	return LocalPoint{(longitude - originLongitude) * cosOrigin * METRES_PER_DEGREE, (latitude - originLatitude) * METRES_PER_DEGREE};
+}
+
+static double segmentDistance(const LocalPoint& p, const LocalPoint& a, const LocalPoint& b)
+{
+	double dx = b.x - a.x;
+	double dy = b.y - a.y;
+	double length = dx*dx + dy*dy;
+
+	double t = 0;
+	if(length > 0)
+		t = std::min(1.0, std::max(0.0, ((p.x - a.x)*dx + (p.y - a.y)*dy) / length));
+
+	double ex = a.x + t*dx - p.x;
+	double ey = a.y + t*dy - p.y;
+	return std::sqrt(ex*ex + ey*ey);
+}
+
+//without a date the time of day wraps at midnight
+static int64_t elapsed(const GPSFix& fix, int64_t time, int64_t since)
+{
+	int64_t millis = time - since;
+	if(!fix.date.valid && (millis < -MILLIS_PER_DAY / 2))
+		millis += MILLIS_PER_DAY;
+	return millis;
+}
+
+GPSTrackSimplifier::GPSTrackSimplifier() : window(new GPSFix[WINDOW])
+{
+}
+
+void GPSTrackSimplifier::setOutput(GPSFixCallback callback, void* context)
+{
+	output = callback;
+	outputContext = context;
+}
+
+void GPSTrackSimplifier::keep(const GPSFix& fix)
+{
+	anchor = fix;
+	anchorTime = gpsFixTime(fix.date, fix.time);
+	windowCount = 0;
+	kept++;
+
+	if(output)
+		output(anchor, outputContext);
+}
+
+bool GPSTrackSimplifier::outOfTolerance(const GPSFix& end) const
+{
+	double cosAnchor = std::cos(anchor.latitude * M_PI / 180.0);
+	LocalPoint a{0, 0};
+	LocalPoint b = project(end.latitude, end.longitude, anchor.latitude, anchor.longitude, cosAnchor);
+
+	for(int i = 0; i < windowCount; i++)
+	{
+		LocalPoint p = project(window[i].latitude, window[i].longitude, anchor.latitude, anchor.longitude, cosAnchor);
+		if(segmentDistance(p, a, b) > config.toleranceMetres)
+			return true;
+	}
+	return false;
+}
+
+void GPSTrackSimplifier::add(const GPSFix& fix)
+{
+	if(!fix.valid())
+		return;
+
+	in++;
+	int64_t time = gpsFixTime(fix.date, fix.time);
+	int64_t millis = elapsed(fix, time, lastAccepted);
+
+	//time went back, e.g. a new log: end the track so far and start over
+	if(!started || (millis < 0))
+	{
+		flush();
+		started = true;
+		lastAccepted = time;
+		keep(fix);
+		return;
+	}
+
+	//time decimation first
+	if((config.minIntervalMillis > 0) && (millis < config.minIntervalMillis))
+		return;
+	lastAccepted = time;
+
+	//the point before this one is the last the straight line still covers,
+	//also when this one is kept anyway, or a corner in the window is lost
+	if((config.toleranceMetres > 0) && (windowCount > 0) && outOfTolerance(fix))
+		keep(window[windowCount - 1]);
+
+	if((config.toleranceMetres <= 0) ||
+		((config.maxIntervalMillis > 0) && (elapsed(fix, time, anchorTime) >= config.maxIntervalMillis)))
+	{
+		keep(fix);
+		return;
+	}
+
+	if(windowCount == WINDOW)
+		keep(window[WINDOW - 1]);
+
+	window[windowCount++] = fix;
+}
+
+void GPSTrackSimplifier::flush()
+{
+	if(windowCount > 0)
+		keep(window[windowCount - 1]);
+}
+
+GPSSimplifySink::GPSSimplifySink(const GPSSimplifyConfig& config, std::unique_ptr<GPSSink> next) : next(std::move(next))
+{
+	simplifier.setConfig(config);
+	simplifier.setOutput(simplified, this);
+}
+
+void GPSSimplifySink::simplified(const GPSFix& fix, void* sink)
+{
+	static_cast<GPSSimplifySink*>(sink)->next->fix(fix);
+}
+
+void GPSSimplifySink::fix(const GPSFix& fix)
+{
+	simplifier.add(fix);
+}
+
+void GPSSimplifySink::close()
+{
+	simplifier.flush();
+	next->close();
+}
+
+// Marks the points of [first, last) Douglas-Peucker keeps. last is left to
+// the next chunk, which starts there.
+static void simplifyChunk(const GPSTrackPoint* points, size_t first, size_t last, double tolerance, std::vector<char>& keep)
+{
+	double originLatitude = points[first].latitude / 1e7;
+	double originLongitude = points[first].longitude / 1e7;
+	double cosOrigin = std::cos(originLatitude * M_PI / 180.0);
+
+	std::vector<LocalPoint> local(last - first + 1);
+	for(size_t i = first; i <= last; i++)
+		local[i - first] = project(points[i].latitude / 1e7, points[i].longitude / 1e7, originLatitude, originLongitude, cosOrigin);
+
+	keep[first] = 1;
+
+	//explicit stack, a long straight track would recurse very deep
+	std::vector<std::pair<size_t, size_t>> stack;
+	stack.push_back(std::make_pair((size_t)0, last - first));
+	while(!stack.empty())
+	{
+		size_t a = stack.back().first;
+		size_t b = stack.back().second;
+		stack.pop_back();
+
+		double furthest = 0;
+		size_t index = 0;
+		for(size_t i = a + 1; i < b; i++)
+		{
+			double distance = segmentDistance(local[i], local[a], local[b]);
+			if(distance > furthest)
+			{
+				furthest = distance;
+				index = i;
+			}
+		}
+
+		if(furthest > tolerance)
+		{
+			keep[first + index] = 1;
+			stack.push_back(std::make_pair(a, index));
+			stack.push_back(std::make_pair(index, b));
+		}
+	}
+}
+
+std::vector<GPSTrackPoint> gpsSimplifyTrack(const GPSTrackPoint* points, size_t count, double toleranceMetres, int threads)
+{
+	if((count <= 2) || (toleranceMetres <= 0))
+		return std::vector<GPSTrackPoint>(points, points + count);
+
+	if(threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	size_t chunk = std::max(MIN_CHUNK, (count + threads - 1) / threads);
+	size_t chunks = (count - 1 + chunk - 1) / chunk;
+
+	//chunks share their end points, each writes only its own range
+	std::vector<char> keep(count, 0);
+	std::atomic<size_t> next{0};
+	auto worker = [&]()
+	{
+		for(size_t c = next++; c < chunks; c = next++)
+			simplifyChunk(points, c*chunk, std::min(count - 1, (c + 1)*chunk), toleranceMetres, keep);
+	};
+
+	std::vector<std::thread> pool;
+	for(int i = 1; i < std::min<int>(threads, chunks); i++)
+		pool.emplace_back(worker);
+	worker();
+	for(std::thread& thread : pool)
+		thread.join();
+	keep[count - 1] = 1;
+
+	std::vector<GPSTrackPoint> kept;
+	for(size_t i = 0; i < count; i++)
+		if(keep[i])
+			kept.push_back(points[i]);
+	return kept;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "GPSEpochAssembler.h"
+#include "GPSSink.h"
+#include "GPSTrackLog.h"
+
+struct GPSSimplifyConfig
+{
+	// Points closer than this to the simplified line are dropped. 0 keeps
+	// every point the time limits let through.
+	double toleranceMetres = 0;
+
+	// Points less than minInterval after the last kept one are dropped
+	// before anything else, e.g. 1000 to thin 10 Hz to 1 Hz.
+	int64_t minIntervalMillis = 0;
+
+	// A point is kept at least this often however straight the track,
+	// so long stretches still carry times. 0 disables.
+	int64_t maxIntervalMillis = 0;
+
+	bool enabled() const { return (toleranceMetres > 0) || (minIntervalMillis > 0); }
+};
+
+// Streaming track simplification.
+//
+// Douglas-Peucker needs the whole track; this is its online form, the
+// opening window. Points since the last kept one (the anchor) are held in
+// a window of at most WINDOW points; each new point is checked as the end
+// of a segment from the anchor, and when any held point lies further than
+// the tolerance from that segment the point before the new one is kept
+// and becomes the anchor. A full window keeps its last point, which bounds
+// memory and the work per point. Kept points go to the output callback.
+
+class GPSTrackSimplifier
+{
+public:
+	static const int WINDOW = 256;
+
+	GPSTrackSimplifier();
+
+	void setConfig(const GPSSimplifyConfig& newConfig) { config = newConfig; }
+	const GPSSimplifyConfig& getConfig() const { return config; }
+
+	void setOutput(GPSFixCallback callback, void* context);
+
+	// Takes valid fixes only, anything else is ignored. A fix earlier
+	// than the one before, past the midnight wrap of undated fixes, ends
+	// the track so far and starts a new one with it.
+	void add(const GPSFix& fix);
+
+	// Keeps the last point of the track, e.g. at the end of a log.
+	void flush();
+
+	uint64_t pointsIn() const { return in; }
+	uint64_t pointsKept() const { return kept; }
+
+private:
+	void keep(const GPSFix& fix);
+	bool outOfTolerance(const GPSFix& end) const;
+
+	GPSSimplifyConfig config;
+	GPSFixCallback output = nullptr;
+	void* outputContext = nullptr;
+
+	bool started = false;
+	GPSFix anchor;
+	int64_t anchorTime = 0;
+	int64_t lastAccepted = 0;
+
+	std::unique_ptr<GPSFix[]> window;
+	int windowCount = 0;
+
+	uint64_t in = 0;
+	uint64_t kept = 0;
+};
+
+// Simplifies the fixes on their way to another sink.
+class GPSSimplifySink : public GPSSink
+{
+public:
+	GPSSimplifySink(const GPSSimplifyConfig& config, std::unique_ptr<GPSSink> next);
+
+	void fix(const GPSFix&) override;
+	void sentence(const char* data, size_t length) override { next->sentence(data, length); }
+	bool wantsSentences() const override { return next->wantsSentences(); }
+	bool accepts(const char* data, size_t length) const override { return next->accepts(data, length); }
+	void flush() override { next->flush(); }
+	void close() override;
+
+	uint64_t pointsKept() const { return simplifier.pointsKept(); }
+
+private:
+	static void simplified(const GPSFix& fix, void* sink);
+
+	GPSTrackSimplifier simplifier;
+	std::unique_ptr<GPSSink> next;
+};
+
+// Douglas-Peucker over a whole recorded track. The track is cut into
+// chunks that are simplified on separate threads; chunk ends are always
+// kept, which costs a handful of points on a long track. threads 0 uses
+// every core. Returns the kept points in order.
+std::vector<GPSTrackPoint> gpsSimplifyTrack(const GPSTrackPoint* points, size_t count, double toleranceMetres, int threads = 0);
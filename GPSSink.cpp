@@ -0,0 +1,174 @@
+#include "GPSSink.h"
+
+#include <chrono>
+#include <cstring>
+
+//sinks write out at least this often
+static const std::chrono::milliseconds FLUSH_INTERVAL{1000};
+
+GPSSinkFanout::~GPSSinkFanout()
+{
+	close();
+}
+
+int GPSSinkFanout::add(std::unique_ptr<GPSSink> sink)
+{
+	if(!sink)
+		return 0;
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	int count = sinkCount.load(std::memory_order_relaxed);
+	if(count == MAX_SINKS)
+		return 0;
+
+	if(sink->wantsSentences())
+		sentenceSinks++;
+	sinks[count] = std::move(sink);
+	sinkCount.store(count + 1, std::memory_order_release);
+
+	if(!deliverer.joinable())
+	{
+		ring.reset(new Record[QUEUE_SIZE]);
+		stopping = false;
+		deliverer = std::thread(&GPSSinkFanout::deliverThread, this);
+	}
+	return 1;
+}
+
+void GPSSinkFanout::close()
+{
+	if(!deliverer.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_one();
+	deliverer.join();
+
+	int count = sinkCount.load(std::memory_order_relaxed);
+	for(int i = 0; i < count; i++)
+	{
+		sinks[i]->close();
+		sinks[i].reset();
+	}
+	sinkCount = 0;
+	sentenceSinks = 0;
+}
+
+GPSSinkFanout::Record* GPSSinkFanout::claim()
+{
+	size_t next = head.load(std::memory_order_relaxed);
+	if(next - tail.load(std::memory_order_acquire) == QUEUE_SIZE)
+	{
+		drops.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	return &ring[next % QUEUE_SIZE];
+}
+
+void GPSSinkFanout::commit()
+{
+	head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+
+	//only take the lock when the delivery thread is asleep
+	if(sleeping.load(std::memory_order_seq_cst))
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		wake.notify_one();
+	}
+}
+
+void GPSSinkFanout::pushFix(const GPSFix& fix, std::chrono::steady_clock::time_point arrival)
+{
+	if(!active())
+		return;
+
+	Record* record = claim();
+	if(!record)
+		return;
+
+	record->isFix = true;
+	record->fix = fix;
+	record->arrival = arrival;
+	commit();
+}
+
+void GPSSinkFanout::pushSentence(const char* data, size_t length)
+{
+	if(!wantsSentences() || (length > MAX_SENTENCE_LENGTH))
+		return;
+
+	//only queue what some sink is going to write
+	int count = sinkCount.load(std::memory_order_acquire);
+	bool wanted = false;
+	for(int i = 0; (i < count) && !wanted; i++)
+		wanted = sinks[i]->wantsSentences() && sinks[i]->accepts(data, length);
+	if(!wanted)
+		return;
+
+	Record* record = claim();
+	if(!record)
+		return;
+
+	record->isFix = false;
+	record->length = length;
+	memcpy(record->sentence, data, length);
+	commit();
+}
+
+void GPSSinkFanout::deliverThread()
+{
+	auto lastFlush = std::chrono::steady_clock::now();
+
+	for(;;)
+	{
+		size_t first = tail.load(std::memory_order_relaxed);
+		size_t last = head.load(std::memory_order_acquire);
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			int count = sinkCount.load(std::memory_order_relaxed);
+
+			for(size_t i = first; i != last; i++)
+			{
+				const Record& record = ring[i % QUEUE_SIZE];
+				for(int s = 0; s < count; s++)
+				{
+					if(record.isFix)
+						sinks[s]->fix(record.fix);
+					else if(sinks[s]->wantsSentences() && sinks[s]->accepts(record.sentence, record.length))
+						sinks[s]->sentence(record.sentence, record.length);
+				}
+			}
+
+			auto now = std::chrono::steady_clock::now();
+			for(size_t i = first; i != last; i++)
+				if(ring[i % QUEUE_SIZE].isFix)
+					delivered.record(now - ring[i % QUEUE_SIZE].arrival);
+
+			if(now - lastFlush >= FLUSH_INTERVAL)
+			{
+				for(int s = 0; s < count; s++)
+					sinks[s]->flush();
+				lastFlush = now;
+			}
+		}
+		tail.store(last, std::memory_order_release);
+
+		if(first != last)
+			continue;
+
+		//queue drained, sleep until the decoder pushes or it is time to flush
+		std::unique_lock<std::mutex> guard(lock);
+		if(stopping)
+			break;
+
+		sleeping.store(true, std::memory_order_seq_cst);
+		if(head.load(std::memory_order_seq_cst) == last)
+			wake.wait_for(guard, FLUSH_INTERVAL);
+		sleeping.store(false, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "GPSFix.h"
+#include "GPSStats.h"
+
+// Something decoded fixes, or raw sentences, are written to.
+//
+// A sink is only ever called from one thread at a time: either the
+// GPSSinkFanout thread, or whoever drives it directly (trackConvert).
+
+class GPSSink
+{
+public:
+	virtual ~GPSSink() {}
+
+	virtual void fix(const GPSFix&) {}
+
+	// Checksummed sentence without its line ending, for sinks that
+	// return true from wantsSentences() and accepts().
+	virtual void sentence(const char* /*data*/, size_t /*length*/) {}
+	virtual bool wantsSentences() const { return false; }
+
+	// Called on the decoding thread, so it may only look at what was set
+	// up before the sink was added.
+	virtual bool accepts(const char* /*data*/, size_t /*length*/) const { return true; }
+
+	virtual void flush() {}
+	virtual void close() {}
+};
+
+// Hands what the decoder produces to several sinks at once without
+// making the decoder wait for them.
+//
+// The decoding thread copies each fix or sentence into a fixed ring and
+// returns; a thread of the fan-out's own delivers the ring to every sink
+// and flushes them once a second. When the sinks fall so far behind that
+// the ring is full, new records are dropped and counted rather than
+// stalling decoding.
+
+class GPSSinkFanout
+{
+public:
+	static const int MAX_SINKS = 8;
+	static const size_t QUEUE_SIZE = 1024;
+	static const size_t MAX_SENTENCE_LENGTH = 128;
+
+	~GPSSinkFanout();
+
+	// Takes ownership of the sink. Starts the delivery thread with the
+	// first sink. Returns 0 when there is no room for another.
+	int add(std::unique_ptr<GPSSink> sink);
+
+	// Delivers what is queued, then closes every sink.
+	void close();
+
+	bool active() const { return sinkCount.load(std::memory_order_relaxed) > 0; }
+	bool wantsSentences() const { return sentenceSinks.load(std::memory_order_relaxed) > 0; }
+
+	// Decoding thread only. arrival is when the bytes behind the fix came
+	// in, latency() measures from it to the fix reaching every sink.
+	void pushFix(const GPSFix& fix, std::chrono::steady_clock::time_point arrival);
+	void pushSentence(const char* data, size_t length);
+
+	uint64_t dropped() const { return drops.load(std::memory_order_relaxed); }
+	void latency(GPSLatencySummary& out) const { delivered.read(out); }
+
+private:
+	struct Record
+	{
+		bool isFix;
+		uint8_t length;
+		char sentence[MAX_SENTENCE_LENGTH];
+		GPSFix fix;
+		std::chrono::steady_clock::time_point arrival;
+	};
+
+	Record* claim();
+	void commit();
+	void deliverThread();
+
+	std::unique_ptr<Record[]> ring;
+	alignas(64) std::atomic<size_t> head{0};		//written by the decoder
+	alignas(64) std::atomic<size_t> tail{0};		//written by the delivery thread
+
+	std::unique_ptr<GPSSink> sinks[MAX_SINKS];
+	std::atomic<int> sinkCount{0};
+	std::atomic<int> sentenceSinks{0};
+	std::atomic<uint64_t> drops{0};
+
+	//written by the delivery thread
+	alignas(64) GPSLatencyHistogram delivered;
+
+	std::mutex lock;
+	std::condition_variable wake;
+	std::atomic<bool> sleeping{false};
+	bool stopping = false;
+	std::thread deliverer;
+};
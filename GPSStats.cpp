@@ -0,0 +1,378 @@
+#include "GPSStats.h"
+#include "GPSDecoder.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+
+struct GPSStatsField
+{
+	const char* name;
+	const char* help;
+	uint64_t GPSStatsSnapshot::*value;
+};
+
+//in the order every format lists them
+static const GPSStatsField FIELDS[] =
+{
+	{"bytes", "Bytes handed to the decoder.", &GPSStatsSnapshot::bytes},
+	{"frames", "Frames from '$' to a line ending.", &GPSStatsSnapshot::frames},
+	{"sentences", "Frames that passed the checksum.", &GPSStatsSnapshot::sentences},
+	{"checksum_failures", "Frames with a wrong checksum.", &GPSStatsSnapshot::checksumFailures},
+	{"malformed_frames", "Frames too short or without a checksum.", &GPSStatsSnapshot::malformed},
+	{"truncated_frames", "Frames cut off by the next '$' or '!'.", &GPSStatsSnapshot::truncated},
+	{"overlong_frames", "Frames over the length limit.", &GPSStatsSnapshot::overlong},
+	{"dropped_bytes", "Bytes outside any complete frame.", &GPSStatsSnapshot::droppedBytes},
+	{"gga_without_position", "GGA sentences without a position.", &GPSStatsSnapshot::noPosition},
+	{"ubx_frames", "UBX frames that passed the checksum.", &GPSStatsSnapshot::ubxFrames},
+	{"ubx_checksum_failures", "UBX frames with a wrong checksum.", &GPSStatsSnapshot::ubxChecksumFailures},
+	{"epochs", "Epochs assembled into a fix.", &GPSStatsSnapshot::epochs},
+	{"partial_epochs", "Epochs missing a sentence type the previous one had.", &GPSStatsSnapshot::partialEpochs},
+	{"fixes_rejected", "Fixes dropped by the fix filter.", &GPSStatsSnapshot::fixesRejected},
+	{"sink_drops", "Fixes and sentences dropped because the sinks fell behind.", &GPSStatsSnapshot::sinkDrops},
+	{"kml_drops", "KML track points that could not be written.", &GPSStatsSnapshot::KMLDrops},
+};
+
+struct GPSStatsLatency
+{
+	const char* name;
+	const char* help;
+	GPSLatencySummary GPSStatsSnapshot::*value;
+};
+
+static const GPSStatsLatency LATENCIES[] =
+{
+	{"input_to_fix", "From the arrival of the bytes completing an epoch to its fix.", &GPSStatsSnapshot::inputToFix},
+	{"input_to_sink", "From the arrival of the bytes completing an epoch to the sinks.", &GPSStatsSnapshot::inputToSink},
+};
+
+uint64_t GPSLatencySummary::percentile(double p) const
+{
+	if(count == 0)
+		return 0;
+
+	uint64_t rank = (uint64_t)(p * count + 0.5);
+	if(rank < 1)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for(int i = 0; i < BUCKETS - 1; i++)
+	{
+		seen += buckets[i];
+		if(seen >= rank)
+			return std::min(bucketLimit(i), maxMicros);
+	}
+	return maxMicros;
+}
+
+void GPSLatencyHistogram::record(std::chrono::steady_clock::duration latency)
+{
+	int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+	if(micros < 0)
+		micros = 0;
+
+	//bucket i holds [2^(i-1), 2^i)
+	int bucket = micros ? 64 - __builtin_clzll((uint64_t)micros) : 0;
+	if(bucket >= GPSLatencySummary::BUCKETS)
+		bucket = GPSLatencySummary::BUCKETS - 1;
+
+	buckets[bucket].add();
+	sum.add(micros);
+	max.raise(micros);
+	count.add();
+}
+
+void GPSLatencyHistogram::read(GPSLatencySummary& out) const
+{
+	//a sample recorded meanwhile may show in some fields and not yet others
+	out.count = count.get();
+	out.sumMicros = sum.get();
+	out.maxMicros = max.get();
+	for(int i = 0; i < GPSLatencySummary::BUCKETS; i++)
+		out.buckets[i] = buckets[i].get();
+}
+
+static uint64_t addressKey(std::string_view address)
+{
+	uint64_t key = 0;
+	memcpy(&key, address.data(), std::min(address.length(), sizeof(key)));
+	return key;
+}
+
+void GPSSentenceCounts::add(std::string_view address)
+{
+	uint64_t key = addressKey(address);
+	int count = used.load(std::memory_order_relaxed);
+
+	for(int i = 0; i < count; i++)
+	{
+		if(entries[i].key == key)
+		{
+			entries[i].count.add();
+			return;
+		}
+	}
+
+	if(count == MAX_TYPES)
+	{
+		overflow.add();
+		return;
+	}
+
+	//the key is in place before readers can see the entry
+	entries[count].key = key;
+	entries[count].count.add();
+	used.store(count + 1, std::memory_order_release);
+}
+
+std::string GPSSentenceCounts::address(int i) const
+{
+	char text[sizeof(uint64_t)];
+	memcpy(text, &entries[i].key, sizeof(text));
+	return std::string(text, strnlen(text, sizeof(text)));
+}
+
+static void appendf(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static void appendf(std::string& out, const char* format, ...)
+{
+	char text[256];
+
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+
+	if(length > 0)
+		out.append(text, std::min(length, (int)sizeof(text) - 1));
+}
+
+//labels and addresses come from the outside, keep them inside their quotes
+static std::string quoted(const std::string& text)
+{
+	std::string out = "\"";
+	for(char c : text)
+	{
+		if((c == '"') || (c == '\\'))
+			out.push_back('\\');
+		if((unsigned char)c >= ' ')
+			out.push_back(c);
+	}
+	out.push_back('"');
+	return out;
+}
+
+static void formatText(std::string& out, const std::vector<GPSLabelledStats>& all)
+{
+	for(const GPSLabelledStats& source : all)
+	{
+		appendf(out, "[%s]\n", source.label.c_str());
+
+		for(const GPSStatsField& field : FIELDS)
+			appendf(out, "%-22s %llu\n", field.name, (unsigned long long)(source.stats.*field.value));
+
+		for(const auto& type : source.stats.types)
+			appendf(out, "  %-20s %llu\n", type.first.c_str(), (unsigned long long)type.second);
+		if(source.stats.otherTypes)
+			appendf(out, "  %-20s %llu\n", "other", (unsigned long long)source.stats.otherTypes);
+
+		for(const GPSStatsLatency& latency : LATENCIES)
+		{
+			const GPSLatencySummary& summary = source.stats.*latency.value;
+			appendf(out, "%-22s n %llu  mean %.0f us  p50 %llu us  p99 %llu us  p99.9 %llu us  max %llu us\n",
+				latency.name, (unsigned long long)summary.count, summary.meanMicros(),
+				(unsigned long long)summary.percentile(0.5), (unsigned long long)summary.percentile(0.99),
+				(unsigned long long)summary.percentile(0.999), (unsigned long long)summary.maxMicros);
+		}
+	}
+}
+
+static void formatJSON(std::string& out, const std::vector<GPSLabelledStats>& all)
+{
+	out.append("{");
+	for(size_t s = 0; s < all.size(); s++)
+	{
+		const GPSStatsSnapshot& stats = all[s].stats;
+		out.append(s ? ",\n" : "\n").append(quoted(all[s].label)).append(": {");
+
+		for(const GPSStatsField& field : FIELDS)
+			appendf(out, "\"%s\": %llu, ", field.name, (unsigned long long)(stats.*field.value));
+
+		out.append("\"types\": {");
+		for(size_t i = 0; i < stats.types.size(); i++)
+			appendf(out, "%s%s: %llu", i ? ", " : "", quoted(stats.types[i].first).c_str(), (unsigned long long)stats.types[i].second);
+		appendf(out, "}, \"other_types\": %llu", (unsigned long long)stats.otherTypes);
+
+		for(const GPSStatsLatency& latency : LATENCIES)
+		{
+			const GPSLatencySummary& summary = stats.*latency.value;
+			appendf(out, ", \"%s\": {\"count\": %llu, \"mean_us\": %.1f, \"p50_us\": %llu, \"p90_us\": %llu, \"p99_us\": %llu, \"p999_us\": %llu, \"max_us\": %llu}",
+				latency.name, (unsigned long long)summary.count, summary.meanMicros(),
+				(unsigned long long)summary.percentile(0.5), (unsigned long long)summary.percentile(0.9),
+				(unsigned long long)summary.percentile(0.99), (unsigned long long)summary.percentile(0.999),
+				(unsigned long long)summary.maxMicros);
+		}
+		out.append("}");
+	}
+	out.append("\n}\n");
+}
+
+static void formatPrometheus(std::string& out, const std::vector<GPSLabelledStats>& all)
+{
+	for(const GPSStatsField& field : FIELDS)
+	{
+		appendf(out, "# HELP gpsdecoder_%s_total %s\n", field.name, field.help);
+		appendf(out, "# TYPE gpsdecoder_%s_total counter\n", field.name);
+		for(const GPSLabelledStats& source : all)
+			appendf(out, "gpsdecoder_%s_total{source=%s} %llu\n", field.name,
+				quoted(source.label).c_str(), (unsigned long long)(source.stats.*field.value));
+	}
+
+	out.append("# HELP gpsdecoder_sentences_by_address_total Sentences that passed the checksum, by address.\n");
+	out.append("# TYPE gpsdecoder_sentences_by_address_total counter\n");
+	for(const GPSLabelledStats& source : all)
+	{
+		for(const auto& type : source.stats.types)
+			appendf(out, "gpsdecoder_sentences_by_address_total{source=%s,address=%s} %llu\n",
+				quoted(source.label).c_str(), quoted(type.first).c_str(), (unsigned long long)type.second);
+		appendf(out, "gpsdecoder_sentences_by_address_total{source=%s,address=\"other\"} %llu\n",
+			quoted(source.label).c_str(), (unsigned long long)source.stats.otherTypes);
+	}
+
+	for(const GPSStatsLatency& latency : LATENCIES)
+	{
+		appendf(out, "# HELP gpsdecoder_%s_seconds %s\n", latency.name, latency.help);
+		appendf(out, "# TYPE gpsdecoder_%s_seconds histogram\n", latency.name);
+		for(const GPSLabelledStats& source : all)
+		{
+			const GPSLatencySummary& summary = source.stats.*latency.value;
+			std::string label = quoted(source.label);
+
+			//Prometheus buckets are cumulative
+			uint64_t cumulative = 0;
+			for(int i = 0; i < GPSLatencySummary::BUCKETS - 1; i++)
+			{
+				cumulative += summary.buckets[i];
+				appendf(out, "gpsdecoder_%s_seconds_bucket{source=%s,le=\"%g\"} %llu\n", latency.name,
+					label.c_str(), GPSLatencySummary::bucketLimit(i) / 1e6, (unsigned long long)cumulative);
+			}
+			appendf(out, "gpsdecoder_%s_seconds_bucket{source=%s,le=\"+Inf\"} %llu\n", latency.name,
+				label.c_str(), (unsigned long long)summary.count);
+			appendf(out, "gpsdecoder_%s_seconds_sum{source=%s} %g\n", latency.name,
+				label.c_str(), summary.sumMicros / 1e6);
+			appendf(out, "gpsdecoder_%s_seconds_count{source=%s} %llu\n", latency.name,
+				label.c_str(), (unsigned long long)summary.count);
+		}
+	}
+}
+
+std::string gpsFormatStats(const std::vector<GPSLabelledStats>& stats, GPSStatsFormat format)
+{
+	std::string out;
+	switch(format)
+	{
+	case STATS_JSON:
+		formatJSON(out, stats);
+		break;
+	case STATS_PROMETHEUS:
+		formatPrometheus(out, stats);
+		break;
+	default:
+		formatText(out, stats);
+		break;
+	}
+	return out;
+}
+
+GPSStatsDumper::~GPSStatsDumper()
+{
+	stop();
+}
+
+void GPSStatsDumper::add(const GPSDecoder& decoder, const std::string& label)
+{
+	decoders.push_back(std::make_pair(&decoder, label));
+}
+
+int GPSStatsDumper::start(const std::string& newPath, GPSStatsFormat newFormat, std::chrono::milliseconds newInterval)
+{
+	if(dumper.joinable())
+		return 0;
+
+	path = newPath;
+	format = newFormat;
+	interval = newInterval;
+
+	if(!dump())
+		return 0;
+
+	stopping = false;
+	dumper = std::thread(&GPSStatsDumper::dumpThread, this);
+	return 1;
+}
+
+void GPSStatsDumper::stop()
+{
+	if(!dumper.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_one();
+	dumper.join();
+
+	dump();
+}
+
+int GPSStatsDumper::dump()
+{
+	if(path.empty())
+		return 0;
+
+	std::vector<GPSLabelledStats> all(decoders.size());
+	for(size_t i = 0; i < decoders.size(); i++)
+	{
+		all[i].label = decoders[i].second;
+		decoders[i].first->readStats(all[i].stats);
+	}
+	std::string text = gpsFormatStats(all, format);
+
+	if(path == "-")
+		return fwrite(text.data(), 1, text.size(), stdout) == text.size();
+
+	//write beside the file and rename over it
+	std::string temporary = path + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "w");
+	if(!file)
+		return 0;
+
+	bool written = (fwrite(text.data(), 1, text.size(), file) == text.size());
+	written = (fclose(file) == 0) && written;
+
+	if(!written || (rename(temporary.c_str(), path.c_str()) != 0))
+	{
+		unlink(temporary.c_str());
+		return 0;
+	}
+	return 1;
+}
+
+void GPSStatsDumper::dumpThread()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while(!stopping)
+	{
+		wake.wait_for(guard, interval);
+		if(stopping)
+			break;
+
+		guard.unlock();
+		dump();
+		guard.lock();
+	}
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Counters and latency histograms that cost next to nothing to keep.
+//
+// Every counter has exactly one thread writing it, so an increment is a
+// relaxed load and store rather than a locked read-modify-write, and any
+// thread may read a recent value at any time. Counters written by
+// different threads live on different cache lines so that neither the
+// writers nor the readers bounce each other's lines.
+
+class GPSCounter
+{
+public:
+	void add(uint64_t n = 1) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+	void raise(uint64_t n) { if(n > get()) value.store(n, std::memory_order_relaxed); }
+	uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> value{0};
+};
+
+// Plain copy of a histogram, see GPSLatencyHistogram.
+struct GPSLatencySummary
+{
+	static const int BUCKETS = 26;
+
+	uint64_t count = 0;
+	uint64_t sumMicros = 0;
+	uint64_t maxMicros = 0;
+	uint64_t buckets[BUCKETS] = {0};
+
+	// Upper bound of bucket i in microseconds, the last is unbounded.
+	static uint64_t bucketLimit(int i) { return (uint64_t)1 << i; }
+
+	// Upper bound of the bucket holding fraction p of the samples, e.g.
+	// 0.99. Never claims more than the largest sample.
+	uint64_t percentile(double p) const;
+	double meanMicros() const { return count ? (double)sumMicros / count : 0; }
+};
+
+// Latencies in power of two buckets of microseconds: bucket 0 holds
+// samples under 1 us, bucket i those under 2^i us, the last one (about 33 s
+// and up) everything longer. One writing thread.
+class GPSLatencyHistogram
+{
+public:
+	void record(std::chrono::steady_clock::duration latency);
+	void read(GPSLatencySummary& out) const;
+
+private:
+	GPSCounter buckets[GPSLatencySummary::BUCKETS];
+	GPSCounter count;
+	GPSCounter sum;
+	GPSCounter max;
+};
+
+// Sentences counted by address, e.g. "GPGGA" and "GLGSV" apart. Holds the
+// first MAX_TYPES addresses seen, later ones only go to other(). One
+// writing thread.
+class GPSSentenceCounts
+{
+public:
+	static const int MAX_TYPES = 32;
+
+	void add(std::string_view address);
+
+	// Addresses counted so far, in the order they were first seen.
+	int types() const { return used.load(std::memory_order_acquire); }
+	std::string address(int i) const;
+	uint64_t count(int i) const { return entries[i].count.get(); }
+	uint64_t other() const { return overflow.get(); }
+
+private:
+	struct Entry
+	{
+		uint64_t key = 0;
+		GPSCounter count;
+	};
+
+	Entry entries[MAX_TYPES];
+	std::atomic<int> used{0};
+	GPSCounter overflow;
+};
+
+// What one decoder counts on its decoding thread.
+struct alignas(64) GPSDecodeStats
+{
+	GPSCounter bytes;				//every byte handed to decode()
+	GPSCounter frames;				//'$' to line ending, good or not
+	GPSCounter sentences;			//frames that passed the checksum
+	GPSCounter checksumFailures;
+	GPSCounter malformed;			//too short, or no *hh
+	GPSCounter noPosition;			//GGA without a position
+
+	GPSSentenceCounts types;
+
+	// From the arrival of the bytes that completed an epoch to its fix.
+	GPSLatencyHistogram inputToFix;
+};
+
+// Everything GPSDecoder::readStats() copies out, as plain numbers.
+struct GPSStatsSnapshot
+{
+	uint64_t bytes = 0;
+	uint64_t frames = 0;
+	uint64_t sentences = 0;
+	uint64_t checksumFailures = 0;
+	uint64_t malformed = 0;
+	uint64_t truncated = 0;
+	uint64_t overlong = 0;
+	uint64_t droppedBytes = 0;
+	uint64_t noPosition = 0;
+	uint64_t ubxFrames = 0;
+	uint64_t ubxChecksumFailures = 0;
+
+	// Epochs that went out without every sentence type the one before had.
+	uint64_t epochs = 0;
+	uint64_t partialEpochs = 0;
+
+	// Fixes GPSFixFilter kept from the outputs.
+	uint64_t fixesRejected = 0;
+
+	uint64_t sinkDrops = 0;
+
+	// KML track points lost to a file that could not be opened or written.
+	uint64_t KMLDrops = 0;
+
+	std::vector<std::pair<std::string, uint64_t>> types;
+	uint64_t otherTypes = 0;
+
+	GPSLatencySummary inputToFix;
+	// From the same arrival to the fix being handed to every sink.
+	GPSLatencySummary inputToSink;
+};
+
+enum GPSStatsFormat
+{
+	STATS_TEXT,
+	STATS_JSON,
+	STATS_PROMETHEUS
+};
+
+// One decoder's statistics under a label, which becomes the source="..."
+// label in Prometheus output and the key in JSON.
+struct GPSLabelledStats
+{
+	std::string label;
+	GPSStatsSnapshot stats;
+};
+
+std::string gpsFormatStats(const std::vector<GPSLabelledStats>& stats, GPSStatsFormat format);
+
+class GPSDecoder;
+
+// Writes the statistics of one or more decoders to a file every interval,
+// e.g. for the Prometheus node exporter's textfile collector. The file is
+// replaced by rename, so a reader never sees half of it.
+
+class GPSStatsDumper
+{
+public:
+	~GPSStatsDumper();
+
+	// Before start(). The decoders have to outlive the dumper.
+	void add(const GPSDecoder& decoder, const std::string& label);
+
+	// Returns 0 when the path cannot be written.
+	int start(const std::string& path, GPSStatsFormat format, std::chrono::milliseconds interval);
+
+	// Writes once more and stops.
+	void stop();
+
+	// Writes now, also without start(). Returns 1 on success.
+	int dump();
+
+private:
+	void dumpThread();
+
+	std::vector<std::pair<const GPSDecoder*, std::string>> decoders;
+	std::string path;
+	GPSStatsFormat format = STATS_TEXT;
+	std::chrono::milliseconds interval{10000};
+
+	std::mutex lock;
+	std::condition_variable wake;
+	bool stopping = false;
+	std::thread dumper;
+};
@@ -0,0 +1,576 @@
+#include "GPSTrackIndex.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "GPSGeodesy.h"
+
+static const char INDEX_FILE_MAGIC[8] = {'G', 'P', 'S', 'T', 'I', 'D', 'X', '1'};
+static const uint32_t INDEX_VERSION = 1;
+static const size_t INDEX_HEADER_SIZE = 28;
+
+static const double RADIANS = M_PI / 180.0;
+
+//smallest radii of curvature on WGS84, the meridian's at the equator and
+//the prime vertical's, so that a radius turned into degrees never falls short
+static const double MIN_MERIDIAN_RADIUS = 6335439.0;
+static const double MIN_PRIME_VERTICAL_RADIUS = 6378137.0;
+
+//the Hilbert curve runs over a 65536 x 65536 grid of the globe
+static const uint32_t HILBERT_SIDE = 1 << 16;
+
+enum AreaShape
+{
+	AREA_BOX,
+	AREA_CIRCLE,
+	AREA_POLYGON
+};
+
+struct GPSTrackIndex::Area
+{
+	AreaShape shape;
+	GPSTrackBox box;
+
+	//the exact area, in degrees
+	double minLatitude, minLongitude, maxLatitude, maxLongitude;
+	double latitude, longitude, metres;
+	const double* polygonLatitude;
+	const double* polygonLongitude;
+	size_t corners;
+
+	bool contains(const GPSTrackPoint& point) const;
+};
+
+static inline int32_t toFixed(double degrees)
+{
+	return (int32_t)std::floor(degrees * 1e7);
+}
+
+static inline bool insideBox(double latitude, double longitude, double minLatitude, double minLongitude, double maxLatitude, double maxLongitude)
+{
+	if((latitude < minLatitude) || (latitude > maxLatitude))
+		return false;
+	//a box across 180 degrees has its west edge east of its east edge
+	if(minLongitude <= maxLongitude)
+		return (longitude >= minLongitude) && (longitude <= maxLongitude);
+	return (longitude >= minLongitude) || (longitude <= maxLongitude);
+}
+
+// Even-odd rule, on latitude and longitude as plane coordinates.
+static bool insidePolygon(double latitude, double longitude, const double* lat, const double* lon, size_t corners)
+{
+	bool inside = false;
+	for(size_t i = 0, j = corners - 1; i < corners; j = i++)
+	{
+		if(((lat[i] > latitude) != (lat[j] > latitude))
+			&& (longitude < lon[j] + (latitude - lat[j]) * (lon[i] - lon[j]) / (lat[i] - lat[j])))
+			inside = !inside;
+	}
+	return inside;
+}
+
+bool GPSTrackIndex::Area::contains(const GPSTrackPoint& point) const
+{
+	double pointLatitude = point.latitude * 1e-7;
+	double pointLongitude = point.longitude * 1e-7;
+
+	if(!insideBox(pointLatitude, pointLongitude, minLatitude, minLongitude, maxLatitude, maxLongitude))
+		return false;
+
+	switch(shape)
+	{
+		case AREA_BOX: return true;
+		case AREA_CIRCLE: return gpsDistance(latitude, longitude, pointLatitude, pointLongitude) <= metres;
+		case AREA_POLYGON: return insidePolygon(pointLatitude, pointLongitude, polygonLatitude, polygonLongitude, corners);
+	}
+	return false;
+}
+
+static inline bool overlaps(const GPSTrackBox& a, const GPSTrackBox& b)
+{
+	return (a.minLatitude <= b.maxLatitude) && (a.maxLatitude >= b.minLatitude)
+		&& (a.minLongitude <= b.maxLongitude) && (a.maxLongitude >= b.minLongitude);
+}
+
+// Position along the Hilbert curve of cell x, y.
+static uint32_t hilbert(uint32_t x, uint32_t y)
+{
+	uint64_t d = 0;
+	for(uint32_t s = HILBERT_SIDE / 2; s > 0; s /= 2)
+	{
+		uint32_t rx = (x & s) ? 1 : 0;
+		uint32_t ry = (y & s) ? 1 : 0;
+		d += (uint64_t)s * s * ((3 * rx) ^ ry);
+
+		//rotate the quadrant so the curve stays continuous
+		if(ry == 0)
+		{
+			if(rx == 1)
+			{
+				x = HILBERT_SIDE - 1 - x;
+				y = HILBERT_SIDE - 1 - y;
+			}
+			std::swap(x, y);
+		}
+	}
+	return (uint32_t)d;
+}
+
+static uint32_t hilbertCentre(int32_t minLatitude, int32_t minLongitude, int32_t maxLatitude, int32_t maxLongitude)
+{
+	int64_t latitude = ((int64_t)minLatitude + maxLatitude) / 2 + 900000000;
+	int64_t longitude = ((int64_t)minLongitude + maxLongitude) / 2 + 1800000000;
+	uint32_t x = (uint32_t)std::min<int64_t>(HILBERT_SIDE - 1, std::max<int64_t>(0, longitude * HILBERT_SIDE / 3600000001LL));
+	uint32_t y = (uint32_t)std::min<int64_t>(HILBERT_SIDE - 1, std::max<int64_t>(0, latitude * HILBERT_SIDE / 1800000001LL));
+	return hilbert(x, y);
+}
+
+static void extend(GPSTrackBox& box, const GPSTrackBox& other)
+{
+	box.minTime = std::min(box.minTime, other.minTime);
+	box.maxTime = std::max(box.maxTime, other.maxTime);
+	box.minLatitude = std::min(box.minLatitude, other.minLatitude);
+	box.minLongitude = std::min(box.minLongitude, other.minLongitude);
+	box.maxLatitude = std::max(box.maxLatitude, other.maxLatitude);
+	box.maxLongitude = std::max(box.maxLongitude, other.maxLongitude);
+}
+
+void GPSTrackIndex::clear()
+{
+	tracks.clear();
+	entries.clear();
+	nodes.clear();
+	leafNodes = 0;
+}
+
+int GPSTrackIndex::build(const std::vector<std::string>& paths, int threads)
+{
+	clear();
+
+	tracks.resize(paths.size());
+	for(size_t i = 0; i < paths.size(); i++)
+		tracks[i].path = paths[i];
+
+	if(threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	//opening a track maps it and reads its block table, or walks its
+	//blocks when it was never closed, so the tracks are spread over threads
+	std::atomic<size_t> next{0};
+	std::atomic<bool> failed{false};
+	auto worker = [&]()
+	{
+		for(size_t i = next++; i < tracks.size(); i = next++)
+		{
+			struct stat st;
+			Track& track = tracks[i];
+			track.reader.reset(new GPSTrackReader);
+			if((stat(track.path.c_str(), &st) < 0) || !track.reader->open(track.path))
+			{
+				failed = true;
+				continue;
+			}
+			track.size = st.st_size;
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for(int i = 1; i < std::min<int>(threads, tracks.size()); i++)
+		pool.emplace_back(worker);
+	worker();
+	for(std::thread& thread : pool)
+		thread.join();
+
+	if(failed)
+	{
+		clear();
+		return 0;
+	}
+
+	for(size_t t = 0; t < tracks.size(); t++)
+	{
+		const GPSTrackReader& reader = *tracks[t].reader;
+		for(size_t b = 0; b < reader.blockCount(); b++)
+		{
+			const GPSTrackBlockIndex& block = reader.block(b);
+			Entry entry;
+			entry.box.minTime = block.minTime;
+			entry.box.maxTime = block.maxTime;
+			entry.box.minLatitude = block.minLatitude;
+			entry.box.minLongitude = block.minLongitude;
+			entry.box.maxLatitude = block.maxLatitude;
+			entry.box.maxLongitude = block.maxLongitude;
+			entry.track = t;
+			entry.block = b;
+			entries.push_back(entry);
+		}
+	}
+
+	pack();
+	return 1;
+}
+
+void GPSTrackIndex::pack()
+{
+	//Hilbert order of the block centres, ties in track order
+	std::vector<std::pair<uint32_t, uint32_t>> keys(entries.size());
+	for(size_t i = 0; i < entries.size(); i++)
+	{
+		const GPSTrackBox& box = entries[i].box;
+		keys[i] = std::make_pair(hilbertCentre(box.minLatitude, box.minLongitude, box.maxLatitude, box.maxLongitude), (uint32_t)i);
+	}
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<Entry> sorted(entries.size());
+	for(size_t i = 0; i < keys.size(); i++)
+		sorted[i] = entries[keys[i].second];
+	entries.swap(sorted);
+
+	//leaves over runs of entries, then each level over runs of the one below
+	nodes.clear();
+	for(size_t i = 0; i < entries.size(); i += NODE_SIZE)
+	{
+		Node node;
+		node.first = i;
+		node.count = std::min<size_t>(NODE_SIZE, entries.size() - i);
+		node.box = entries[i].box;
+		for(size_t j = i + 1; j < i + node.count; j++)
+			extend(node.box, entries[j].box);
+		nodes.push_back(node);
+	}
+	leafNodes = nodes.size();
+
+	size_t levelStart = 0;
+	while(nodes.size() - levelStart > 1)
+	{
+		size_t levelEnd = nodes.size();
+		for(size_t i = levelStart; i < levelEnd; i += NODE_SIZE)
+		{
+			Node node;
+			node.first = i;
+			node.count = std::min<size_t>(NODE_SIZE, levelEnd - i);
+			node.box = nodes[i].box;
+			for(size_t j = i + 1; j < i + node.count; j++)
+				extend(node.box, nodes[j].box);
+			nodes.push_back(node);
+		}
+		levelStart = levelEnd;
+	}
+}
+
+static void putUint32(std::string& out, uint32_t value)
+{
+	out.append((const char*)&value, sizeof(value));
+}
+
+static void putUint64(std::string& out, uint64_t value)
+{
+	out.append((const char*)&value, sizeof(value));
+}
+
+int GPSTrackIndex::save(const std::string& path) const
+{
+	std::string out(INDEX_FILE_MAGIC, sizeof(INDEX_FILE_MAGIC));
+	putUint32(out, INDEX_VERSION);
+	putUint32(out, tracks.size());
+	putUint32(out, entries.size());
+	putUint32(out, nodes.size());
+	putUint32(out, leafNodes);
+
+	for(const Track& track : tracks)
+	{
+		putUint64(out, track.size);
+		putUint32(out, track.path.size());
+		out.append(track.path);
+	}
+	out.append((const char*)entries.data(), entries.size() * sizeof(Entry));
+	out.append((const char*)nodes.data(), nodes.size() * sizeof(Node));
+
+	//write beside the file and rename over it
+	std::string temporary = path + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "w");
+	if(!file)
+		return 0;
+
+	bool written = (fwrite(out.data(), 1, out.size(), file) == out.size());
+	written = (fclose(file) == 0) && written;
+
+	if(!written || (rename(temporary.c_str(), path.c_str()) != 0))
+	{
+		unlink(temporary.c_str());
+		return 0;
+	}
+	return 1;
+}
+
+int GPSTrackIndex::load(const std::string& path)
+{
+	clear();
+
+	FILE* file = fopen(path.c_str(), "r");
+	if(!file)
+		return 0;
+
+	std::string in;
+	char buffer[64 << 10];
+	size_t n;
+	while((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		in.append(buffer, n);
+	fclose(file);
+
+	if((in.size() < INDEX_HEADER_SIZE) || memcmp(in.data(), INDEX_FILE_MAGIC, sizeof(INDEX_FILE_MAGIC)))
+		return 0;
+
+	uint32_t header[5];
+	memcpy(header, in.data() + 8, sizeof(header));
+	if(header[0] != INDEX_VERSION)
+		return 0;
+
+	//each track takes at least its size and path length
+	size_t p = INDEX_HEADER_SIZE;
+	if(header[1] > (in.size() - p) / 12)
+		return 0;
+	tracks.resize(header[1]);
+	for(Track& track : tracks)
+	{
+		uint32_t length;
+		if(p + 12 > in.size())
+		{
+			clear();
+			return 0;
+		}
+		memcpy(&track.size, in.data() + p, 8);
+		memcpy(&length, in.data() + p + 8, 4);
+		p += 12;
+		if(length > in.size() - p)
+		{
+			clear();
+			return 0;
+		}
+		track.path.assign(in.data() + p, length);
+		p += length;
+	}
+
+	size_t entryBytes = (size_t)header[2] * sizeof(Entry);
+	size_t nodeBytes = (size_t)header[3] * sizeof(Node);
+	if((p + entryBytes + nodeBytes != in.size()) || (header[4] > header[3]) || ((header[2] == 0) != (header[3] == 0)))
+	{
+		clear();
+		return 0;
+	}
+	entries.resize(header[2]);
+	memcpy(entries.data(), in.data() + p, entryBytes);
+	nodes.resize(header[3]);
+	memcpy(nodes.data(), in.data() + p + entryBytes, nodeBytes);
+	leafNodes = header[4];
+
+	//leaves over entries, every other node over nodes before it, each
+	//entry and node below exactly one, so the last node is the root
+	std::vector<uint8_t> covered(entries.size() + nodes.size(), 0);
+	for(size_t i = 0; i < nodes.size(); i++)
+	{
+		const Node& node = nodes[i];
+		size_t below = (i < leafNodes) ? entries.size() : i;
+		size_t offset = (i < leafNodes) ? 0 : entries.size();
+		if((node.count == 0) || (node.first > below) || (node.count > below - node.first))
+		{
+			clear();
+			return 0;
+		}
+		for(size_t j = node.first; j < node.first + node.count; j++)
+			if(covered[offset + j]++)
+			{
+				clear();
+				return 0;
+			}
+	}
+	for(size_t i = 0; i + 1 < covered.size(); i++)
+		if(!covered[i])
+		{
+			clear();
+			return 0;
+		}
+
+	//the blocks are only worth anything while the tracks are as indexed
+	for(Track& track : tracks)
+	{
+		struct stat st;
+		track.reader.reset(new GPSTrackReader);
+		if((stat(track.path.c_str(), &st) < 0) || ((uint64_t)st.st_size != track.size) || !track.reader->open(track.path))
+		{
+			clear();
+			return 0;
+		}
+	}
+	for(const Entry& entry : entries)
+		if((entry.track >= tracks.size()) || (entry.block >= tracks[entry.track].reader->blockCount()))
+		{
+			clear();
+			return 0;
+		}
+	return 1;
+}
+
+size_t GPSTrackIndex::query(const Area& area, int64_t from, int64_t to, GPSTrackMatchCallback callback, void* context) const
+{
+	lastBlocksRead = 0;
+	if(nodes.empty())
+		return 0;
+
+	const GPSTrackBox& search = area.box;
+
+	//down the tree to the blocks that may hold matches
+	std::vector<uint32_t> blocks;
+	std::vector<uint32_t> stack(1, nodes.size() - 1);
+	while(!stack.empty())
+	{
+		size_t index = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[index];
+		if((node.box.maxTime < from) || (node.box.minTime > to) || !overlaps(node.box, search))
+			continue;
+
+		for(uint32_t i = node.first; i < node.first + node.count; i++)
+		{
+			if(index >= leafNodes)
+				stack.push_back(i);
+			else
+			{
+				const GPSTrackBox& box = entries[i].box;
+				if((box.maxTime >= from) && (box.minTime <= to) && overlaps(box, search))
+					blocks.push_back(i);
+			}
+		}
+	}
+
+	//then through each track in file order
+	std::sort(blocks.begin(), blocks.end(), [this](uint32_t a, uint32_t b)
+	{
+		return (entries[a].track != entries[b].track) ? (entries[a].track < entries[b].track) : (entries[a].block < entries[b].block);
+	});
+
+	std::vector<GPSTrackPoint> decoded;
+	size_t found = 0;
+	for(uint32_t i : blocks)
+	{
+		const Track& track = tracks[entries[i].track];
+		decoded.resize(track.reader->blockPoints());
+		size_t count = track.reader->readBlock(entries[i].block, decoded.data());
+		lastBlocksRead++;
+
+		for(size_t j = 0; j < count; j++)
+		{
+			const GPSTrackPoint& point = decoded[j];
+			if((point.time < from) || (point.time > to) || !area.contains(point))
+				continue;
+
+			callback(track.path, point, context);
+			found++;
+		}
+	}
+	return found;
+}
+
+// The search box of an area given by its exact bounds in degrees. One
+// that crosses 180 degrees covers every longitude.
+static void searchBounds(double minLatitude, double minLongitude, double maxLatitude, double maxLongitude,
+	int32_t& minLat, int32_t& minLon, int32_t& maxLat, int32_t& maxLon)
+{
+	minLat = toFixed(std::max(-90.0, minLatitude));
+	maxLat = toFixed(std::min(90.0, maxLatitude)) + 1;
+	if(minLongitude <= maxLongitude)
+	{
+		minLon = toFixed(minLongitude);
+		maxLon = toFixed(maxLongitude) + 1;
+	}
+	else
+	{
+		minLon = toFixed(-180.0);
+		maxLon = toFixed(180.0) + 1;
+	}
+}
+
+size_t GPSTrackIndex::queryBox(double minLatitude, double minLongitude, double maxLatitude, double maxLongitude,
+	int64_t from, int64_t to, GPSTrackMatchCallback callback, void* context) const
+{
+	Area area = {};
+	area.shape = AREA_BOX;
+	area.minLatitude = minLatitude;
+	area.minLongitude = minLongitude;
+	area.maxLatitude = maxLatitude;
+	area.maxLongitude = maxLongitude;
+	searchBounds(minLatitude, minLongitude, maxLatitude, maxLongitude,
+		area.box.minLatitude, area.box.minLongitude, area.box.maxLatitude, area.box.maxLongitude);
+	return query(area, from, to, callback, context);
+}
+
+size_t GPSTrackIndex::queryRadius(double latitude, double longitude, double metres,
+	int64_t from, int64_t to, GPSTrackMatchCallback callback, void* context) const
+{
+	Area area = {};
+	area.shape = AREA_CIRCLE;
+	area.latitude = latitude;
+	area.longitude = longitude;
+	area.metres = metres;
+
+	//a box certain to hold the circle
+	double dLatitude = metres / (MIN_MERIDIAN_RADIUS * RADIANS);
+	double furthest = std::fabs(latitude) + dLatitude;
+	area.minLatitude = latitude - dLatitude;
+	area.maxLatitude = latitude + dLatitude;
+
+	double dLongitude = (furthest < 89.9) ? metres / (MIN_PRIME_VERTICAL_RADIUS * std::cos(furthest * RADIANS) * RADIANS) : 360;
+	if(dLongitude >= 180)
+	{
+		area.minLongitude = -180;
+		area.maxLongitude = 180;
+	}
+	else
+	{
+		area.minLongitude = longitude - dLongitude;
+		area.maxLongitude = longitude + dLongitude;
+		if(area.minLongitude < -180)
+			area.minLongitude += 360;
+		if(area.maxLongitude > 180)
+			area.maxLongitude -= 360;
+	}
+
+	searchBounds(area.minLatitude, area.minLongitude, area.maxLatitude, area.maxLongitude,
+		area.box.minLatitude, area.box.minLongitude, area.box.maxLatitude, area.box.maxLongitude);
+	return query(area, from, to, callback, context);
+}
+
+size_t GPSTrackIndex::queryPolygon(const double* latitude, const double* longitude, size_t corners,
+	int64_t from, int64_t to, GPSTrackMatchCallback callback, void* context) const
+{
+	if(corners < 3)
+		return 0;
+
+	Area area = {};
+	area.shape = AREA_POLYGON;
+	area.polygonLatitude = latitude;
+	area.polygonLongitude = longitude;
+	area.corners = corners;
+
+	area.minLatitude = area.maxLatitude = latitude[0];
+	area.minLongitude = area.maxLongitude = longitude[0];
+	for(size_t i = 1; i < corners; i++)
+	{
+		area.minLatitude = std::min(area.minLatitude, latitude[i]);
+		area.maxLatitude = std::max(area.maxLatitude, latitude[i]);
+		area.minLongitude = std::min(area.minLongitude, longitude[i]);
+		area.maxLongitude = std::max(area.maxLongitude, longitude[i]);
+	}
+
+	searchBounds(area.minLatitude, area.minLongitude, area.maxLatitude, area.maxLongitude,
+		area.box.minLatitude, area.box.minLongitude, area.box.maxLatitude, area.box.maxLongitude);
+	return query(area, from, to, callback, context);
+}
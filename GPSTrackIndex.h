@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GPSTrackLog.h"
+
+// Spatial and time index over any number of track logs.
+//
+// Every track log already ends in a table of its blocks' time ranges and
+// bounding boxes, written as the fixes are decoded. The index gathers
+// those tables, never the points, sorts the blocks by the Hilbert curve
+// position of their centres, so blocks close on the ground sit close in
+// the index, and packs them bottom up into an R-tree of NODE_SIZE wide
+// nodes, each with the box and time range of everything below it. A
+// query descends only into nodes that overlap both its area and its time
+// window, then decodes just the blocks it reached and tests their points.
+//
+//   header   "GPSTIDX1", uint32 version, uint32 track count,
+//            uint32 block count, uint32 node count, uint32 leaf count
+//   tracks   per track: uint64 file size, uint32 path length, path
+//   blocks   one Entry per block, in Hilbert order
+//   nodes    the tree, leaves first, the root last
+//
+// Paths are stored as given to build(). Everything is little endian.
+
+// Time range and bounding box, in the units of GPSTrackPoint.
+struct GPSTrackBox
+{
+	int64_t minTime;
+	int64_t maxTime;
+	int32_t minLatitude;
+	int32_t minLongitude;
+	int32_t maxLatitude;
+	int32_t maxLongitude;
+};
+
+typedef void (*GPSTrackMatchCallback)(const std::string& track, const GPSTrackPoint& point, void* context);
+
+class GPSTrackIndex
+{
+public:
+	static const int NODE_SIZE = 16;
+
+	static const int64_t ALL_TIME_FROM = std::numeric_limits<int64_t>::min();
+	static const int64_t ALL_TIME_TO = std::numeric_limits<int64_t>::max();
+
+	// Reads the block tables of the tracks, threads of them at once, 0 for
+	// every core. Returns 0 when a track cannot be opened.
+	int build(const std::vector<std::string>& tracks, int threads = 0);
+
+	// Returns 0 when the file cannot be written.
+	int save(const std::string& path) const;
+
+	// Returns 0 when the index cannot be read, or when a track it covers
+	// is gone or has changed size since; build it again then.
+	int load(const std::string& path);
+
+	size_t trackCount() const { return tracks.size(); }
+	const std::string& track(size_t i) const { return tracks[i].path; }
+	size_t blockCount() const { return entries.size(); }
+
+	// Calls back for every point in the area with from <= time <= to, and
+	// returns how many there were. Corners and the centre are in degrees.
+	// An area that crosses 180 degrees longitude is searched over every
+	// longitude in its latitudes, then tested exactly.
+	size_t queryBox(double minLatitude, double minLongitude, double maxLatitude, double maxLongitude,
+		int64_t from, int64_t to, GPSTrackMatchCallback callback, void* context) const;
+	size_t queryRadius(double latitude, double longitude, double metres,
+		int64_t from, int64_t to, GPSTrackMatchCallback callback, void* context) const;
+	// A simple polygon, not closed: the last corner joins the first.
+	size_t queryPolygon(const double* latitude, const double* longitude, size_t corners,
+		int64_t from, int64_t to, GPSTrackMatchCallback callback, void* context) const;
+
+	// Blocks the last query had to decode, to see what the index saved.
+	size_t blocksRead() const { return lastBlocksRead; }
+
+private:
+	struct Entry
+	{
+		GPSTrackBox box;
+		uint32_t track;
+		uint32_t block;
+	};
+
+	// Covers entries [first, first + count) on the leaf level, nodes on
+	// the others.
+	struct Node
+	{
+		GPSTrackBox box;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	struct Track
+	{
+		std::string path;
+		uint64_t size;
+		std::unique_ptr<GPSTrackReader> reader;
+	};
+
+	// An area as a box in 1e-7 degrees to search, and the exact test.
+	struct Area;
+
+	void clear();
+	void pack();
+	size_t query(const Area& area, int64_t from, int64_t to, GPSTrackMatchCallback callback, void* context) const;
+
+	std::vector<Track> tracks;
+	std::vector<Entry> entries;
+	std::vector<Node> nodes;
+	size_t leafNodes = 0;
+
+	mutable size_t lastBlocksRead = 0;
+};
@@ -0,0 +1,555 @@
+#include "GPSTrackLog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char TRACK_MAGIC[8] = {'G', 'P', 'S', 'T', 'R', 'K', '0', '1'};
+static const char INDEX_MAGIC[4] = {'G', 'I', 'D', 'X'};
+static const uint32_t TRACK_VERSION = 1;
+
+static const size_t HEADER_SIZE = 16;
+static const size_t BLOCK_HEADER_SIZE = 8;
+static const size_t TRAILER_SIZE = 16;
+
+static const int64_t MILLIS_PER_DAY = 24*60*60*1000LL;
+
+//the points are stored field by field in this order
+static const int POINT_FIELDS = 10;
+
+static_assert(sizeof(GPSTrackBlockIndex) == 48, "the index is written as is");
+
+static void fields(const GPSTrackPoint& point, int64_t* out)
+{
+	out[0] = point.time;
+	out[1] = point.latitude;
+	out[2] = point.longitude;
+	out[3] = point.altitude;
+	out[4] = point.speed;
+	out[5] = point.course;
+	out[6] = point.HDOP;
+	out[7] = point.quality;
+	out[8] = point.fixType;
+	out[9] = point.satellites;
+}
+
+static void setFields(GPSTrackPoint& point, const int64_t* in)
+{
+	point.time = in[0];
+	point.latitude = in[1];
+	point.longitude = in[2];
+	point.altitude = in[3];
+	point.speed = in[4];
+	point.course = in[5];
+	point.HDOP = in[6];
+	point.quality = in[7];
+	point.fixType = in[8];
+	point.satellites = in[9];
+}
+
+static void putVarint(std::vector<uint8_t>& out, int64_t value)
+{
+	uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+	while(zigzag >= 0x80)
+	{
+		out.push_back((uint8_t)(zigzag | 0x80));
+		zigzag >>= 7;
+	}
+	out.push_back((uint8_t)zigzag);
+}
+
+// Returns false when the varint runs past end.
+static bool getVarint(const uint8_t*& p, const uint8_t* end, int64_t& value)
+{
+	uint64_t zigzag = 0;
+	for(int shift = 0; shift < 64; shift += 7)
+	{
+		if(p == end)
+			return false;
+
+		uint8_t byte = *p++;
+		zigzag |= (uint64_t)(byte & 0x7F) << shift;
+		if(!(byte & 0x80))
+		{
+			value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+static void putUint32(uint8_t* out, uint32_t value)
+{
+	memcpy(out, &value, sizeof(value));
+}
+
+static uint32_t getUint32(const uint8_t* in)
+{
+	uint32_t value;
+	memcpy(&value, in, sizeof(value));
+	return value;
+}
+
+static int writeAll(int fd, const void* data, size_t length)
+{
+	const char* p = (const char*)data;
+	while(length > 0)
+	{
+		ssize_t n = write(fd, p, length);
+		if(n <= 0)
+			return 0;
+		p += n;
+		length -= n;
+	}
+	return 1;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date.
+static int64_t daysFromCivil(int year, int month, int day)
+{
+	year -= month <= 2;
+	int64_t era = (year >= 0 ? year : year - 399) / 400;
+	int yearOfEra = year - era*400;
+	int dayOfYear = (153*(month + (month > 2 ? -3 : 9)) + 2)/5 + day - 1;
+	int dayOfEra = yearOfEra*365 + yearOfEra/4 - yearOfEra/100 + dayOfYear;
+	return era*146097 + dayOfEra - 719468;
+}
+
+static void civilFromDays(int64_t days, int& year, int& month, int& day)
+{
+	days += 719468;
+	int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+	int dayOfEra = days - era*146097;
+	int yearOfEra = (dayOfEra - dayOfEra/1460 + dayOfEra/36524 - dayOfEra/146096) / 365;
+	int dayOfYear = dayOfEra - (365*yearOfEra + yearOfEra/4 - yearOfEra/100);
+	int mp = (5*dayOfYear + 2)/153;
+	day = dayOfYear - (153*mp + 2)/5 + 1;
+	month = mp + (mp < 10 ? 3 : -9);
+	year = yearOfEra + era*400 + (month <= 2);
+}
+
+int64_t gpsFixTime(const NMEADate& date, const NMEATime& time)
+{
+	int64_t millis = time.valid ? time.millisOfDay() : 0;
+	if(date.valid)
+		millis += daysFromCivil(date.year, date.month, date.day) * MILLIS_PER_DAY;
+	return millis;
+}
+
+int gpsParseTime(const char* text, int64_t& time)
+{
+	NMEADate date;
+	NMEATime clock;
+	if(sscanf(text, "%d-%d-%dT%d:%d:%d", &date.year, &date.month, &date.day, &clock.hour, &clock.minute, &clock.second) != 6)
+		return 0;
+
+	date.valid = clock.valid = true;
+	time = gpsFixTime(date, clock);
+	return 1;
+}
+
+GPSTrackPoint gpsTrackPoint(const GPSFix& fix)
+{
+	GPSTrackPoint point;
+	point.time = gpsFixTime(fix.date, fix.time);
+	point.latitude = (int32_t)std::llround(fix.latitude * 1e7);
+	point.longitude = (int32_t)std::llround(fix.longitude * 1e7);
+	point.altitude = (int32_t)std::lround(fix.altitude * 1000.0);
+	point.speed = (int32_t)std::lround(fix.speedKnots * 100.0);
+	point.course = (int32_t)std::lround(fix.course * 100.0);
+	point.HDOP = (int32_t)std::lround(fix.HDOP * 100.0);
+	point.quality = fix.quality;
+	point.fixType = fix.fixType;
+	point.satellites = fix.satellitesUsed;
+	return point;
+}
+
+GPSFix gpsTrackFix(const GPSTrackPoint& point)
+{
+	GPSFix fix;
+
+	int64_t days = point.time / MILLIS_PER_DAY;
+	int64_t millis = point.time % MILLIS_PER_DAY;
+	if(millis < 0)
+	{
+		millis += MILLIS_PER_DAY;
+		days--;
+	}
+
+	fix.time.hour = millis / 3600000;
+	fix.time.minute = (millis / 60000) % 60;
+	fix.time.second = (millis / 1000) % 60;
+	fix.time.millisecond = millis % 1000;
+	fix.time.valid = true;
+
+	//without a date the time is just the time of day
+	if(days != 0)
+	{
+		civilFromDays(days, fix.date.year, fix.date.month, fix.date.day);
+		fix.date.valid = true;
+	}
+
+	fix.latitude = point.latitude / 1e7;
+	fix.longitude = point.longitude / 1e7;
+	fix.altitude = point.altitude / 1000.0f;
+	fix.speedKnots = point.speed / 100.0f;
+	fix.course = point.course / 100.0f;
+	fix.HDOP = point.HDOP / 100.0f;
+	fix.quality = point.quality;
+	fix.fixType = point.fixType;
+	fix.satellitesUsed = point.satellites;
+	fix.status = point.quality > 0 ? 'A' : 'V';
+	fix.sentences = FIX_GGA | (fix.date.valid ? FIX_RMC : 0);
+	return fix;
+}
+
+GPSTrackWriter::~GPSTrackWriter()
+{
+	close();
+}
+
+int GPSTrackWriter::open(const std::string& path, uint32_t points)
+{
+	close();
+
+	fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(fd < 0)
+		return 0;
+
+	blockPoints = points ? std::min(points, MAX_BLOCK_POINTS) : DEFAULT_BLOCK_POINTS;
+
+	uint8_t header[HEADER_SIZE];
+	memcpy(header, TRACK_MAGIC, sizeof(TRACK_MAGIC));
+	putUint32(header + 8, TRACK_VERSION);
+	putUint32(header + 12, blockPoints);
+	if(!writeAll(fd, header, sizeof(header)))
+	{
+		::close(fd);
+		fd = -1;
+		return 0;
+	}
+
+	offset = HEADER_SIZE;
+	this->points = 0;
+	dated = false;
+	current.count = 0;
+	index.clear();
+
+	//a moving point rarely needs more than 16 bytes
+	block.reserve(BLOCK_HEADER_SIZE + blockPoints*16);
+	block.assign(BLOCK_HEADER_SIZE, 0);
+	return 1;
+}
+
+int GPSTrackWriter::add(const GPSFix& fix)
+{
+	GPSTrackPoint point = gpsTrackPoint(fix);
+	int64_t millisOfDay = fix.time.valid ? fix.time.millisOfDay() : 0;
+	if(fix.date.valid)
+	{
+		dated = true;
+		dayStart = point.time - millisOfDay;
+	}
+	else
+	{
+		//until then there is no day to put it in
+		if(!dated)
+			return 1;
+		if(millisOfDay < lastMillisOfDay - MILLIS_PER_DAY / 2)
+			dayStart += MILLIS_PER_DAY;
+		point.time = dayStart + millisOfDay;
+	}
+	lastMillisOfDay = millisOfDay;
+	return add(point);
+}
+
+int GPSTrackWriter::add(const GPSTrackPoint& point)
+{
+	if(fd < 0)
+		return 0;
+
+	if(current.count == 0)
+	{
+		previous = GPSTrackPoint();
+		current.minTime = current.maxTime = point.time;
+		current.minLatitude = current.maxLatitude = point.latitude;
+		current.minLongitude = current.maxLongitude = point.longitude;
+		current.offset = offset;
+	}
+
+	int64_t now[POINT_FIELDS];
+	int64_t before[POINT_FIELDS];
+	fields(point, now);
+	fields(previous, before);
+	for(int i = 0; i < POINT_FIELDS; i++)
+		putVarint(block, now[i] - before[i]);
+	previous = point;
+
+	current.minTime = std::min(current.minTime, point.time);
+	current.maxTime = std::max(current.maxTime, point.time);
+	current.minLatitude = std::min(current.minLatitude, point.latitude);
+	current.maxLatitude = std::max(current.maxLatitude, point.latitude);
+	current.minLongitude = std::min(current.minLongitude, point.longitude);
+	current.maxLongitude = std::max(current.maxLongitude, point.longitude);
+	current.count++;
+	points++;
+
+	if(current.count == blockPoints)
+		return writeBlock();
+	return 1;
+}
+
+int GPSTrackWriter::writeBlock()
+{
+	if(current.count == 0)
+		return 1;
+
+	current.length = block.size() - BLOCK_HEADER_SIZE;
+	putUint32(block.data(), current.count);
+	putUint32(block.data() + 4, current.length);
+
+	int ret = writeAll(fd, block.data(), block.size());
+	offset += block.size();
+	index.push_back(current);
+
+	current.count = 0;
+	block.resize(BLOCK_HEADER_SIZE);
+	return ret;
+}
+
+void GPSTrackWriter::close()
+{
+	if(fd < 0)
+		return;
+
+	writeBlock();
+
+	uint8_t trailer[TRAILER_SIZE];
+	memcpy(trailer, &offset, sizeof(offset));
+	putUint32(trailer + 8, index.size());
+	memcpy(trailer + 12, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+
+	writeAll(fd, index.data(), index.size()*sizeof(GPSTrackBlockIndex));
+	writeAll(fd, trailer, sizeof(trailer));
+
+	::close(fd);
+	fd = -1;
+}
+
+GPSTrackReader::~GPSTrackReader()
+{
+	close();
+}
+
+int GPSTrackReader::open(const std::string& path)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return 0;
+
+	struct stat st;
+	if((fstat(fd, &st) < 0) || ((size_t)st.st_size < HEADER_SIZE))
+	{
+		::close(fd);
+		return 0;
+	}
+
+	void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(mapped == MAP_FAILED)
+		return 0;
+
+	map = (const uint8_t*)mapped;
+	mapLength = st.st_size;
+
+	if(memcmp(map, TRACK_MAGIC, sizeof(TRACK_MAGIC)) || (getUint32(map + 8) != TRACK_VERSION))
+	{
+		close();
+		return 0;
+	}
+	maxBlockPoints = getUint32(map + 12);
+	if((maxBlockPoints == 0) || (maxBlockPoints > GPSTrackWriter::MAX_BLOCK_POINTS))
+	{
+		close();
+		return 0;
+	}
+
+	rebuilt = !loadIndex();
+	if(rebuilt)
+		rebuildIndex();
+
+	//findBlock() binary searches, and read() stops at the first block past
+	//the range, only in an index in time order
+	ordered = true;
+	for(size_t i = 1; ordered && (i < index.size()); i++)
+		ordered = (index[i].minTime >= index[i-1].minTime) && (index[i].maxTime >= index[i-1].maxTime);
+
+	//queries jump around the file
+	madvise(mapped, mapLength, MADV_RANDOM);
+
+	points = 0;
+	for(const GPSTrackBlockIndex& entry : index)
+		points += entry.count;
+	return 1;
+}
+
+void GPSTrackReader::close()
+{
+	if(map)
+		munmap((void*)map, mapLength);
+	map = nullptr;
+	mapLength = 0;
+	points = 0;
+	index.clear();
+}
+
+int GPSTrackReader::loadIndex()
+{
+	if(mapLength < HEADER_SIZE + TRAILER_SIZE)
+		return 0;
+
+	const uint8_t* trailer = map + mapLength - TRAILER_SIZE;
+	if(memcmp(trailer + 12, INDEX_MAGIC, sizeof(INDEX_MAGIC)))
+		return 0;
+
+	uint64_t indexOffset;
+	memcpy(&indexOffset, trailer, sizeof(indexOffset));
+	uint32_t count = getUint32(trailer + 8);
+	if((indexOffset < HEADER_SIZE) || (indexOffset > mapLength - TRAILER_SIZE)
+		|| ((uint64_t)count*sizeof(GPSTrackBlockIndex) != mapLength - TRAILER_SIZE - indexOffset))
+		return 0;
+
+	index.resize(count);
+	memcpy(index.data(), map + indexOffset, count*sizeof(GPSTrackBlockIndex));
+
+	//every block has to lie between the header and the index and agree
+	//with its own header, or the index is rebuilt from the blocks
+	for(const GPSTrackBlockIndex& entry : index)
+	{
+		if((entry.count == 0) || (entry.count > maxBlockPoints) || (entry.minTime > entry.maxTime)
+			|| (entry.offset < HEADER_SIZE) || (entry.offset > indexOffset - BLOCK_HEADER_SIZE)
+			|| (entry.length > indexOffset - BLOCK_HEADER_SIZE - entry.offset)
+			|| (getUint32(map + entry.offset) != entry.count) || (getUint32(map + entry.offset + 4) != entry.length))
+		{
+			index.clear();
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void GPSTrackReader::rebuildIndex()
+{
+	std::vector<GPSTrackPoint> decoded(maxBlockPoints);
+
+	uint64_t offset = HEADER_SIZE;
+	while(offset + BLOCK_HEADER_SIZE <= mapLength)
+	{
+		GPSTrackBlockIndex entry;
+		entry.offset = offset;
+		entry.count = getUint32(map + offset);
+		entry.length = getUint32(map + offset + 4);
+		if((entry.count == 0) || (entry.count > maxBlockPoints) || (offset + BLOCK_HEADER_SIZE + entry.length > mapLength))
+			break;
+
+		//a block cut short by a crash does not decode to its count
+		index.push_back(entry);
+		if(readBlock(index.size() - 1, decoded.data()) != entry.count)
+		{
+			index.pop_back();
+			break;
+		}
+
+		GPSTrackBlockIndex& added = index.back();
+		added.minTime = added.maxTime = decoded[0].time;
+		added.minLatitude = added.maxLatitude = decoded[0].latitude;
+		added.minLongitude = added.maxLongitude = decoded[0].longitude;
+		for(uint32_t i = 1; i < entry.count; i++)
+		{
+			added.minTime = std::min(added.minTime, decoded[i].time);
+			added.maxTime = std::max(added.maxTime, decoded[i].time);
+			added.minLatitude = std::min(added.minLatitude, decoded[i].latitude);
+			added.maxLatitude = std::max(added.maxLatitude, decoded[i].latitude);
+			added.minLongitude = std::min(added.minLongitude, decoded[i].longitude);
+			added.maxLongitude = std::max(added.maxLongitude, decoded[i].longitude);
+		}
+
+		offset += BLOCK_HEADER_SIZE + entry.length;
+	}
+}
+
+size_t GPSTrackReader::findBlock(int64_t time) const
+{
+	if(!ordered)
+		return 0;
+
+	auto found = std::lower_bound(index.begin(), index.end(), time,
+		[](const GPSTrackBlockIndex& entry, int64_t t) { return entry.maxTime < t; });
+	return found - index.begin();
+}
+
+size_t GPSTrackReader::readBlock(size_t block, GPSTrackPoint* out) const
+{
+	if(block >= index.size())
+		return 0;
+
+	const GPSTrackBlockIndex& entry = index[block];
+	if((entry.count > maxBlockPoints) || (entry.offset + BLOCK_HEADER_SIZE + entry.length > mapLength))
+		return 0;
+	const uint8_t* p = map + entry.offset + BLOCK_HEADER_SIZE;
+	const uint8_t* end = p + entry.length;
+
+	int64_t values[POINT_FIELDS] = {0};
+	for(uint32_t n = 0; n < entry.count; n++)
+	{
+		for(int i = 0; i < POINT_FIELDS; i++)
+		{
+			int64_t delta;
+			if(!getVarint(p, end, delta))
+				return n;
+			values[i] += delta;
+		}
+		setFields(out[n], values);
+	}
+
+	return (p == end) ? entry.count : 0;
+}
+
+size_t GPSTrackReader::read(int64_t from, int64_t to, GPSTrackPointCallback callback, void* context) const
+{
+	std::vector<GPSTrackPoint> decoded(maxBlockPoints);
+	size_t found = 0;
+
+	for(size_t block = findBlock(from); block < index.size(); block++)
+	{
+		//out of order blocks have to be looked at one by one
+		if(index[block].minTime > to)
+		{
+			if(ordered)
+				break;
+			continue;
+		}
+		if(index[block].maxTime < from)
+			continue;
+
+		size_t count = readBlock(block, decoded.data());
+		for(size_t i = 0; i < count; i++)
+		{
+			if((decoded[i].time < from) || (decoded[i].time > to))
+				continue;
+
+			callback(decoded[i], context);
+			found++;
+		}
+	}
+
+	return found;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GPSFix.h"
+
+// Compact binary track log.
+//
+// A track file is a header, a run of blocks and an index:
+//
+//   header   "GPSTRK01", uint32 version, uint32 points per block
+//   block    uint32 point count, uint32 byte length, then the points
+//   index    one GPSTrackBlockIndex per block
+//   trailer  uint64 index offset, uint32 block count, "GIDX"
+//
+// Points are quantized to fixed-size integers (GPSTrackPoint) and each
+// field is stored as the zigzag varint of its difference to the previous
+// point of the block, so a moving receiver costs 10 to 14 bytes a point.
+// The first point of a block is relative to zero, which makes every
+// block decodable on its own.
+//
+// The index holds each block's time range and bounding box. A reader maps
+// the file and binary searches the index, so seeking to a time range
+// touches only the blocks inside it. A file whose writer never got to
+// close() has no index, and one that does not match the blocks it points
+// at is not trusted; the reader rebuilds it by walking the blocks.
+// Everything is stored little endian. Points must be added in time order.
+
+struct GPSTrackPoint
+{
+	int64_t time = 0;			//milliseconds since 1970-01-01 UTC, or of the day without a date
+	int32_t latitude = 0;		//degrees * 1e7
+	int32_t longitude = 0;		//degrees * 1e7
+	int32_t altitude = 0;		//millimetres above mean sea level
+	int32_t speed = 0;			//knots * 100
+	int32_t course = 0;			//degrees * 100
+	int32_t HDOP = 0;			//* 100
+	int32_t quality = 0;
+	int32_t fixType = 0;
+	int32_t satellites = 0;
+};
+
+GPSTrackPoint gpsTrackPoint(const GPSFix& fix);
+GPSFix gpsTrackFix(const GPSTrackPoint& point);
+
+// Milliseconds since 1970-01-01 UTC, or since midnight without a valid date.
+int64_t gpsFixTime(const NMEADate& date, const NMEATime& time);
+
+// Reads yyyy-mm-ddThh:mm:ss, in UTC, as milliseconds since 1970-01-01.
+// Returns 0 when text is not in that form.
+int gpsParseTime(const char* text, int64_t& time);
+
+struct GPSTrackBlockIndex
+{
+	int64_t minTime;
+	int64_t maxTime;
+	int32_t minLatitude;
+	int32_t minLongitude;
+	int32_t maxLatitude;
+	int32_t maxLongitude;
+	uint64_t offset;			//of the block header
+	uint32_t count;
+	uint32_t length;			//of the encoded points
+};
+
+class GPSTrackWriter
+{
+public:
+	static const uint32_t DEFAULT_BLOCK_POINTS = 256;
+
+	// Readers refuse larger blocks, so a damaged header cannot make them
+	// allocate gigabytes.
+	static constexpr uint32_t MAX_BLOCK_POINTS = 1 << 16;
+
+	~GPSTrackWriter();
+
+	int open(const std::string& path, uint32_t blockPoints = DEFAULT_BLOCK_POINTS);
+
+	// Writes the last block and the index.
+	void close();
+
+	bool isOpen() const { return fd >= 0; }
+
+	int add(const GPSTrackPoint& point);
+
+	// A fix without a date, e.g. from GGA alone, takes the last date seen,
+	// and the day after once its time of day wraps past midnight. Undated
+	// fixes before the first date are not logged.
+	int add(const GPSFix& fix);
+
+	uint64_t pointCount() const { return points; }
+
+private:
+	int writeBlock();
+
+	int fd = -1;
+	uint32_t blockPoints = DEFAULT_BLOCK_POINTS;
+	uint64_t offset = 0;
+	uint64_t points = 0;
+
+	bool dated = false;
+	int64_t dayStart = 0;			//of the last fix logged
+	int64_t lastMillisOfDay = 0;
+
+	GPSTrackPoint previous;
+	GPSTrackBlockIndex current;
+	std::vector<uint8_t> block;		//block header, then the points
+	std::vector<GPSTrackBlockIndex> index;
+};
+
+typedef void (*GPSTrackPointCallback)(const GPSTrackPoint& point, void* context);
+
+class GPSTrackReader
+{
+public:
+	~GPSTrackReader();
+
+	int open(const std::string& path);
+	void close();
+
+	size_t blockCount() const { return index.size(); }
+	const GPSTrackBlockIndex& block(size_t i) const { return index[i]; }
+	uint32_t blockPoints() const { return maxBlockPoints; }
+
+	uint64_t pointCount() const { return points; }
+	int64_t startTime() const { return index.empty() ? 0 : index.front().minTime; }
+	int64_t endTime() const { return index.empty() ? 0 : index.back().maxTime; }
+
+	// First block that may hold points at or after time. 0 when the
+	// blocks are not in time order.
+	size_t findBlock(int64_t time) const;
+
+	// Decodes one block into out, which must hold blockPoints() points.
+	// Returns the number of points decoded.
+	size_t readBlock(size_t block, GPSTrackPoint* out) const;
+
+	// Calls back for every point with from <= time <= to and returns how
+	// many there were.
+	size_t read(int64_t from, int64_t to, GPSTrackPointCallback callback, void* context) const;
+
+	// True when the index was rebuilt because the file was not closed.
+	bool recovered() const { return rebuilt; }
+
+private:
+	int loadIndex();
+	void rebuildIndex();
+
+	const uint8_t* map = nullptr;
+	size_t mapLength = 0;
+
+	uint32_t maxBlockPoints = 0;
+	uint64_t points = 0;
+	bool rebuilt = false;
+	bool ordered = true;
+	std::vector<GPSTrackBlockIndex> index;
+};
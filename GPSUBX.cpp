@@ -0,0 +1,261 @@
+#include "GPSUBX.h"
+
+static inline uint16_t u2(const uint8_t* p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t u4(const uint8_t* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline int32_t i4(const uint8_t* p)
+{
+	return (int32_t)u4(p);
+}
+
+static inline void put2(uint8_t* p, uint32_t value)
+{
+	p[0] = (uint8_t)value;
+	p[1] = (uint8_t)(value >> 8);
+}
+
+static inline void put4(uint8_t* p, uint32_t value)
+{
+	put2(p, value);
+	put2(p + 2, value >> 16);
+}
+
+//field offsets into the NAV-PVT payload, u-blox 8 protocol 15 and later
+enum NavPVT
+{
+	PVT_YEAR = 4,
+	PVT_MONTH = 6,
+	PVT_DAY = 7,
+	PVT_HOUR = 8,
+	PVT_MINUTE = 9,
+	PVT_SECOND = 10,
+	PVT_VALID = 11,
+	PVT_NANO = 16,
+	PVT_FIX_TYPE = 20,
+	PVT_FLAGS = 21,
+	PVT_NUM_SV = 23,
+	PVT_LON = 24,
+	PVT_LAT = 28,
+	PVT_HEIGHT = 32,
+	PVT_HMSL = 36,
+	PVT_GROUND_SPEED = 60,
+	PVT_HEADING = 64,
+	PVT_PDOP = 76,
+	PVT_LENGTH = 92
+};
+
+//NAV-SAT: an 8 byte header, then 12 bytes per satellite
+enum NavSat
+{
+	SAT_NUM_SVS = 5,
+	SAT_HEADER = 8,
+	SAT_GNSS_ID = 0,
+	SAT_SV_ID = 1,
+	SAT_CNO = 2,
+	SAT_ELEVATION = 3,
+	SAT_AZIMUTH = 4,
+	SAT_BLOCK = 12
+};
+
+void ubxChecksum(const uint8_t* p, size_t length, uint8_t& a, uint8_t& b)
+{
+	uint8_t sumA = 0;
+	uint8_t sumB = 0;
+	for(size_t i = 0; i < length; i++)
+	{
+		sumA += p[i];
+		sumB += sumA;
+	}
+	a = sumA;
+	b = sumB;
+}
+
+bool ubxFrameValid(const uint8_t* frame, size_t length)
+{
+	if((length < UBX_HEADER_LENGTH + UBX_CHECKSUM_LENGTH) || (frame[0] != UBX_SYNC1) || (frame[1] != UBX_SYNC2))
+		return false;
+	if(length != UBX_HEADER_LENGTH + u2(frame + 4) + UBX_CHECKSUM_LENGTH)
+		return false;
+
+	uint8_t a, b;
+	ubxChecksum(frame + 2, length - 4, a, b);
+	return (frame[length-2] == a) && (frame[length-1] == b);
+}
+
+const char* ubxMessageName(uint8_t msgClass, uint8_t msgID)
+{
+	switch((msgClass << 8) | msgID)
+	{
+		case (UBX_NAV << 8) | UBX_NAV_PVT: return "NAV-PVT";
+		case (UBX_NAV << 8) | UBX_NAV_SAT: return "NAV-SAT";
+		case (UBX_ACK << 8) | UBX_ACK_ACK: return "ACK-ACK";
+		case (UBX_ACK << 8) | UBX_ACK_NAK: return "ACK-NAK";
+		default: return nullptr;
+	}
+}
+
+bool ubxParseNavPVT(const uint8_t* p, size_t length, GPSFix& fix)
+{
+	if(length < PVT_LENGTH)
+		return false;
+
+	fix = GPSFix();
+	fix.talker.set("GN");
+
+	uint8_t valid = p[PVT_VALID];
+	fix.date.valid = valid & 0x01;
+	fix.date.year = u2(p + PVT_YEAR);
+	fix.date.month = p[PVT_MONTH];
+	fix.date.day = p[PVT_DAY];
+
+	//nano is signed, round to the nearest millisecond and carry; a day
+	//added up front keeps the division away from negative numbers
+	int64_t nanos = (int64_t)((p[PVT_HOUR]*60 + p[PVT_MINUTE])*60 + p[PVT_SECOND] + 86400) * 1000000000;
+	nanos += i4(p + PVT_NANO) + 500000;
+	int32_t millis = (int32_t)((nanos / 1000000) % 86400000);
+
+	fix.time.valid = valid & 0x02;
+	fix.time.hour = millis / 3600000;
+	fix.time.minute = (millis / 60000) % 60;
+	fix.time.second = (millis / 1000) % 60;
+	fix.time.millisecond = millis % 1000;
+
+	fix.longitude = i4(p + PVT_LON) * 1e-7;
+	fix.latitude = i4(p + PVT_LAT) * 1e-7;
+	int32_t hMSL = i4(p + PVT_HMSL);
+	fix.altitude = hMSL / 1000.0f;
+	fix.heightOfGeoid = ((int64_t)i4(p + PVT_HEIGHT) - hMSL) / 1000.0f;
+
+	//mm/s to knots, 1e-5 degrees
+	fix.speedKnots = i4(p + PVT_GROUND_SPEED) / 514.444f;
+	fix.course = i4(p + PVT_HEADING) * 1e-5f;
+
+	//the GGA quality and GSA fix type the receiver would have sent
+	uint8_t fixType = p[PVT_FIX_TYPE];
+	uint8_t flags = p[PVT_FLAGS];
+	bool fixOK = flags & 0x01;
+	int carrier = (flags >> 6) & 0x03;
+
+	if(!fixOK)
+		fix.quality = 0;
+	else if(fixType == 1)
+		fix.quality = 6;
+	else if(carrier == 2)
+		fix.quality = 4;
+	else if(carrier == 1)
+		fix.quality = 5;
+	else if(flags & 0x02)
+		fix.quality = 2;
+	else
+		fix.quality = 1;
+
+	fix.fixType = (fixType == 2) ? 2 : ((fixType == 3) || (fixType == 4)) ? 3 : 1;
+	fix.status = fixOK ? 'A' : 'V';
+
+	fix.PDOP = u2(p + PVT_PDOP) * 0.01f;
+	fix.satellitesUsed = p[PVT_NUM_SV];
+
+	fix.sentences = FIX_PVT;
+	return true;
+}
+
+static GPSConstellation ubxConstellation(uint8_t gnssID)
+{
+	switch(gnssID)
+	{
+		case 0: return CONSTELLATION_GPS;
+		case 1: return CONSTELLATION_SBAS;
+		case 2: return CONSTELLATION_GALILEO;
+		case 3: return CONSTELLATION_BEIDOU;
+		case 5: return CONSTELLATION_QZSS;
+		case 6: return CONSTELLATION_GLONASS;
+		default: return CONSTELLATION_UNKNOWN;
+	}
+}
+
+bool ubxParseNavSat(const uint8_t* p, size_t length, GPSSatTable& out)
+{
+	if(length < SAT_HEADER)
+		return false;
+
+	int count = p[SAT_NUM_SVS];
+	if(length < SAT_HEADER + (size_t)count * SAT_BLOCK)
+		return false;
+
+	out.count = 0;
+	for(int i = 0; (i < count) && (out.count < GPSSatTable::CAPACITY); i++)
+	{
+		const uint8_t* sv = p + SAT_HEADER + i * SAT_BLOCK;
+
+		int n = out.count++;
+		out.constellation[n] = ubxConstellation(sv[SAT_GNSS_ID]);
+		out.talker[n] = 0;
+		out.prn[n] = sv[SAT_SV_ID];
+		out.elevation[n] = (int8_t)sv[SAT_ELEVATION];
+		out.azimuth[n] = u2(sv + SAT_AZIMUTH);
+		out.SNR[n] = sv[SAT_CNO];
+	}
+	return true;
+}
+
+void ubxAppendMessage(std::string& out, uint8_t msgClass, uint8_t msgID, const uint8_t* payload, size_t length)
+{
+	uint8_t header[UBX_HEADER_LENGTH] = {UBX_SYNC1, UBX_SYNC2, msgClass, msgID};
+	put2(header + 4, length);
+
+	uint8_t a, b;
+	ubxChecksum(header + 2, 4, a, b);
+	for(size_t i = 0; i < length; i++)
+	{
+		a += payload[i];
+		b += a;
+	}
+
+	out.append((const char*)header, sizeof(header));
+	out.append((const char*)payload, length);
+	out.push_back((char)a);
+	out.push_back((char)b);
+}
+
+std::string ubxConfigMessages(const GPSUBXConfig& config)
+{
+	std::string out;
+	if((config.rateHz < 0) || (config.rateHz > UBX_MAX_RATE_HZ))
+		return out;
+
+	//protocols first, so the answers to the rest come back as UBX
+	uint8_t port[20] = {0};
+	port[0] = config.port;
+	if((config.port == 1) || (config.port == 2))
+	{
+		put4(port + 4, 0x08D0);					//8N1
+		put4(port + 8, config.baud);
+	}
+	put2(port + 12, UBX_PROTOCOL_UBX | UBX_PROTOCOL_NMEA);
+	put2(port + 14, config.outProtocols | UBX_PROTOCOL_UBX);
+	ubxAppendMessage(out, UBX_CFG, UBX_CFG_PRT, port, sizeof(port));
+
+	if(config.rateHz > 0)
+	{
+		uint8_t rate[6];
+		put2(rate, 1000 / config.rateHz);		//measurement period, ms
+		put2(rate + 2, 1);						//one solution per measurement
+		put2(rate + 4, 1);						//aligned to GPS time
+		ubxAppendMessage(out, UBX_CFG, UBX_CFG_RATE, rate, sizeof(rate));
+	}
+
+	//on the port the message is sent over
+	uint8_t pvt[3] = {UBX_NAV, UBX_NAV_PVT, (uint8_t)config.navPVT};
+	ubxAppendMessage(out, UBX_CFG, UBX_CFG_MSG, pvt, sizeof(pvt));
+	uint8_t sat[3] = {UBX_NAV, UBX_NAV_SAT, (uint8_t)config.navSat};
+	ubxAppendMessage(out, UBX_CFG, UBX_CFG_MSG, sat, sizeof(sat));
+
+	return out;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "GPSFix.h"
+#include "GPSSatellites.h"
+
+// u-blox UBX binary protocol, for receivers run at rates where NMEA text
+// no longer fits the link.
+//
+// A UBX frame is 0xB5 0x62, class, id, a little-endian payload length,
+// the payload and an 8-bit Fletcher checksum over class through payload.
+// NMEAFramer cuts UBX frames out of the same byte stream as NMEA; the
+// payload is read in place through fixed field offsets, never copied into
+// a packed struct.
+
+static const uint8_t UBX_SYNC1 = 0xB5;
+static const uint8_t UBX_SYNC2 = 0x62;
+
+// Sync, class, id and length before the payload; the checksum after it.
+static const size_t UBX_HEADER_LENGTH = 6;
+static const size_t UBX_CHECKSUM_LENGTH = 2;
+
+// Longest payload taken, NAV-SAT for 84 satellites.
+static const size_t UBX_MAX_PAYLOAD = 1024;
+static const size_t UBX_MAX_FRAME = UBX_HEADER_LENGTH + UBX_MAX_PAYLOAD + UBX_CHECKSUM_LENGTH;
+
+enum UBXClass
+{
+	UBX_NAV = 0x01,
+	UBX_ACK = 0x05,
+	UBX_CFG = 0x06,
+};
+
+enum UBXMessage
+{
+	UBX_NAV_PVT = 0x07,
+	UBX_NAV_SAT = 0x35,
+
+	UBX_ACK_NAK = 0x00,
+	UBX_ACK_ACK = 0x01,
+
+	UBX_CFG_PRT = 0x00,
+	UBX_CFG_MSG = 0x01,
+	UBX_CFG_RATE = 0x08,
+};
+
+// Fletcher checksum over length bytes, class through the end of payload.
+void ubxChecksum(const uint8_t* p, size_t length, uint8_t& a, uint8_t& b);
+
+// A whole frame, sync through checksum, checks out.
+bool ubxFrameValid(const uint8_t* frame, size_t length);
+
+// "NAV-PVT" and the like for the messages known here, nullptr otherwise.
+const char* ubxMessageName(uint8_t msgClass, uint8_t msgID);
+
+// NAV-PVT to the fix an NMEA epoch would have given. Returns false when
+// the payload is too short.
+bool ubxParseNavPVT(const uint8_t* payload, size_t length, GPSFix& fix);
+
+// NAV-SAT to a satellite table, every constellation at once. Returns false
+// when the payload is too short for the satellites it announces.
+bool ubxParseNavSat(const uint8_t* payload, size_t length, GPSSatTable& out);
+
+// Appends a complete frame with its checksum.
+void ubxAppendMessage(std::string& out, uint8_t msgClass, uint8_t msgID, const uint8_t* payload, size_t length);
+
+// Protocol bits of CFG-PRT.
+enum UBXProtocol
+{
+	UBX_PROTOCOL_UBX = 1 << 0,
+	UBX_PROTOCOL_NMEA = 1 << 1,
+};
+
+// What GPSDecoder::configureUBX() sends. The legacy CFG-RATE, CFG-MSG and
+// CFG-PRT messages, which M8 and older receivers take and later ones
+// still accept.
+struct GPSUBXConfig
+{
+	// Navigation rate, 1 to UBX_MAX_RATE_HZ, 0 leaves it alone.
+	int rateHz = 0;
+
+	// Output every this many navigation solutions, 0 turns it off.
+	int navPVT = 1;
+	int navSat = 1;
+
+	// Protocols the port sends. Leaving NMEA on keeps text tools working
+	// at the cost of link bandwidth.
+	int outProtocols = UBX_PROTOCOL_UBX | UBX_PROTOCOL_NMEA;
+
+	// CFG-PRT port: 1 UART1, 3 USB. Baud is only used on a UART.
+	int port = 3;
+	int baud = 38400;
+};
+
+// The fastest navigation rate any u-blox receiver runs at.
+static const int UBX_MAX_RATE_HZ = 40;
+
+// The frames for config, in the order to send them. Empty when rateHz is
+// out of range.
+std::string ubxConfigMessages(const GPSUBXConfig& config);
@@ -0,0 +1,94 @@
+#include "NMEADispatch.h"
+
+bool nmeaSplitAddress(std::string_view address, std::string_view& talker, std::string_view& type)
+{
+	//proprietary sentences are P + manufacturer + optional type
+	if(address.length() >= 2 && address[0] == 'P')
+	{
+		talker = address.substr(0, 1);
+		type = address;
+		return true;
+	}
+
+	if(address.length() != 5)
+		return false;
+
+	talker = address.substr(0, 2);
+	type = address.substr(2, 3);
+	return true;
+}
+
+const NMEADispatcher::Entry* NMEADispatcher::find(NMEASentenceKey key) const
+{
+	int i = slot(key);
+	for(int probe = 0; probe < TABLE_SIZE; probe++)
+	{
+		const Entry& entry = table[i];
+		if(entry.key == key)
+			return entry.handler ? &entry : nullptr;
+		if(entry.key == 0)
+			return nullptr;
+		i = (i + 1) & (TABLE_SIZE - 1);
+	}
+	return nullptr;
+}
+
+bool NMEADispatcher::add(NMEASentenceKey key, NMEASentenceHandler handler, void* context)
+{
+	if(key == 0 || handler == nullptr)
+		return false;
+
+	int i = slot(key);
+	for(int probe = 0; probe < TABLE_SIZE; probe++)
+	{
+		Entry& entry = table[i];
+		if(entry.key == 0 || entry.key == key)
+		{
+			if(entry.key == 0)
+				entryCount++;
+			entry.key = key;
+			entry.handler = handler;
+			entry.context = context;
+			return true;
+		}
+		i = (i + 1) & (TABLE_SIZE - 1);
+	}
+	return false;
+}
+
+void NMEADispatcher::remove(NMEASentenceKey key)
+{
+	//leave the key in place so later probes still find their entries
+	int i = slot(key);
+	for(int probe = 0; probe < TABLE_SIZE; probe++)
+	{
+		Entry& entry = table[i];
+		if(entry.key == key)
+		{
+			entry.handler = nullptr;
+			entry.context = nullptr;
+			return;
+		}
+		if(entry.key == 0)
+			return;
+		i = (i + 1) & (TABLE_SIZE - 1);
+	}
+}
+
+bool NMEADispatcher::dispatch(const NMEAFields& fields) const
+{
+	std::string_view address = fields[0];
+	std::string_view talker, type;
+
+	if(!nmeaSplitAddress(address, talker, type))
+		return false;
+
+	const Entry* entry = find(nmeaSentenceKey(address));
+	if(entry == nullptr && type.length() != address.length())
+		entry = find(nmeaSentenceKey(type));
+	if(entry == nullptr)
+		return false;
+
+	entry->handler(fields, entry->context);
+	return true;
+}
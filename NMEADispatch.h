@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "NMEAFields.h"
+
+// Sentence dispatch keyed on the packed address field.
+//
+//  $GNGGA,...   talker "GN", type "GGA"
+//  $PUBX,00,... proprietary, no talker, type "PUBX"
+//
+// Up to eight address characters are packed into one integer, so a key
+// for a literal is a compile time constant and a lookup is a single probe
+// of a small open addressed table. A handler can be registered for a type
+// on every talker ("GGA"), for one talker ("GLGSV") or for a proprietary
+// address ("PUBX"); the talker specific entry wins when both exist.
+
+typedef uint64_t NMEASentenceKey;
+
+constexpr NMEASentenceKey nmeaSentenceKey(std::string_view type)
+{
+	NMEASentenceKey key = 0;
+	for(size_t i = 0; i < type.length() && i < 8; i++)
+		key = (key << 8) | (unsigned char)type[i];
+	return key;
+}
+
+// GP = GPS, GL = GLONASS, GA = Galileo, BD/GB = BeiDou, GN = combined.
+// Proprietary sentences report talker "P".
+struct NMEATalker
+{
+	char id[3] = {0, 0, 0};
+
+	void set(std::string_view talker)
+	{
+		id[0] = talker.length() > 0 ? talker[0] : 0;
+		id[1] = talker.length() > 1 ? talker[1] : 0;
+		id[2] = 0;
+	}
+	std::string_view view() const { return std::string_view(id); }
+	bool operator==(const char* other) const { return view() == other; }
+};
+
+// Splits an address field into talker and type. Returns false when the
+// address is too short to be a sentence.
+bool nmeaSplitAddress(std::string_view address, std::string_view& talker, std::string_view& type);
+
+typedef void (*NMEASentenceHandler)(const NMEAFields& fields, void* context);
+
+class NMEADispatcher
+{
+public:
+	static const int TABLE_SIZE = 64;
+
+	// Adds or replaces the handler for a key. Returns false when full.
+	bool add(NMEASentenceKey key, NMEASentenceHandler handler, void* context);
+	bool add(std::string_view type, NMEASentenceHandler handler, void* context)
+	{
+		return add(nmeaSentenceKey(type), handler, context);
+	}
+	void remove(NMEASentenceKey key);
+
+	// Runs the handler for the sentence, returns false when there is none.
+	bool dispatch(const NMEAFields& fields) const;
+
+	int count() const { return entryCount; }
+
+private:
+	struct Entry
+	{
+		NMEASentenceKey key = 0;
+		NMEASentenceHandler handler = nullptr;
+		void* context = nullptr;
+	};
+
+	static int slot(NMEASentenceKey key)
+	{
+		return (int)((key * 0x9E3779B97F4A7C15ull) >> 58);
+	}
+	const Entry* find(NMEASentenceKey key) const;
+
+	Entry table[TABLE_SIZE];
+	int entryCount = 0;
+};
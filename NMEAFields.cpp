@@ -0,0 +1,50 @@
+#include "NMEAFields.h"
+
+NMEAFields::NMEAFields(const char* sentence, size_t length)
+{
+	split(sentence, length);
+}
+
+int NMEAFields::split(const char* sentence, size_t length)
+{
+	const char* p = sentence;
+	const char* end = sentence + length;
+
+	fieldCount = 0;
+	fieldsTruncated = false;
+
+	//skip the start delimiter
+	if(p != end && (*p == '$' || *p == '!'))
+		p++;
+
+	//the checksum and line ending are not fields
+	for(const char* q = p; q != end; q++)
+	{
+		if(*q == '*' || *q == '\r' || *q == '\n' || *q == 0)
+		{
+			end = q;
+			break;
+		}
+	}
+
+	const char* fieldStart = p;
+	for(;;)
+	{
+		if(p == end || *p == ',')
+		{
+			if(fieldCount == MAX_FIELDS)
+			{
+				fieldsTruncated = true;
+				break;
+			}
+			fields[fieldCount++] = std::string_view(fieldStart, p - fieldStart);
+
+			if(p == end)
+				break;
+			fieldStart = p + 1;
+		}
+		p++;
+	}
+
+	return fieldCount;
+}
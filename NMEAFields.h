@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Splits one NMEA sentence into its comma separated fields in place.
+//
+//  $GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39
+//
+// Where:
+// 	 field 0      "GPGSA" - the address, without the leading $ or !
+// 	 field 1      "A"
+// 	 field 4      "05"
+// 	 field 5      ""      - empty fields are kept, so indices never shift
+// 	 *39          the checksum is not part of any field
+//
+// Every field is a view into the caller's buffer: nothing is copied or
+// allocated and the buffer is never modified, so one sentence can be split
+// on any number of threads at once. The buffer must outlive the fields.
+
+class NMEAFields
+{
+public:
+	static const int MAX_FIELDS = 64;
+
+	NMEAFields() = default;
+	NMEAFields(const char* sentence, size_t length);
+
+	int split(const char* sentence, size_t length);
+
+	int count() const { return fieldCount; }
+	bool truncated() const { return fieldsTruncated; }
+
+	// Out of range indices give an empty field rather than a bad pointer.
+	std::string_view operator[](int i) const
+	{
+		return (i >= 0 && i < fieldCount) ? fields[i] : std::string_view();
+	}
+
+	bool empty(int i) const { return (*this)[i].empty(); }
+	char firstChar(int i) const
+	{
+		std::string_view f = (*this)[i];
+		return f.empty() ? 0 : f[0];
+	}
+
+private:
+	std::string_view fields[MAX_FIELDS];
+	int fieldCount = 0;
+	bool fieldsTruncated = false;
+};
@@ -0,0 +1,228 @@
+#include "NMEAFramer.h"
+#include "NMEAScan.h"
+
+#include <algorithm>
+#include <cstring>
+
+static inline bool isLineEnding(char c)
+{
+	return (c == '\r') || (c == '\n');
+}
+
+static inline bool isUBXStart(char c)
+{
+	return (uint8_t)c == UBX_SYNC1;
+}
+
+void NMEAFramer::setMaxLength(size_t length)
+{
+	//room for at least "$*hh" and the line ending
+	limit = std::min(std::max(length, (size_t)6), BUFFER_SIZE + 2) - 2;
+}
+
+size_t NMEAFramer::feed(const char* data, size_t length, NMEAFrameCallback frame, void* context)
+{
+	const char* p = data;
+	const char* end = data + length;
+	size_t count = 0;
+
+	//a frame held from the last feed carries on at the start of this one
+	const char* start = data;
+
+	while(p < end)
+	{
+		if(state == UBX)
+		{
+			p = ubx(start, end, frame, context, count);
+			continue;
+		}
+
+		const char* boundary = nmeaFindBoundary(p, end);
+
+		if(state != FRAME)
+		{
+			//noise, or the rest of an overlong frame
+			if(boundary != p)
+				dropped.add(boundary - p);
+			if(boundary == end)
+				break;
+
+			p = boundary + 1;
+			if(isLineEnding(*boundary))
+			{
+				state = HUNT;
+				continue;
+			}
+
+			state = FRAME;
+			start = boundary;
+			held = 0;
+
+			//the UBX state picks up from the sync byte itself
+			if(isUBXStart(*boundary))
+			{
+				state = UBX;
+				p = boundary;
+			}
+			continue;
+		}
+
+		if(boundary == end)
+			break;
+
+		size_t frameLength = held + (boundary - start);
+		p = boundary + 1;
+
+		if(frameLength > limit)
+		{
+			overlongCount.add();
+			dropped.add(frameLength);
+		}
+		else if(!isLineEnding(*boundary))
+		{
+			truncatedCount.add();
+			dropped.add(frameLength);
+		}
+		else if(held > 0)
+		{
+			memcpy(buffer + held, start, boundary - start);
+			frameCount.add();
+			count++;
+			frame(buffer, frameLength, context);
+		}
+		else
+		{
+			frameCount.add();
+			count++;
+			frame(start, frameLength, context);
+		}
+		held = 0;
+
+		//a frame start that cut the frame short starts the next one
+		if(isLineEnding(*boundary))
+			state = HUNT;
+		else if(isUBXStart(*boundary))
+		{
+			state = UBX;
+			start = boundary;
+			p = boundary;
+		}
+		else
+			start = boundary;
+	}
+
+	//keep the start of a frame that goes on in the next feed
+	if(state == FRAME)
+	{
+		size_t partial = end - start;
+		if(held + partial > limit)
+		{
+			overlongCount.add();
+			dropped.add(held + partial);
+			held = 0;
+			state = SKIP;
+		}
+		else
+		{
+			memcpy(buffer + held, start, partial);
+			held += partial;
+		}
+	}
+
+	return count;
+}
+
+const char* NMEAFramer::ubx(const char* start, const char* end, NMEAFrameCallback frame, void* context, size_t& count)
+{
+	//the frame so far: held bytes from earlier feeds, then [start, end)
+	size_t available = held + (end - start);
+	auto at = [&](size_t i) { return (uint8_t)((i < held) ? buffer[i] : start[i - held]); };
+
+	//a lone 0xB5, or a length no receiver sends
+	if((available >= 2) && (at(1) != UBX_SYNC2))
+		return resync(start, frame, context, count);
+
+	size_t length = 0;
+	if(available >= UBX_HEADER_LENGTH)
+	{
+		length = UBX_HEADER_LENGTH + (at(4) | (at(5) << 8)) + UBX_CHECKSUM_LENGTH;
+		if(length > UBX_MAX_FRAME)
+		{
+			overlongCount.add();
+			return resync(start, frame, context, count);
+		}
+	}
+
+	//keep what there is until the rest arrives
+	if((length == 0) || (available < length))
+	{
+		memcpy(buffer + held, start, end - start);
+		held = available;
+		return end;
+	}
+
+	const char* next = start + (length - held);
+	const char* whole = start;
+	if(held > 0)
+	{
+		memcpy(buffer + held, start, next - start);
+		whole = buffer;
+	}
+
+	if(!ubxFrameValid((const uint8_t*)whole, length))
+	{
+		ubxBadCount.add();
+		return resync(start, frame, context, count);
+	}
+
+	held = 0;
+	state = HUNT;
+	frameCount.add();
+	ubxCount.add();
+	count++;
+	frame(whole, length, context);
+	return next;
+}
+
+const char* NMEAFramer::resync(const char* start, NMEAFrameCallback frame, void* context, size_t& count)
+{
+	//hunt again from the byte after the sync
+	dropped.add(1);
+	state = HUNT;
+	if(held == 0)
+		return start + 1;
+
+	//bytes held from earlier feeds come before this one's, scan those
+	//first; whatever frame they leave open carries on at start
+	char earlier[UBX_MAX_FRAME];
+	size_t length = held - 1;
+	memcpy(earlier, buffer + 1, length);
+	held = 0;
+	count += feed(earlier, length, frame, context);
+	return start;
+}
+
+size_t NMEAFramer::finish(NMEAFrameCallback frame, void* context)
+{
+	size_t count = 0;
+	if((state == FRAME) && (held > 0))
+	{
+		frameCount.add();
+		count++;
+		frame(buffer, held, context);
+	}
+	else if(state == UBX)
+		dropped.add(held);
+
+	held = 0;
+	state = HUNT;
+	return count;
+}
+
+void NMEAFramer::reset()
+{
+	if(held > 0)
+		dropped.add(held);
+	held = 0;
+	state = HUNT;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "GPSStats.h"
+#include "GPSUBX.h"
+
+typedef void (*NMEAFrameCallback)(const char* frame, size_t length, void* context);
+
+// Cuts a byte stream into NMEA frames, however it arrives.
+//
+// A small state machine: hunting for a frame start, inside a frame, or
+// skipping the rest of a frame that grew too long. '$' and '!' always
+// start a new frame, so the stream resynchronizes on the next sentence
+// after noise, a lost line ending or a cut-off frame; '\r' or '\n' ends
+// one. Frames are handed to the callback from '$' or '!' up to the line
+// ending, without it.
+//
+// UBX frames may be mixed in. The sync byte 0xB5 never occurs in NMEA
+// text, so it also starts a frame; from there the UBX length field rather
+// than a line ending says where the frame ends. A UBX frame is handed over
+// whole, sync through checksum, once its checksum checks out, so frame[0]
+// tells the two apart. A false sync or a bad checksum restarts the hunt on
+// the byte after the sync.
+//
+// A frame that lies within one feed() is handed over in place. Only a
+// frame split across feeds is copied, once, into a fixed buffer; nothing
+// is allocated. Every byte that does not end up in a frame is counted.
+
+class NMEAFramer
+{
+public:
+	// NMEA 0183 allows 82 characters, '$' through "\r\n".
+	static const size_t NMEA_MAX_LENGTH = 82;
+	// Longest limit setMaxLength() takes, for receivers that go over.
+	static const size_t BUFFER_SIZE = 128;
+
+	// Frames longer than this, counting the line ending, are dropped.
+	void setMaxLength(size_t length);
+	size_t maxLength() const { return limit + 2; }
+
+	// Calls frame for every frame completed by these bytes. Returns the
+	// number of frames.
+	size_t feed(const char* data, size_t length, NMEAFrameCallback frame, void* context);
+
+	// Hands over a last frame that never got its line ending, e.g. at the
+	// end of a log.
+	size_t finish(NMEAFrameCallback frame, void* context);
+
+	// Forgets any partial frame, e.g. after the source was reopened.
+	void reset();
+
+	// Between frames, holding nothing: what comes next is framed the same
+	// whatever came before.
+	bool idle() const { return (state == HUNT) && (held == 0); }
+
+	// Running totals, safe to read from any thread.
+	uint64_t frames() const { return frameCount.get(); }
+	uint64_t truncated() const { return truncatedCount.get(); }	//cut off by the next frame start
+	uint64_t overlong() const { return overlongCount.get(); }
+	uint64_t droppedBytes() const { return dropped.get(); }		//not part of any frame handed over
+	uint64_t ubxFrames() const { return ubxCount.get(); }
+	uint64_t ubxChecksumFailures() const { return ubxBadCount.get(); }
+
+private:
+	enum State { HUNT, FRAME, SKIP, UBX };
+
+	const char* ubx(const char* start, const char* end, NMEAFrameCallback frame, void* context, size_t& count);
+	const char* resync(const char* start, NMEAFrameCallback frame, void* context, size_t& count);
+
+	State state = HUNT;
+
+	//frame text, '$' through the last byte before the line ending
+	size_t limit = NMEA_MAX_LENGTH - 2;
+
+	//the start of a frame split across feeds, NMEA or UBX
+	char buffer[UBX_MAX_FRAME];
+	size_t held = 0;
+
+	GPSCounter frameCount;
+	GPSCounter truncatedCount;
+	GPSCounter overlongCount;
+	GPSCounter dropped;
+	GPSCounter ubxCount;
+	GPSCounter ubxBadCount;
+};
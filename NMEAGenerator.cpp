@@ -0,0 +1,333 @@
+#include "NMEAGenerator.h"
+#include "GPSUBX.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+static const double METRES_PER_DEGREE = 111320.0;
+static const double METRES_PER_SECOND_PER_KNOT = 0.514444;
+
+//year, month and day of a day count since 1970-01-01
+static void civilFromDays(int64_t days, int& year, int& month, int& day)
+{
+	days += 719468;
+	int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+	int64_t dayOfEra = days - era * 146097;
+	int64_t yearOfEra = (dayOfEra - dayOfEra/1460 + dayOfEra/36524 - dayOfEra/146096) / 365;
+	int64_t dayOfYear = dayOfEra - (365*yearOfEra + yearOfEra/4 - yearOfEra/100);
+	int64_t mp = (5*dayOfYear + 2) / 153;
+
+	day = (int)(dayOfYear - (153*mp + 2)/5 + 1);
+	month = (int)(mp < 10 ? mp + 3 : mp - 9);
+	year = (int)(yearOfEra + era * 400 + (month <= 2));
+}
+
+//ddmm.mmmmm,N or dddmm.mmmmm,E
+static int formatCoordinate(char* out, size_t size, double degrees, int width, char positive, char negative)
+{
+	char hemisphere = degrees < 0 ? negative : positive;
+	degrees = std::fabs(degrees);
+
+	int whole = (int)degrees;
+	double minutes = (degrees - whole) * 60.0;
+	return snprintf(out, size, "%0*d%08.5f,%c", width, whole, minutes, hemisphere);
+}
+
+static int firstPRN(const char* talker)
+{
+	if(!strcmp(talker, "GL"))
+		return 65;
+	if(!strcmp(talker, "GQ"))
+		return 193;
+	return 1;
+}
+
+NMEAGenerator::NMEAGenerator(const NMEAGeneratorConfig& config) :
+	config(config),
+	state(config.seed ? config.seed : 1),
+	latitude(config.latitude),
+	longitude(config.longitude),
+	millis(config.startMillis)
+{
+	static const char* names[] = {"GGA", "RMC", "GSA", "GSV", "VTG", "GLL", "TXT", "PVT", "SAT"};
+
+	//comma separated lists
+	for(size_t p = 0; p < config.sentences.size(); p += 4)
+	{
+		for(int t = 0; t < (int)(sizeof(names)/sizeof(names[0])); t++)
+			if((config.sentences.compare(p, 3, names[t]) == 0) && (mixCount < 16))
+				mix[mixCount++] = (Type)t;
+	}
+
+	for(size_t p = 0; (p + 1 < config.talkers.size()) && (talkerCount < 8); p += 3)
+	{
+		talkers[talkerCount][0] = config.talkers[p];
+		talkers[talkerCount][1] = config.talkers[p + 1];
+		talkers[talkerCount][2] = 0;
+		talkerCount++;
+	}
+	if(talkerCount == 0)
+	{
+		strcpy(talkers[0], "GP");
+		talkerCount = 1;
+	}
+}
+
+uint32_t NMEAGenerator::random()
+{
+	//xorshift32, the same sequence on every platform
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+void NMEAGenerator::sentence(std::string& out, const char* body, size_t length)
+{
+	sent++;
+
+	unsigned char checksum = 0;
+	for(size_t i = 0; i < length; i++)
+		checksum ^= body[i];
+
+	double roll = uniform();
+	if(roll < config.truncateRate)
+	{
+		//cut short, the next sentence follows straight on
+		out += '$';
+		out.append(body, 1 + random() % length);
+	}
+	else
+	{
+		if(roll < config.truncateRate + config.checksumErrorRate)
+			checksum ^= 1 + random() % 255;
+		else
+			good++;
+
+		char tail[8];
+		snprintf(tail, sizeof(tail), "*%02X\r\n", checksum);
+		out += '$';
+		out.append(body, length);
+		out += tail;
+	}
+
+	noise(out);
+}
+
+void NMEAGenerator::message(std::string& out, uint8_t msgClass, uint8_t msgID, const uint8_t* payload, size_t length)
+{
+	sent++;
+
+	size_t start = out.size();
+	ubxAppendMessage(out, msgClass, msgID, payload, length);
+
+	double roll = uniform();
+	if(roll < config.truncateRate)
+		out.resize(start + 1 + random() % (out.size() - start - 1));
+	else if(roll < config.truncateRate + config.checksumErrorRate)
+		out[out.size() - 1] ^= 1 + random() % 255;
+	else
+		good++;
+
+	noise(out);
+}
+
+void NMEAGenerator::noise(std::string& out)
+{
+	if((config.noiseRate > 0) && (uniform() < config.noiseRate))
+	{
+		int bytes = 1 + random() % 16;
+		for(int i = 0; i < bytes; i++)
+			out += (char)random();
+	}
+}
+
+static void put2(uint8_t* p, int32_t value)
+{
+	p[0] = (uint8_t)value;
+	p[1] = (uint8_t)(value >> 8);
+}
+
+static void put4(uint8_t* p, int32_t value)
+{
+	put2(p, value);
+	put2(p + 2, value >> 16);
+}
+
+void NMEAGenerator::appendUBX(std::string& out, Type type)
+{
+	int firstConstellation = (talkerCount > 1) ? 1 : 0;
+	int satellites = (talkerCount - firstConstellation) * config.satellitesPerTalker;
+
+	if(type == PVT)
+	{
+		uint8_t pvt[92] = {0};
+
+		int64_t seconds = millis / 1000;
+		int year, month, day;
+		civilFromDays(seconds / 86400 - (seconds % 86400 < 0), year, month, day);
+		int64_t ofDay = ((seconds % 86400) + 86400) % 86400;
+
+		put2(pvt + 4, year);
+		pvt[6] = month;
+		pvt[7] = day;
+		pvt[8] = ofDay / 3600;
+		pvt[9] = ofDay / 60 % 60;
+		pvt[10] = ofDay % 60;
+		pvt[11] = 0x07;								//date, time, fully resolved
+		put4(pvt + 16, (int32_t)(millis % 1000) * 1000000);
+		pvt[20] = 3;								//3D
+		pvt[21] = 0x01;								//gnssFixOK
+		pvt[23] = std::min(satellites, 255);
+		put4(pvt + 24, (int32_t)std::lround(longitude * 1e7));
+		put4(pvt + 28, (int32_t)std::lround(latitude * 1e7));
+		put4(pvt + 32, 592300);						//ellipsoid height, mm
+		put4(pvt + 36, 545400);						//above mean sea level, mm
+		put4(pvt + 60, (int32_t)std::lround(config.speedKnots * METRES_PER_SECOND_PER_KNOT * 1000));
+		put4(pvt + 64, (int32_t)std::lround(config.course * 1e5));
+		put2(pvt + 76, 160);
+		message(out, UBX_NAV, UBX_NAV_PVT, pvt, sizeof(pvt));
+		return;
+	}
+
+	//every constellation's satellites in one message, as many as the
+	//framer takes
+	static const int MAX_SATELLITES = (UBX_MAX_PAYLOAD - 8) / 12;
+	static const uint8_t gnssIDs[][3] = {{'G', 'L', 6}, {'G', 'A', 2}, {'G', 'B', 3}, {'G', 'Q', 5}};
+	uint8_t sat[8 + MAX_SATELLITES * 12] = {0};
+	int count = 0;
+	for(int t = firstConstellation; (t < talkerCount) && (count < MAX_SATELLITES); t++)
+	{
+		uint8_t gnssID = 0;
+		for(const uint8_t* id : gnssIDs)
+			if((talkers[t][0] == id[0]) && (talkers[t][1] == id[1]))
+				gnssID = id[2];
+
+		for(int i = 0; (i < config.satellitesPerTalker) && (count < MAX_SATELLITES); i++)
+		{
+			uint8_t* sv = sat + 8 + 12 * count++;
+			sv[0] = gnssID;
+			sv[1] = 1 + i;
+			sv[2] = 30 + random() % 20;
+			sv[3] = 10 + (i*17 + t*5) % 75;
+			put2(sv + 4, (i*47 + t*90) % 360);
+		}
+	}
+	sat[4] = 1;
+	sat[5] = count;
+	message(out, UBX_NAV, UBX_NAV_SAT, sat, 8 + 12 * count);
+}
+
+void NMEAGenerator::appendType(std::string& out, Type type)
+{
+	char body[128];
+	char lat[24];
+	char lon[24];
+	char time[16];
+	char date[8];
+
+	int64_t seconds = millis / 1000;
+	int year, month, day;
+	civilFromDays(seconds / 86400 - (seconds % 86400 < 0), year, month, day);
+	int64_t ofDay = ((seconds % 86400) + 86400) % 86400;
+	snprintf(time, sizeof(time), "%02d%02d%02d.%02d", (int)(ofDay / 3600), (int)(ofDay / 60 % 60), (int)(ofDay % 60), (int)(millis % 1000 / 10));
+	snprintf(date, sizeof(date), "%02d%02d%02d", day, month, year % 100);
+	formatCoordinate(lat, sizeof(lat), latitude, 2, 'N', 'S');
+	formatCoordinate(lon, sizeof(lon), longitude, 3, 'E', 'W');
+
+	//with one talker it reports both the position and the satellites
+	const char* position = talkers[0];
+	int firstConstellation = (talkerCount > 1) ? 1 : 0;
+	int satellites = (talkerCount - firstConstellation) * config.satellitesPerTalker;
+
+	int length = 0;
+	switch(type)
+	{
+	case PVT:
+	case SAT:
+		appendUBX(out, type);
+		return;
+	case GGA:
+		length = snprintf(body, sizeof(body), "%sGGA,%s,%s,%s,1,%02d,0.9,545.4,M,46.9,M,,",
+			position, time, lat, lon, std::min(satellites, 99));
+		break;
+	case RMC:
+		length = snprintf(body, sizeof(body), "%sRMC,%s,A,%s,%s,%05.1f,%05.1f,%s,003.1,W",
+			position, time, lat, lon, config.speedKnots, config.course, date);
+		break;
+	case GLL:
+		length = snprintf(body, sizeof(body), "%sGLL,%s,%s,%s,A,A", position, lat, lon, time);
+		break;
+	case VTG:
+		length = snprintf(body, sizeof(body), "%sVTG,%05.1f,T,,M,%05.1f,N,%05.1f,K",
+			position, config.course, config.speedKnots, config.speedKnots * 1.852);
+		break;
+	case TXT:
+		length = snprintf(body, sizeof(body), "%sTXT,01,01,02,synthetic receiver", position);
+		break;
+	case GSA:
+	{
+		length = snprintf(body, sizeof(body), "%sGSA,A,3", position);
+		int first = firstPRN(talkers[firstConstellation]);
+		for(int i = 0; i < 12; i++)
+		{
+			if(i < config.satellitesPerTalker)
+				length += snprintf(body + length, sizeof(body) - length, ",%02d", first + i);
+			else
+				length += snprintf(body + length, sizeof(body) - length, ",");
+		}
+		length += snprintf(body + length, sizeof(body) - length, ",1.6,0.9,1.3");
+		break;
+	}
+	case GSV:
+		for(int t = firstConstellation; t < talkerCount; t++)
+		{
+			int count = config.satellitesPerTalker;
+			int messages = std::max(1, (count + 3) / 4);
+			for(int m = 0; m < messages; m++)
+			{
+				length = snprintf(body, sizeof(body), "%sGSV,%d,%d,%02d", talkers[t], messages, m + 1, count);
+				for(int i = m*4; (i < count) && (i < m*4 + 4); i++)
+				{
+					int elevation = 10 + (i*17 + t*5) % 75;
+					int azimuth = (i*47 + t*90) % 360;
+					int snr = 30 + random() % 20;
+					length += snprintf(body + length, sizeof(body) - length, ",%02d,%02d,%03d,%02d",
+						firstPRN(talkers[t]) + i, elevation, azimuth, snr);
+				}
+				sentence(out, body, length);
+			}
+		}
+		return;
+	}
+
+	sentence(out, body, length);
+}
+
+int NMEAGenerator::epoch(std::string& out)
+{
+	uint64_t before = sent;
+	for(int i = 0; i < mixCount; i++)
+		appendType(out, mix[i]);
+
+	//move on for the next epoch
+	double interval = 1.0 / std::max(1, config.rateHz);
+	double metres = config.speedKnots * METRES_PER_SECOND_PER_KNOT * interval;
+	double course = config.course * M_PI / 180.0;
+	latitude += metres * std::cos(course) / METRES_PER_DEGREE;
+	longitude += metres * std::sin(course) / (METRES_PER_DEGREE * std::cos(latitude * M_PI / 180.0));
+	millis += 1000 / std::max(1, config.rateHz);
+
+	epochCount++;
+	return (int)(sent - before);
+}
+
+size_t NMEAGenerator::fill(std::string& out, size_t bytes)
+{
+	size_t sentences = 0;
+	while(out.size() < bytes)
+		sentences += epoch(out);
+	return sentences;
+}
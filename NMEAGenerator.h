@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct NMEAGeneratorConfig
+{
+	// Sentences sent each epoch, in this order. GSV is sent as one N of M
+	// group per talker, the rest once for the first talker. PVT and SAT
+	// are the UBX NAV-PVT and NAV-SAT messages, e.g. "PVT,SAT" for a
+	// receiver switched to binary output.
+	std::string sentences = "GGA,RMC,GSA,GSV,VTG";
+
+	// e.g. "GN,GP,GL,GA": the first reports the position, every one after
+	// it a constellation of satellites. A single talker does both.
+	std::string talkers = "GP";
+	int satellitesPerTalker = 8;
+
+	int rateHz = 1;
+
+	// Fraction of sentences sent with a wrong checksum, cut off before
+	// their line ending or checksum, or followed by a burst of random
+	// bytes.
+	double checksumErrorRate = 0;
+	double truncateRate = 0;
+	double noiseRate = 0;
+
+	// The same seed always gives the same bytes.
+	uint32_t seed = 1;
+
+	// Where and when the track starts and how it moves.
+	double latitude = 48.1173;
+	double longitude = 11.5167;
+	double speedKnots = 20;
+	double course = 84.4;
+	int64_t startMillis = 1714521600000;		//2024-05-01T00:00:00Z
+};
+
+// Synthetic receiver output for benchmarks and test harnesses: a vehicle
+// moving in a straight line, reported by a fixed sentence mix with
+// optional corruption.
+
+class NMEAGenerator
+{
+public:
+	NMEAGenerator(const NMEAGeneratorConfig& config = NMEAGeneratorConfig());
+
+	// Appends one epoch of sentences. Returns the sentences appended.
+	int epoch(std::string& out);
+
+	// Appends epochs until out holds at least bytes. Returns the sentences
+	// appended.
+	size_t fill(std::string& out, size_t bytes);
+
+	uint64_t epochs() const { return epochCount; }
+	uint64_t sentences() const { return sent; }
+
+	// Sentences sent whole with a good checksum, what a decoder should pass.
+	uint64_t goodSentences() const { return good; }
+
+private:
+	enum Type { GGA, RMC, GSA, GSV, VTG, GLL, TXT, PVT, SAT };
+
+	void sentence(std::string& out, const char* body, size_t length);
+	void message(std::string& out, uint8_t msgClass, uint8_t msgID, const uint8_t* payload, size_t length);
+	void noise(std::string& out);
+	void appendUBX(std::string& out, Type type);
+	void appendType(std::string& out, Type type);
+	uint32_t random();
+	double uniform() { return random() / 4294967296.0; }
+
+	NMEAGeneratorConfig config;
+
+	Type mix[16];
+	int mixCount = 0;
+	char talkers[8][3];
+	int talkerCount = 0;
+
+	uint32_t state;
+	double latitude;
+	double longitude;
+	int64_t millis;
+
+	uint64_t epochCount = 0;
+	uint64_t sent = 0;
+	uint64_t good = 0;
+};
@@ -0,0 +1,230 @@
+#include "NMEANumeric.h"
+
+#include <iomanip>
+#include <ostream>
+
+static const double pow10Table[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+	1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+};
+
+static const int MAX_DIGITS = 18;
+
+//fraction digits of a coordinate's minutes that are kept, 1e-9 minutes
+//is well under a millimetre and 100 * 10^scale still fits an int64_t
+static const int MAX_COORDINATE_SCALE = 9;
+
+static bool isDigit(char c)
+{
+	return (c >= '0') && (c <= '9');
+}
+
+//Exactly n digits starting at p
+static int digits(const char* p, int n)
+{
+	int value = 0;
+	for(int i = 0; i < n; i++)
+		value = value*10 + (p[i] - '0');
+	return value;
+}
+
+bool nmeaParseInt(std::string_view field, int& value)
+{
+	int64_t mantissa;
+	int scale;
+
+	value = 0;
+	if(!nmeaParseFixed(field, mantissa, scale) || scale != 0 || mantissa > INT32_MAX || mantissa < INT32_MIN)
+		return false;
+
+	value = (int)mantissa;
+	return true;
+}
+
+bool nmeaParseFixed(std::string_view field, int64_t& mantissa, int& scale)
+{
+	const char* p = field.data();
+	const char* end = p + field.length();
+	bool negative = false;
+	bool point = false;
+	int count = 0;
+
+	mantissa = 0;
+	scale = 0;
+
+	if(p != end && (*p == '-' || *p == '+'))
+		negative = (*p++ == '-');
+
+	for(; p != end; p++)
+	{
+		if(isDigit(*p))
+		{
+			//extra fraction digits are dropped, extra integer digits overflow
+			if(count == MAX_DIGITS)
+			{
+				if(point)
+					continue;
+				mantissa = 0;
+				scale = 0;
+				return false;
+			}
+			mantissa = mantissa*10 + (*p - '0');
+			count++;
+			if(point)
+				scale++;
+		}
+		else if(*p == '.' && !point)
+			point = true;
+		else
+		{
+			mantissa = 0;
+			scale = 0;
+			return false;
+		}
+	}
+
+	if(count == 0)
+	{
+		scale = 0;
+		return false;
+	}
+
+	if(negative)
+		mantissa = -mantissa;
+	return true;
+}
+
+bool nmeaParseDecimal(std::string_view field, double& value)
+{
+	int64_t mantissa;
+	int scale;
+
+	value = 0;
+	if(!nmeaParseFixed(field, mantissa, scale))
+		return false;
+
+	value = (double)mantissa / pow10Table[scale];
+	return true;
+}
+
+bool nmeaParseCoordinate(std::string_view field, std::string_view hemisphere, double& degrees)
+{
+	int64_t mantissa;
+	int scale;
+
+	degrees = 0;
+	if(!nmeaParseFixed(field, mantissa, scale) || mantissa < 0)
+		return false;
+
+	//extra fraction digits are dropped
+	for(; scale > MAX_COORDINATE_SCALE; scale--)
+		mantissa /= 10;
+
+	//split ddmm.mmmm in integer space so no precision is lost
+	int64_t perDegree = 100 * (int64_t)pow10Table[scale];
+	int64_t wholeDegrees = mantissa / perDegree;
+	int64_t minutes = mantissa % perDegree;
+
+	if(minutes >= 60 * (int64_t)pow10Table[scale])
+		return false;
+
+	degrees = (double)wholeDegrees + (double)minutes / (60.0 * pow10Table[scale]);
+
+	if(!hemisphere.empty() && (hemisphere[0] == 'S' || hemisphere[0] == 'W'))
+		degrees = -degrees;
+	return true;
+}
+
+bool nmeaParseTime(std::string_view field, NMEATime& time)
+{
+	time = NMEATime();
+
+	if(field.length() < 6)
+		return false;
+	for(int i = 0; i < 6; i++)
+		if(!isDigit(field[i]))
+			return false;
+
+	int millisecond = 0;
+	if(field.length() > 6)
+	{
+		if(field[6] != '.')
+			return false;
+
+		//only the first three fraction digits are significant
+		int scale = 100;
+		for(size_t i = 7; i < field.length(); i++)
+		{
+			if(!isDigit(field[i]))
+				return false;
+			millisecond += (field[i] - '0') * scale;
+			scale /= 10;
+		}
+	}
+
+	int hour = digits(&field[0], 2);
+	int minute = digits(&field[2], 2);
+	int second = digits(&field[4], 2);
+
+	//allow a leap second
+	if(hour > 23 || minute > 59 || second > 60)
+		return false;
+
+	time.hour = hour;
+	time.minute = minute;
+	time.second = second;
+	time.millisecond = millisecond;
+	time.valid = true;
+	return true;
+}
+
+bool nmeaParseDate(std::string_view field, NMEADate& date)
+{
+	date = NMEADate();
+
+	if(field.length() != 6)
+		return false;
+	for(int i = 0; i < 6; i++)
+		if(!isDigit(field[i]))
+			return false;
+
+	int day = digits(&field[0], 2);
+	int month = digits(&field[2], 2);
+	int year = digits(&field[4], 2);
+
+	if(day < 1 || day > 31 || month < 1 || month > 12)
+		return false;
+
+	date.day = day;
+	date.month = month;
+	date.year = (year < 80) ? 2000 + year : 1900 + year;
+	date.valid = true;
+	return true;
+}
+
+std::ostream& operator<<(std::ostream& os, const NMEATime& time)
+{
+	if(!time.valid)
+		return os << "--:--:--";
+
+	char fill = os.fill('0');
+	os << std::setw(2) << time.hour << ":"
+		<< std::setw(2) << time.minute << ":"
+		<< std::setw(2) << time.second << "."
+		<< std::setw(3) << time.millisecond;
+	os.fill(fill);
+	return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const NMEADate& date)
+{
+	if(!date.valid)
+		return os << "----------";
+
+	char fill = os.fill('0');
+	os << std::setw(4) << date.year << "-"
+		<< std::setw(2) << date.month << "-"
+		<< std::setw(2) << date.day;
+	os.fill(fill);
+	return os;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string_view>
+
+// Numeric decoding of NMEA fields straight from the byte span.
+//
+// None of these allocate or depend on the C locale. Integers and decimals
+// are accumulated as integer mantissas and scaled once at the end, so
+// coordinates keep their full ddmm.mmmmm precision in a double.
+//
+// Every parser returns true on success. On failure (empty or malformed
+// field) the output is set to zero / invalid.
+
+// hhmmss.ss - time of fix in UTC
+struct NMEATime
+{
+	int hour = 0;
+	int minute = 0;
+	int second = 0;
+	int millisecond = 0;
+	bool valid = false;
+
+	// milliseconds since 00:00:00 UTC, or -1 when not valid
+	int32_t millisOfDay() const
+	{
+		return valid ? ((hour*60 + minute)*60 + second)*1000 + millisecond : -1;
+	}
+};
+
+// ddmmyy - date of fix in UTC, two digit years below 80 are 20xx
+struct NMEADate
+{
+	int day = 0;
+	int month = 0;
+	int year = 0;
+	bool valid = false;
+};
+
+bool nmeaParseInt(std::string_view field, int& value);
+
+// [-]ddd[.ddd] as mantissa * 10^-scale
+bool nmeaParseFixed(std::string_view field, int64_t& mantissa, int& scale);
+bool nmeaParseDecimal(std::string_view field, double& value);
+
+// ddmm.mmmm or dddmm.mmmm plus N/S/E/W -> signed decimal degrees
+bool nmeaParseCoordinate(std::string_view field, std::string_view hemisphere, double& degrees);
+
+bool nmeaParseTime(std::string_view field, NMEATime& time);
+bool nmeaParseDate(std::string_view field, NMEADate& date);
+
+// Convenience forms that yield 0 for empty or malformed fields.
+inline int nmeaInt(std::string_view field)
+{
+	int value;
+	nmeaParseInt(field, value);
+	return value;
+}
+
+inline double nmeaDecimal(std::string_view field)
+{
+	double value;
+	nmeaParseDecimal(field, value);
+	return value;
+}
+
+std::ostream& operator<<(std::ostream&, const NMEATime&);
+std::ostream& operator<<(std::ostream&, const NMEADate&);
@@ -0,0 +1,189 @@
+#include "NMEAScan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NMEA_SCAN_X86 1
+#endif
+
+//0xB5 is the first UBX sync character, never part of NMEA text
+static const char UBX_START = (char)0xB5;
+
+static inline bool isBoundary(char c)
+{
+	return (c == '$') || (c == '!') || (c == UBX_START) || (c == '\r') || (c == '\n');
+}
+
+static const char* findBoundaryScalar(const char* p, const char* end)
+{
+	for(; p < end; p++)
+		if(isBoundary(*p))
+			return p;
+	return end;
+}
+
+static uint8_t checksumScalar(const char* p, size_t length)
+{
+	uint8_t checksum = 0;
+	for(size_t i = 0; i < length; i++)
+		checksum ^= (uint8_t)p[i];
+	return checksum;
+}
+
+#ifdef NMEA_SCAN_X86
+
+__attribute__((target("sse2")))
+static const char* findBoundarySSE2(const char* p, const char* end)
+{
+	const __m128i dollar = _mm_set1_epi8('$');
+	const __m128i bang = _mm_set1_epi8('!');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i newline = _mm_set1_epi8('\n');
+	const __m128i ubx = _mm_set1_epi8(UBX_START);
+
+	for(; p + 16 <= end; p += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		__m128i start = _mm_or_si128(_mm_cmpeq_epi8(v, dollar), _mm_cmpeq_epi8(v, bang));
+		start = _mm_or_si128(start, _mm_cmpeq_epi8(v, ubx));
+		__m128i ending = _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, newline));
+		int mask = _mm_movemask_epi8(_mm_or_si128(start, ending));
+		if(mask)
+			return p + __builtin_ctz(mask);
+	}
+	return findBoundaryScalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static uint8_t checksumSSE2(const char* p, size_t length)
+{
+	__m128i acc = _mm_setzero_si128();
+	size_t i = 0;
+
+	for(; i + 16 <= length; i += 16)
+		acc = _mm_xor_si128(acc, _mm_loadu_si128((const __m128i*)(p + i)));
+
+	//fold the 16 lanes into one byte
+	acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 8));
+	acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 4));
+	acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 2));
+	acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 1));
+
+	return (uint8_t)_mm_cvtsi128_si32(acc) ^ checksumScalar(p + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static const char* findBoundaryAVX2(const char* p, const char* end)
+{
+	const __m256i dollar = _mm256_set1_epi8('$');
+	const __m256i bang = _mm256_set1_epi8('!');
+	const __m256i cr = _mm256_set1_epi8('\r');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	const __m256i ubx = _mm256_set1_epi8(UBX_START);
+
+	for(; p + 32 <= end; p += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)p);
+		__m256i start = _mm256_or_si256(_mm256_cmpeq_epi8(v, dollar), _mm256_cmpeq_epi8(v, bang));
+		start = _mm256_or_si256(start, _mm256_cmpeq_epi8(v, ubx));
+		__m256i ending = _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, newline));
+		unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(start, ending));
+		if(mask)
+			return p + __builtin_ctz(mask);
+	}
+
+	//finish here rather than in the SSE2 version to avoid mixing encodings
+	for(; p < end; p++)
+		if(isBoundary(*p))
+			return p;
+	return end;
+}
+
+__attribute__((target("avx2")))
+static uint8_t checksumAVX2(const char* p, size_t length)
+{
+	__m256i acc = _mm256_setzero_si256();
+	size_t i = 0;
+
+	for(; i + 32 <= length; i += 32)
+		acc = _mm256_xor_si256(acc, _mm256_loadu_si256((const __m256i*)(p + i)));
+
+	__m128i half = _mm_xor_si128(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+	if(i + 16 <= length)
+	{
+		half = _mm_xor_si128(half, _mm_loadu_si128((const __m128i*)(p + i)));
+		i += 16;
+	}
+	half = _mm_xor_si128(half, _mm_srli_si128(half, 8));
+	half = _mm_xor_si128(half, _mm_srli_si128(half, 4));
+	half = _mm_xor_si128(half, _mm_srli_si128(half, 2));
+	half = _mm_xor_si128(half, _mm_srli_si128(half, 1));
+
+	uint8_t checksum = (uint8_t)_mm_cvtsi128_si32(half);
+	for(; i < length; i++)
+		checksum ^= (uint8_t)p[i];
+	return checksum;
+}
+
+#endif
+
+static const NMEAScanner scanners[] = {
+	{"scalar", findBoundaryScalar, checksumScalar},
+#ifdef NMEA_SCAN_X86
+	{"sse2", findBoundarySSE2, checksumSSE2},
+	{"avx2", findBoundaryAVX2, checksumAVX2},
+#endif
+};
+
+static int supportedScanners()
+{
+#ifdef NMEA_SCAN_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		return 3;
+	if(__builtin_cpu_supports("sse2"))
+		return 2;
+#endif
+	return 1;
+}
+
+const NMEAScanner* nmeaScanners(int& count)
+{
+	static const int supported = supportedScanners();
+	count = supported;
+	return scanners;
+}
+
+const NMEAScanner& nmeaScanner()
+{
+	static const NMEAScanner& best = scanners[supportedScanners() - 1];
+	return best;
+}
+
+struct HexTable
+{
+	int8_t value[256];
+
+	constexpr HexTable() : value()
+	{
+		for(int i = 0; i < 256; i++)
+			value[i] = -1;
+		for(int i = 0; i < 10; i++)
+			value['0' + i] = i;
+		for(int i = 0; i < 6; i++)
+		{
+			value['A' + i] = 10 + i;
+			value['a' + i] = 10 + i;
+		}
+	}
+};
+
+static constexpr HexTable hexTable;
+
+int nmeaHexByte(char high, char low)
+{
+	int h = hexTable.value[(uint8_t)high];
+	int l = hexTable.value[(uint8_t)low];
+
+	//either being -1 makes the or negative
+	return ((h | l) < 0) ? -1 : (h << 4) | l;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Vectorized helpers for finding NMEA frames and checking their checksums.
+//
+// Each helper has a scalar, an SSE2 and an AVX2 version. The fastest one
+// the CPU supports is picked once at start up; the others stay reachable
+// through nmeaScanners() so they can be benchmarked against each other.
+
+struct NMEAScanner
+{
+	const char* name;
+
+	// First frame start ('$', '!' or the UBX sync byte 0xB5) or line
+	// ending ('\r' or '\n') in [p, end), or end when there is none.
+	const char* (*findBoundary)(const char* p, const char* end);
+
+	// XOR of every byte in [p, p+length).
+	uint8_t (*checksum)(const char* p, size_t length);
+};
+
+// The scanner in use on this CPU.
+const NMEAScanner& nmeaScanner();
+
+// Every scanner this CPU can run, scalar first.
+const NMEAScanner* nmeaScanners(int& count);
+
+inline const char* nmeaFindBoundary(const char* p, const char* end)
+{
+	return nmeaScanner().findBoundary(p, end);
+}
+
+inline uint8_t nmeaChecksum(const char* p, size_t length)
+{
+	return nmeaScanner().checksum(p, length);
+}
+
+// Two hex digits to a byte through a lookup table, -1 when either is not
+// a hex digit.
+int nmeaHexByte(char high, char low);
@@ -0,0 +1,435 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+
+#include "GPSBulkDecoder.h"
+#include "GPSDecoder.h"
+#include "GPSFilter.h"
+#include "GPSGeodesy.h"
+#include "GPSKMLWriter.h"
+#include "NMEAGenerator.h"
+
+// Throughput of the parse and output paths over synthetic receiver output,
+// in sentences and bytes per second and heap allocations per sentence.
+//
+//  bench [--benchmark_filter=regex] [--benchmark_format=json] ...
+
+//every allocation in the process goes through here, in each of its forms,
+//out of line so the compiler never sees free() meet a new expression
+static std::atomic<uint64_t> allocations{0};
+
+__attribute__((noinline)) static void* allocate(size_t size, size_t alignment = 0) noexcept
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if(size == 0)
+		size = 1;
+	if(alignment <= alignof(std::max_align_t))
+		return malloc(size);
+	return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+__attribute__((noinline)) static void release(void* p) noexcept
+{
+	free(p);
+}
+
+static void* allocateOrThrow(size_t size, size_t alignment = 0)
+{
+	if(void* p = allocate(size, alignment))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size) { return allocateOrThrow(size); }
+void* operator new[](size_t size) { return allocateOrThrow(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return allocateOrThrow(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocateOrThrow(size, (size_t)alignment); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate(size, (size_t)alignment); }
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { release(p); }
+
+static const size_t LOG_BYTES = 8 << 20;
+
+// A multi-constellation receiver sending every sentence type the decoder
+// reads, errorsPerMille of them damaged one way or another, or the same
+// receiver switched to UBX NAV-PVT and NAV-SAT.
+static const std::string& syntheticLog(int errorsPerMille = 0, bool ubx = false)
+{
+	static std::string logs[2][1001];
+	std::string& log = logs[ubx][errorsPerMille];
+
+	if(log.empty())
+	{
+		NMEAGeneratorConfig config;
+		config.sentences = ubx ? "PVT,SAT" : "GGA,RMC,GSA,GSV,VTG,GLL,TXT";
+		config.talkers = "GN,GP,GL,GA";
+		config.checksumErrorRate = errorsPerMille / 3000.0;
+		config.truncateRate = errorsPerMille / 3000.0;
+		config.noiseRate = errorsPerMille / 3000.0;
+
+		NMEAGenerator generator(config);
+		log.reserve(LOG_BYTES + 1024);
+		generator.fill(log, LOG_BYTES);
+	}
+	return log;
+}
+
+struct Frame
+{
+	const char* data;
+	size_t length;
+};
+
+// Every frame of the clean log without its line ending, optionally only
+// those of one sentence type.
+static std::vector<Frame> syntheticFrames(const char* type = nullptr)
+{
+	const std::string& log = syntheticLog();
+	std::vector<Frame> frames;
+
+	const char* p = log.data();
+	const char* end = p + log.size();
+	while(p < end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		if(!newline)
+			break;
+		if(!type || !memcmp(p + 3, type, 3))
+			frames.push_back(Frame{p, (size_t)(newline - 1 - p)});
+		p = newline + 1;
+	}
+	return frames;
+}
+
+class AllocationCounter
+{
+public:
+	AllocationCounter() : start(allocations.load(std::memory_order_relaxed)) {}
+
+	void report(benchmark::State& state, uint64_t sentences, uint64_t bytes)
+	{
+		uint64_t allocated = allocations.load(std::memory_order_relaxed) - start;
+		state.SetItemsProcessed(sentences);
+		if(bytes > 0)
+			state.SetBytesProcessed(bytes);
+		state.counters["allocs/sentence"] = sentences ? (double)allocated / sentences : 0;
+	}
+
+private:
+	uint64_t start;
+};
+
+static void BM_SentenceCheck(benchmark::State& state)
+{
+	std::vector<Frame> frames = syntheticFrames();
+	GPSDecoder decoder("");
+	uint64_t sentences = 0;
+	uint64_t bytes = 0;
+
+	AllocationCounter counter;
+	for(auto _ : state)
+	{
+		for(const Frame& frame : frames)
+			benchmark::DoNotOptimize(decoder.GPSSentenceCheck(frame.data, frame.length));
+		sentences += frames.size();
+	}
+	for(const Frame& frame : frames)
+		bytes += frame.length;
+	counter.report(state, sentences, bytes * state.iterations());
+}
+BENCHMARK(BM_SentenceCheck)->Unit(benchmark::kMillisecond);
+
+static void BM_CrunchSentence(benchmark::State& state)
+{
+	std::vector<Frame> frames = syntheticFrames();
+	GPSDecoder decoder("");
+	uint64_t sentences = 0;
+	uint64_t bytes = 0;
+
+	AllocationCounter counter;
+	for(auto _ : state)
+	{
+		for(const Frame& frame : frames)
+			decoder.crunchGPSSentence(frame.data, frame.length);
+		sentences += frames.size();
+	}
+	for(const Frame& frame : frames)
+		bytes += frame.length;
+	counter.report(state, sentences, bytes * state.iterations());
+}
+BENCHMARK(BM_CrunchSentence)->Unit(benchmark::kMillisecond);
+
+template<auto Read>
+static void readData(GPSDecoder& decoder, const NMEAFields& fields)
+{
+	(decoder.*Read)(fields);
+}
+
+// One read*Data over pre-split sentences of its type.
+static void BM_ReadData(benchmark::State& state, void (*read)(GPSDecoder&, const NMEAFields&), const char* type)
+{
+	std::vector<Frame> frames = syntheticFrames(type);
+	std::vector<NMEAFields> split(frames.size());
+	uint64_t bytes = 0;
+	for(size_t i = 0; i < frames.size(); i++)
+	{
+		split[i].split(frames[i].data, frames[i].length);
+		bytes += frames[i].length;
+	}
+
+	GPSDecoder decoder("");
+	uint64_t sentences = 0;
+
+	AllocationCounter counter;
+	for(auto _ : state)
+	{
+		for(const NMEAFields& fields : split)
+			read(decoder, fields);
+		sentences += split.size();
+	}
+	counter.report(state, sentences, bytes * state.iterations());
+}
+BENCHMARK_CAPTURE(BM_ReadData, GGA, readData<&GPSDecoder::readGGAData>, "GGA");
+BENCHMARK_CAPTURE(BM_ReadData, RMC, readData<&GPSDecoder::readRMCData>, "RMC");
+BENCHMARK_CAPTURE(BM_ReadData, GSA, readData<&GPSDecoder::readGSAData>, "GSA");
+BENCHMARK_CAPTURE(BM_ReadData, GSV, readData<&GPSDecoder::readGSVData>, "GSV");
+BENCHMARK_CAPTURE(BM_ReadData, VTG, readData<&GPSDecoder::readVTGData>, "VTG");
+BENCHMARK_CAPTURE(BM_ReadData, GLL, readData<&GPSDecoder::readGLLData>, "GLL");
+BENCHMARK_CAPTURE(BM_ReadData, TXT, readData<&GPSDecoder::readTXTData>, "TXT");
+
+// Formatting points into the KML writer; its own thread writes them out.
+static void BM_KMLWriter(benchmark::State& state)
+{
+	GPSKMLConfig config;
+	config.path = "/tmp/benchKML.kml";
+
+	GPSKMLWriter writer;
+	if(!writer.open(config))
+	{
+		state.SkipWithError("cannot open /tmp/benchKML.kml");
+		return;
+	}
+
+	GPSFix fix;
+	fix.latitude = 48.1173;
+	fix.longitude = 11.5167;
+	fix.quality = 1;
+	uint64_t points = 0;
+
+	AllocationCounter counter;
+	for(auto _ : state)
+	{
+		fix.latitude += 1e-6;
+		fix.longitude += 1e-6;
+		writer.add(fix);
+		points++;
+	}
+	counter.report(state, points, 0);
+
+	writer.close();
+	unlink(config.path.c_str());
+}
+BENCHMARK(BM_KMLWriter);
+
+// Distance, speed, heading and ENU for every fix, as the decoder does.
+static void BM_MotionTracker(benchmark::State& state)
+{
+	std::vector<GPSFix> fixes(4096);
+	for(size_t i = 0; i < fixes.size(); i++)
+	{
+		fixes[i].latitude = 48.1173 + i * 1e-5;
+		fixes[i].longitude = 11.5167 + i * 1e-5;
+		fixes[i].quality = 1;
+		fixes[i].sentences = FIX_GGA;
+		fixes[i].time.valid = true;
+		fixes[i].time.millisecond = i % 1000;
+		fixes[i].time.second = i / 1000;
+	}
+
+	GPSMotionTracker tracker;
+	uint64_t points = 0;
+
+	AllocationCounter counter;
+	for(auto _ : state)
+	{
+		for(const GPSFix& fix : fixes)
+			benchmark::DoNotOptimize(tracker.add(fix).distance);
+		points += fixes.size();
+	}
+	counter.report(state, points, 0);
+}
+BENCHMARK(BM_MotionTracker);
+
+// Gating and Kalman smoothing of a 25 Hz track with a multipath jump
+// every 97 fixes.
+static void BM_FixFilter(benchmark::State& state)
+{
+	std::vector<GPSFix> fixes(4096);
+	for(size_t i = 0; i < fixes.size(); i++)
+	{
+		int millis = i * 40;
+		fixes[i].latitude = 48.1173 + i * 1e-6 + ((i % 97 == 0) ? 1e-3 : 0);
+		fixes[i].longitude = 11.5167 + i * 1e-6;
+		fixes[i].quality = 1;
+		fixes[i].HDOP = 1.2f;
+		fixes[i].satellitesUsed = 9;
+		fixes[i].sentences = FIX_GGA;
+		fixes[i].time.valid = true;
+		fixes[i].time.millisecond = millis % 1000;
+		fixes[i].time.second = (millis / 1000) % 60;
+		fixes[i].time.minute = millis / 60000;
+	}
+
+	GPSFilterConfig config;
+	config.maxHDOP = 5;
+	config.minSatellites = 4;
+	config.maxSpeed = 70;
+	config.smooth = true;
+	config.innovationGate = 13.8;
+
+	GPSFixFilter filter;
+	filter.setConfig(config);
+	GPSFix out;
+	uint64_t points = 0;
+
+	AllocationCounter counter;
+	for(auto _ : state)
+	{
+		for(const GPSFix& fix : fixes)
+			benchmark::DoNotOptimize(filter.add(fix, out));
+		points += fixes.size();
+	}
+	counter.report(state, points, 0);
+	state.counters["rejected"] = filter.rejected();
+}
+BENCHMARK(BM_FixFilter);
+
+// A recorded track to ENU in bulk.
+static void BM_LocalFrameBatch(benchmark::State& state)
+{
+	std::vector<GPSTrackPoint> points(1 << 16);
+	for(size_t i = 0; i < points.size(); i++)
+	{
+		points[i].latitude = 481173000 + i * 100;
+		points[i].longitude = 115167000 + i * 100;
+		points[i].altitude = 545400;
+	}
+	std::vector<GPSENU> out(points.size());
+
+	GPSLocalFrame frame(48.1173, 11.5167, 545.4);
+	uint64_t converted = 0;
+
+	AllocationCounter counter;
+	for(auto _ : state)
+	{
+		frame.toENU(points.data(), points.size(), out.data());
+		benchmark::DoNotOptimize(out.data());
+		converted += points.size();
+	}
+	counter.report(state, converted, 0);
+}
+BENCHMARK(BM_LocalFrameBatch)->Unit(benchmark::kMillisecond);
+
+// The whole path from bytes to published fixes, as decode() sees it from
+// the event loop: reads of range(0) bytes, range(1) per mille damaged,
+// UBX instead of NMEA when range(2) is 1.
+static void BM_Decode(benchmark::State& state)
+{
+	const std::string& log = syntheticLog(state.range(1), state.range(2));
+	size_t chunk = state.range(0);
+
+	GPSDecoder decoder("");
+	uint64_t sentences = 0;
+
+	AllocationCounter counter;
+	for(auto _ : state)
+	{
+		for(size_t offset = 0; offset < log.size(); offset += chunk)
+			sentences += decoder.decode(log.data() + offset, std::min(chunk, log.size() - offset));
+		sentences += decoder.flush();
+	}
+	counter.report(state, sentences, log.size() * state.iterations());
+}
+BENCHMARK(BM_Decode)
+	->Args({64, 0, 0})
+	->Args({4096, 0, 0})
+	->Args({(int64_t)LOG_BYTES, 0, 0})
+	->Args({4096, 10, 0})
+	->Args({4096, 0, 1})
+	->Args({4096, 10, 1})
+	->Unit(benchmark::kMillisecond);
+
+// The synthetic log as a file, for what reads logs from disk. Removed at
+// exit.
+static const std::string& syntheticLogFile()
+{
+	static std::string path;
+	if(path.empty())
+	{
+		char name[] = "/tmp/benchLogXXXXXX";
+		int fd = mkstemp(name);
+		const std::string& log = syntheticLog();
+		if((fd < 0) || (write(fd, log.data(), log.size()) != (ssize_t)log.size()))
+			return path;
+		close(fd);
+		path = name;
+		atexit([]() { unlink(path.c_str()); });
+	}
+	return path;
+}
+
+static void countFix(const GPSFix&, void* count)
+{
+	(*static_cast<uint64_t*>(count))++;
+}
+
+// Offline decoding of the log in 1 MB chunks on range(0) threads, the
+// fixes merged back in order on this one.
+static void BM_BulkDecode(benchmark::State& state)
+{
+	const std::string& path = syntheticLogFile();
+	if(path.empty())
+	{
+		state.SkipWithError("cannot write the log");
+		return;
+	}
+
+	GPSBulkConfig config;
+	config.threads = state.range(0);
+	config.chunkBytes = 1 << 20;
+	GPSBulkDecoder decoder;
+	decoder.setConfig(config);
+	decoder.add(path);
+
+	uint64_t fixes = 0;
+	for(auto _ : state)
+		decoder.run(countFix, &fixes);
+	state.SetItemsProcessed(fixes);
+	state.SetBytesProcessed(LOG_BYTES * state.iterations());
+	state.counters["resyncs"] = decoder.resyncs();
+}
+BENCHMARK(BM_BulkDecode)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,171 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "GPSDecoder.h"
+#include "NMEAScan.h"
+
+// Compares frame scanning and checksum validation over a large synthetic
+// log: the original byte at a time GPSSentenceCheck on one std::string per
+// sentence, the current GPSSentenceCheck, and each vectorized scanner.
+//
+//  benchChecksum [megabytes]
+
+static const char* templates[] = {
+	"GPGGA,123519.00,4807.03812,N,01131.00023,E,1,08,0.9,545.4,M,46.9,M,,",
+	"GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1",
+	"GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45",
+	"GPRMC,123519.00,A,4807.03812,N,01131.00023,E,022.4,084.4,230394,003.1,W",
+	"GPVTG,054.7,T,034.4,M,005.5,N,010.2,K",
+	"GPGLL,4916.45000,N,12311.12000,W,225444.00,A,A",
+};
+
+static std::string makeLog(size_t bytes)
+{
+	std::string log;
+	log.reserve(bytes + 128);
+
+	for(int i = 0; log.size() < bytes; i++)
+	{
+		const char* body = templates[i % (sizeof(templates)/sizeof(templates[0]))];
+		unsigned char checksum = 0;
+		for(const char* c = body; *c; c++)
+			checksum ^= *c;
+
+		char tail[8];
+		snprintf(tail, sizeof(tail), "*%02X\r\n", checksum);
+		log += '$';
+		log += body;
+		log += tail;
+	}
+	return log;
+}
+
+int static legacyHex2int(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+// GPSSentenceCheck as it was before the scanners, one std::string per call
+static int legacySentenceCheck(std::string sent)
+{
+	if(sent[0] != '$')
+		return 1;
+	if((sent.length() > 83)||(sent.length() < 6))
+		return 1;
+
+	char checksum = 0;
+	auto it=sent.begin();
+	it++;
+	for(;(*it!='*')&&(*it!=' ')&&(*it!=0);++it)
+		checksum ^= *it;
+	it++;
+
+	unsigned int cs = (16*legacyHex2int(*it));
+	it++;
+	cs += legacyHex2int(*it);
+
+	return ((unsigned int)checksum != cs);
+}
+
+static size_t runLegacy(const std::string& log)
+{
+	size_t passed = 0;
+	size_t pos = 0;
+	while(pos < log.size())
+	{
+		size_t newline = log.find('\n', pos);
+		if(newline == std::string::npos)
+			break;
+		//the serial stream hands over one token without the line ending
+		passed += !legacySentenceCheck(log.substr(pos, newline - 1 - pos));
+		pos = newline + 1;
+	}
+	return passed;
+}
+
+static size_t runSentenceCheck(GPSDecoder& decoder, const std::string& log)
+{
+	const char* p = log.data();
+	const char* end = p + log.size();
+	size_t passed = 0;
+
+	while(p < end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		if(!newline)
+			break;
+		passed += !decoder.GPSSentenceCheck(p, newline - 1 - p);
+		p = newline + 1;
+	}
+	return passed;
+}
+
+static size_t runScanner(const NMEAScanner& scanner, const std::string& log)
+{
+	const char* p = log.data();
+	const char* end = p + log.size();
+	size_t passed = 0;
+
+	while(p < end)
+	{
+		const char* start = scanner.findBoundary(p, end);
+		if(start == end)
+			break;
+		if(*start != '$')
+		{
+			p = start + 1;
+			continue;
+		}
+
+		const char* newline = scanner.findBoundary(start + 1, end);
+		if(newline == end)
+			break;
+
+		//"*hh" ends every frame, the scan stops at its '\r'
+		const char* star = newline - 3;
+		int cs = nmeaHexByte(star[1], star[2]);
+		passed += (*star == '*') && (cs == scanner.checksum(start + 1, star - start - 1));
+		p = newline + 1;
+	}
+	return passed;
+}
+
+template<typename F>
+static void report(const char* name, const std::string& log, F run)
+{
+	auto begin = std::chrono::steady_clock::now();
+	size_t passed = run();
+	auto end = std::chrono::steady_clock::now();
+
+	double seconds = std::chrono::duration<double>(end - begin).count();
+	printf("%-20s %10zu frames %8.3f s %8.3f GB/s\n", name, passed, seconds, log.size() / seconds / 1e9);
+}
+
+int main(int argc, char** argv)
+{
+	size_t megabytes = (argc > 1) ? atoi(argv[1]) : 256;
+	std::string log = makeLog(megabytes << 20);
+	GPSDecoder decoder("");
+
+	printf("%zu MB synthetic log, using %s\n", megabytes, nmeaScanner().name);
+
+	report("legacy", log, [&]{ return runLegacy(log); });
+	report("GPSSentenceCheck", log, [&]{ return runSentenceCheck(decoder, log); });
+
+	int count;
+	const NMEAScanner* scanners = nmeaScanners(count);
+	for(int i = 0; i < count; i++)
+		report(scanners[i].name, log, [&]{ return runScanner(scanners[i], log); });
+
+	return 0;
+}
@@ -1,57 +1,230 @@
-
-
-#include <iostream>
-#include <fstream>
-#include <cstring>
-#include <cstdio>
-
-#include "GPSDecoder.h"
-#include <unistd.h>
-#include <SerialPort.h>
-#include <SerialStream.h>
-
-#include <thread>
-using namespace LibSerial;
-
-int main(int argc, char** argv )
-{
-
-  std::cout << "PROG START" << std::endl;
-  std::string paramInput = "/dev/ttyACM0";
-
-  GPSDecoder GPSWorker(paramInput);
-
-  if(!GPSWorker.initDecoder())
-  {
-    std::cout << "Failed to initialize GPSWorker. Closing" << std::endl;
-
-    return 0;
-  }
-
-  std::thread GPSThread(&GPSDecoder::run, std::ref(GPSWorker));
-
-  for(int i=0; i<200;i++)
-  {
-    std::system("clear");
-    std::cout << "Search and Rescue Menu V0.1" << std::endl;
-    GPSWorker.printGGA();
-    GPSWorker.printGSA();
-    GPSWorker.printGSV();
-    GPSWorker.printRMC();
-    GPSWorker.printTXT();
-    GPSWorker.printVTG();
-    usleep(100000);
-  }
-
-  GPSWorker.runGPSWorker = 0;
-
-  while(!GPSThread.joinable())
-  {
-    std::cout << "Trying to join thread. Joinable: " << GPSThread.joinable() << std::endl;
-  }
-
-	GPSThread.join();
-
-  std::cout << "PROG END" << std::endl;
-	return 0;
-}
+
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#include "GPSDashboard.h"
+#include "GPSDecoder.h"
+#include "GPSEngine.h"
+#include "GPSLogReplay.h"
+#include "GPSStats.h"
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <thread>
+
+// --stats path writes the decoder statistics there every 10 seconds, as
+// Prometheus text for .prom, JSON for .json and plain text otherwise.
+static const std::chrono::seconds STATS_INTERVAL{10};
+
+static int startStats(GPSStatsDumper& dumper, const std::string& path)
+{
+  if(path.empty())
+    return 1;
+
+  GPSStatsFormat format = STATS_TEXT;
+  if((path.size() > 5) && (path.compare(path.size() - 5, 5, ".prom") == 0))
+    format = STATS_PROMETHEUS;
+  else if((path.size() > 5) && (path.compare(path.size() - 5, 5, ".json") == 0))
+    format = STATS_JSON;
+
+  if(dumper.start(path, format, STATS_INTERVAL))
+    return 1;
+
+  std::cout << "Failed to write statistics to " << path << std::endl;
+  return 0;
+}
+
+// Several sources at once: decode them all on a worker pool and show one
+// line per receiver plus the combined throughput.
+static int runEngine(int argc, char** argv, const std::string& statsPath)
+{
+  GPSEngine engine;
+  GPSStatsDumper stats;
+
+  for(int i = 1; i < argc; i++)
+  {
+    GPSSourceConfig config;
+    if(!parseSourceSpec(argv[i], config) || (engine.addSource(config) < 0))
+    {
+      std::cout << "Failed to open " << argv[i] << ". Closing" << std::endl;
+      return 0;
+    }
+    std::cout << "Reading " << engine.source(i-1).name() << std::endl;
+    stats.add(engine.decoder(i-1), engine.source(i-1).name());
+  }
+
+  if(!startStats(stats, statsPath))
+    return 0;
+
+  engine.start();
+
+  {
+    GPSTerminalFrame frame;
+
+    for(int i=0; i<200 && engine.running();i++)
+    {
+      frame.begin();
+      frame.print(0, 0, "Search and Rescue Menu V0.1");
+
+      GPSEngineThroughput total = engine.throughput();
+      frame.printf(1, 0, "%d sources on %d workers, %.0f sentences/s, %.2f MB/s",
+        engine.sourceCount(), engine.workerCount(),
+        total.sentencesPerSecond(), total.bytesPerSecond() / 1e6);
+
+      for(int id = 0; id < engine.sourceCount(); id++)
+      {
+        GPSFix fix = engine.decoder(id).snapshot().fix;
+        frame.print(3 + id, 0, engine.source(id).name());
+        frame.printf(3 + id, 24, "%02d:%02d:%02d  %12.7f %12.7f  fix %d",
+          fix.time.hour, fix.time.minute, fix.time.second,
+          fix.latitude, fix.longitude, fix.quality);
+      }
+      frame.present();
+      usleep(100000);
+    }
+  }
+
+  engine.stop();
+  stats.stop();
+
+  std::cout << "PROG END" << std::endl;
+  return 0;
+}
+
+int main(int argc, char** argv )
+{
+
+  std::cout << "PROG START" << std::endl;
+
+  // testGPSDecoder [--stats path] [--append] [--ubx hz] [source | NMEA log file] [--paced]
+  // testGPSDecoder [--stats path] source source...
+  //   several sources are only shown and counted, they write no KML and
+  //   take neither --append nor --ubx
+  //   source is /dev/ttyACM0@38400, -, fifo:path, pty or udp:port
+  std::string statsPath;
+  if((argc > 2) && !strcmp(argv[1], "--stats"))
+  {
+    statsPath = argv[2];
+    argv[2] = argv[0];
+    argv += 2;
+    argc -= 2;
+  }
+
+  // --append continues the KML track of an earlier run instead of
+  // starting a new one
+  GPSKMLConfig KMLConfig;
+  if((argc > 1) && !strcmp(argv[1], "--append"))
+  {
+    KMLConfig.append = true;
+    argv[1] = argv[0];
+    argv++;
+    argc--;
+  }
+
+  // --ubx switches a u-blox receiver to UBX NAV-PVT and NAV-SAT at that rate
+  int UBXRate = 0;
+  if((argc > 2) && !strcmp(argv[1], "--ubx"))
+  {
+    UBXRate = atoi(argv[2]);
+    argv[2] = argv[0];
+    argv += 2;
+    argc -= 2;
+  }
+
+  if((argc > 2) && strcmp(argv[2], "--paced"))
+  {
+    if(KMLConfig.append || (UBXRate != 0))
+    {
+      std::cout << "--append and --ubx take a single source. Closing" << std::endl;
+      return 0;
+    }
+    return runEngine(argc, argv, statsPath);
+  }
+
+  std::string paramInput = (argc > 1) ? argv[1] : "/dev/ttyACM0";
+  bool paced = (argc > 2) && !strcmp(argv[2], "--paced");
+
+  struct stat inputStat;
+  bool replay = (stat(paramInput.c_str(), &inputStat) == 0) && S_ISREG(inputStat.st_mode);
+
+  GPSDecoder GPSWorker(paramInput);
+  GPSWorker.setKMLOutput(KMLConfig);
+  GPSLogReplay GPSReplay(GPSWorker);
+
+  if(replay)
+  {
+    if(!GPSWorker.initFiles() || !GPSReplay.open(paramInput))
+    {
+      std::cout << "Failed to open log " << paramInput << ". Closing" << std::endl;
+
+      return 0;
+    }
+  }
+  else if(!GPSWorker.initDecoder())
+  {
+    std::cout << "Failed to initialize GPSWorker. Closing" << std::endl;
+
+    return 0;
+  }
+  else
+    std::cout << "Reading " << GPSWorker.inputSource()->name() << std::endl;
+
+  if(!replay && (UBXRate != 0))
+  {
+    GPSUBXConfig UBXConfig;
+    UBXConfig.rateHz = UBXRate;
+    if(!GPSWorker.configureUBX(UBXConfig))
+      std::cout << "Failed to configure " << GPSWorker.inputSource()->name() << " for UBX" << std::endl;
+  }
+
+  GPSStatsDumper stats;
+  stats.add(GPSWorker, paramInput);
+  if(!startStats(stats, statsPath))
+    return 0;
+
+  std::thread GPSThread;
+  if(replay)
+    GPSThread = std::thread(&GPSLogReplay::run, std::ref(GPSReplay), paced);
+  else
+    GPSThread = std::thread(&GPSDecoder::run, std::ref(GPSWorker));
+
+  {
+    GPSDashboard dashboard(GPSWorker, 10);
+
+    for(int i=0; i<200 && !GPSReplay.finished();i++)
+    {
+      dashboard.draw();
+      std::this_thread::sleep_for(dashboard.period());
+    }
+  }
+
+  GPSWorker.stop();
+  GPSReplay.stop();
+
+  while(!GPSThread.joinable())
+  {
+    std::cout << "Trying to join thread. Joinable: " << GPSThread.joinable() << std::endl;
+  }
+
+	GPSThread.join();
+  stats.stop();
+
+  if(replay)
+  {
+    std::cout << "Replayed " << GPSReplay.size() << " bytes" << std::endl;
+    GPSWorker.printGGA();
+    GPSWorker.printRMC();
+
+    std::vector<GPSLabelledStats> totals(1);
+    totals[0].label = paramInput;
+    GPSWorker.readStats(totals[0].stats);
+    std::cout << gpsFormatStats(totals, STATS_TEXT);
+  }
+
+  std::cout << "PROG END" << std::endl;
+	return 0;
+}
@@ -0,0 +1,560 @@
+// Drives GPSDecoder::run() through a pseudo-terminal standing in for the
+// receiver's serial port, so the whole read path can be exercised without
+// hardware.
+//
+//   ptyHarness [log.nmea] [--epochs n] [--rate hz] [--baud bps] [--burst]
+//              [--flip p] [--truncate p] [--drop p] [--garbage p] [--seed n]
+//   ptyHarness --fuzz [iterations] [--seed n]
+//
+// Without a log, --epochs of synthetic multi-constellation output are sent.
+// --baud paces the bytes as a serial line would, bps/10 bytes a second, and
+// 0 sends them as fast as the pty takes them. --burst sends each epoch at
+// the start of its 1/--rate slot and then goes quiet, like a receiver.
+//
+// --flip and --drop act on every byte, --truncate cuts sentences short and
+// --garbage puts random bytes between sentences, each with probability p.
+// Reports throughput, the latency from writing an epoch's last byte to its
+// fix, and how many of the undamaged sentences the decoder got back.
+//
+// --fuzz skips the pty and feeds heavily mutated input straight to
+// decode(), crunchGPSSentence() and GPSSentenceCheck(); build with
+// -fsanitize=address,undefined to make it worthwhile. Built with Clang,
+// fuzzDecode does this under libFuzzer's coverage guidance.
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "GPSDecoder.h"
+#include "GPSStats.h"
+#include "NMEAGenerator.h"
+
+struct Line
+{
+	std::string bytes;
+	int key;			//UTC millisecond of day the sentence reports, or -1
+	bool intact;
+};
+
+typedef std::vector<Line> Epoch;
+
+struct Options
+{
+	std::string log;
+	int epochs = 1000;
+	int rateHz = 10;
+	int baud = 921600;
+	bool burst = false;
+	double flip = 0;
+	double truncate = 0;
+	double drop = 0;
+	double garbage = 0;
+	uint32_t seed = 1;
+	bool fuzz = false;
+	long iterations = 10000;
+};
+
+class Random
+{
+public:
+	Random(uint32_t seed) : state(seed ? seed : 1) {}
+
+	uint32_t next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	bool chance(double p) { return (p > 0) && (next() / 4294967296.0 < p); }
+
+private:
+	uint32_t state;
+};
+
+//time the sentence reports, for matching its fix
+static int sentenceKey(const std::string& line)
+{
+	size_t end = line.find_first_of("*\r\n");
+	NMEAFields fields(line.data() + 1, (end == std::string::npos ? line.size() : end) - 1);
+	if(fields.count() < 2)
+		return -1;
+
+	std::string_view address = fields[0];
+	if(address.size() < 5)
+		return -1;
+	std::string_view type = address.substr(address.size() - 3);
+
+	NMEATime time;
+	if((type == "GGA") || (type == "RMC"))
+		nmeaParseTime(fields[1], time);
+	else if(type == "GLL")
+		nmeaParseTime(fields[5], time);
+	return time.valid ? time.millisOfDay() : -1;
+}
+
+// Splits raw NMEA into lines, and lines into epochs at each sentence of the
+// type the log starts with.
+static void splitEpochs(const std::string& text, std::vector<Epoch>& epochs)
+{
+	std::string first;
+	size_t p = 0;
+	while(p < text.size())
+	{
+		size_t newline = text.find('\n', p);
+		size_t end = (newline == std::string::npos) ? text.size() : newline + 1;
+		std::string line = text.substr(p, end - p);
+		p = end;
+
+		if((line.size() < 7) || (line[0] != '$'))
+			continue;
+
+		std::string type = line.substr(3, 3);
+		if(first.empty())
+			first = type;
+		if(epochs.empty() || (type == first))
+			epochs.push_back(Epoch());
+
+		epochs.back().push_back(Line{line, sentenceKey(line), true});
+	}
+}
+
+static void corrupt(std::vector<Epoch>& epochs, const Options& options, Random& random)
+{
+	for(Epoch& epoch : epochs)
+	{
+		for(Line& line : epoch)
+		{
+			std::string damaged;
+			for(char c : line.bytes)
+			{
+				if(random.chance(options.drop))
+					continue;
+				if(random.chance(options.flip))
+					c ^= 1 << (random.next() % 8);
+				damaged += c;
+			}
+
+			if(random.chance(options.truncate) && (damaged.size() > 1))
+				damaged.resize(1 + random.next() % (damaged.size() - 1));
+
+			//what a decoder can pass: the frame up to its checksum and a line ending after it
+			size_t star = line.bytes.find('*');
+			size_t frame = (star == std::string::npos) ? line.bytes.size() : star + 3;
+			line.intact = (damaged.compare(0, frame, line.bytes, 0, frame) == 0) &&
+				(damaged.find_first_of("\r\n", frame) == frame);
+			line.bytes = damaged;
+
+			//no '$' or '!' in the garbage, it must not start a frame of its own
+			if(random.chance(options.garbage))
+			{
+				int length = 1 + random.next() % 32;
+				for(int i = 0; i < length; i++)
+				{
+					char c = random.next();
+					line.bytes += ((c == '$') || (c == '!')) ? '#' : c;
+				}
+			}
+		}
+	}
+}
+
+// Written lines' times by the UTC time they report, so the decoding
+// thread can find when its epoch was sent.
+static const int SLOTS = 4096;
+static std::atomic<int> slotKey[SLOTS];
+static std::atomic<int64_t> slotWritten[SLOTS];
+
+static int64_t nowNanos()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Results
+{
+	GPSLatencyHistogram latency;
+	uint64_t fixes = 0;
+	uint64_t matched = 0;
+};
+
+static void fixDecoded(const GPSFix& fix, void* context)
+{
+	Results* results = static_cast<Results*>(context);
+	results->fixes++;
+	if(!fix.time.valid)
+		return;
+
+	int key = fix.time.millisOfDay();
+	int slot = (key / 10) % SLOTS;
+	if(slotKey[slot].load(std::memory_order_acquire) != key)
+		return;
+
+	results->matched++;
+	results->latency.record(std::chrono::nanoseconds(nowNanos() - slotWritten[slot].load(std::memory_order_relaxed)));
+}
+
+static int writeAll(int fd, const char* data, size_t length)
+{
+	while(length > 0)
+	{
+		ssize_t n = write(fd, data, length);
+		if(n <= 0)
+			return 0;
+		data += n;
+		length -= n;
+	}
+	return 1;
+}
+
+static void writeEpochs(const std::string& slave, const std::vector<Epoch>& epochs, const Options& options, std::atomic<bool>& done)
+{
+	int fd = open(slave.c_str(), O_WRONLY | O_NOCTTY);
+	if(fd < 0)
+	{
+		done = true;
+		return;
+	}
+
+	double bytesPerSecond = options.baud / 10.0;
+	auto period = std::chrono::nanoseconds(1000000000LL / std::max(1, options.rateHz));
+	auto start = std::chrono::steady_clock::now();
+	auto lineStart = start;
+
+	for(size_t e = 0; e < epochs.size(); e++)
+	{
+		if(options.burst)
+		{
+			lineStart = std::max(lineStart, start + period * (int64_t)e);
+			std::this_thread::sleep_until(lineStart);
+		}
+
+		int key = -1;
+		for(const Line& line : epochs[e])
+		{
+			//a serial line takes this long to carry the sentence
+			if(bytesPerSecond > 0)
+			{
+				lineStart += std::chrono::nanoseconds((int64_t)(line.bytes.size() * 1e9 / bytesPerSecond));
+				std::this_thread::sleep_until(lineStart);
+			}
+
+			//stamped before the write, the fix can come out before it returns
+			if(line.intact && (line.key >= 0))
+				key = line.key;
+			if(key >= 0)
+			{
+				int slot = (key / 10) % SLOTS;
+				slotWritten[slot].store(nowNanos(), std::memory_order_relaxed);
+				slotKey[slot].store(key, std::memory_order_release);
+			}
+
+			if(!writeAll(fd, line.bytes.data(), line.bytes.size()))
+				break;
+		}
+	}
+
+	close(fd);
+	done = true;
+}
+
+static int runPty(const Options& options)
+{
+	std::vector<Epoch> epochs;
+	if(!options.log.empty())
+	{
+		std::ifstream file(options.log, std::ios::binary);
+		if(!file)
+		{
+			std::cout << "Failed to open log " << options.log << std::endl;
+			return 1;
+		}
+		std::stringstream text;
+		text << file.rdbuf();
+		splitEpochs(text.str(), epochs);
+	}
+	else
+	{
+		NMEAGeneratorConfig config;
+		config.sentences = "GGA,RMC,GSA,GSV,VTG";
+		config.talkers = "GN,GP,GL,GA";
+		config.rateHz = options.rateHz;
+		config.seed = options.seed;
+
+		NMEAGenerator generator(config);
+		std::string text;
+		for(int i = 0; i < options.epochs; i++)
+			generator.epoch(text);
+		splitEpochs(text, epochs);
+	}
+
+	Random random(options.seed);
+	corrupt(epochs, options, random);
+
+	uint64_t bytes = 0;
+	uint64_t sentences = 0;
+	uint64_t intact = 0;
+	for(const Epoch& epoch : epochs)
+	{
+		for(const Line& line : epoch)
+		{
+			bytes += line.bytes.size();
+			sentences++;
+			intact += line.intact;
+		}
+	}
+
+	GPSSourceConfig source;
+	source.type = GPSSourceConfig::PTY;
+	GPSDecoder decoder(source);
+	if(!decoder.initGPS())
+	{
+		std::cout << "Failed to open a pseudo-terminal" << std::endl;
+		return 1;
+	}
+
+	Results results;
+	decoder.addFixListener(fixDecoded, &results);
+
+	std::string slave = static_cast<GPSPtySource*>(decoder.inputSource())->slaveName();
+	std::cout << "Writing " << epochs.size() << " epochs, " << bytes << " bytes to " << slave
+		<< " at " << options.baud << " baud" << (options.burst ? " in bursts" : "") << std::endl;
+
+	auto start = std::chrono::steady_clock::now();
+	std::atomic<bool> written{false};
+	std::thread decoding(&GPSDecoder::run, &decoder);
+	std::thread writer(writeEpochs, slave, std::cref(epochs), std::cref(options), std::ref(written));
+	writer.join();
+
+	//let the decoder catch up before stopping it
+	uint64_t last = ~(uint64_t)0;
+	while(decoder.sentenceCount() != last)
+	{
+		last = decoder.sentenceCount();
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	}
+	decoder.stop();
+	decoding.join();
+	decoder.flush();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	GPSStatsSnapshot stats;
+	decoder.readStats(stats);
+	GPSLatencySummary latency;
+	results.latency.read(latency);
+
+	printf("%.2f s, %.0f sentences/s, %.2f MB/s\n", seconds, stats.sentences / seconds, stats.bytes / seconds / 1e6);
+	printf("sent %llu sentences, %llu undamaged; decoded %llu, %llu undamaged lost\n",
+		(unsigned long long)sentences, (unsigned long long)intact, (unsigned long long)stats.sentences,
+		(unsigned long long)((intact > stats.sentences) ? intact - stats.sentences : 0));
+	printf("%llu fixes, %llu matched to their epoch: write to fix p50 %llu us  p99 %llu us  max %llu us\n",
+		(unsigned long long)results.fixes, (unsigned long long)results.matched,
+		(unsigned long long)latency.percentile(0.5), (unsigned long long)latency.percentile(0.99),
+		(unsigned long long)latency.maxMicros);
+
+	std::vector<GPSLabelledStats> all(1);
+	all[0].label = slave;
+	all[0].stats = stats;
+	std::cout << gpsFormatStats(all, STATS_TEXT);
+
+	//an undamaged sentence the decoder lost is a failure to resynchronize
+	return (stats.sentences >= intact) ? 0 : 2;
+}
+
+// Bytes a mutation favours: the ones the framing and field splitting
+// act on.
+static const char SPECIAL[] = "$!*,\r\n.-0123456789ABCDEFNSEW";
+
+static void mutate(std::string& text, Random& random)
+{
+	int mutations = 1 + random.next() % 16;
+	for(int m = 0; (m < mutations) && !text.empty(); m++)
+	{
+		size_t at = random.next() % text.size();
+		switch(random.next() % 6)
+		{
+		case 0:
+			text[at] ^= 1 << (random.next() % 8);
+			break;
+		case 1:
+			text[at] = SPECIAL[random.next() % (sizeof(SPECIAL) - 1)];
+			break;
+		case 2:
+			text.erase(at, 1 + random.next() % 64);
+			break;
+		case 3:
+			text.insert(at, 1 + random.next() % 8, SPECIAL[random.next() % (sizeof(SPECIAL) - 1)]);
+			break;
+		case 4:
+			//a run of commas, far more fields than any sentence has
+			text.insert(at, 40 + random.next() % 200, ',');
+			break;
+		default:
+		{
+			//splice one part of the input into another
+			size_t from = random.next() % text.size();
+			size_t length = std::min<size_t>(1 + random.next() % 128, text.size() - from);
+			text.insert(at, text.substr(from, length));
+			break;
+		}
+		}
+	}
+}
+
+// Checksums go bad under mutation and the decoder stops at them, so valid
+// ones are put back on part of the lines to reach the field parsers.
+static void fixChecksums(std::string& text, Random& random)
+{
+	size_t p = 0;
+	while((p = text.find('$', p)) != std::string::npos)
+	{
+		size_t star = text.find('*', p);
+		size_t newline = text.find('\n', p);
+		if((star == std::string::npos) || (newline < star) || (star + 2 >= text.size()))
+			break;
+
+		if(random.next() % 4)
+		{
+			unsigned char checksum = 0;
+			for(size_t i = p + 1; i < star; i++)
+				checksum ^= text[i];
+			char hex[3];
+			snprintf(hex, sizeof(hex), "%02X", checksum);
+			text[star + 1] = hex[0];
+			text[star + 2] = hex[1];
+		}
+		p = star;
+	}
+
+	//the same for UBX frames whose length still fits the input
+	for(p = 0; p + UBX_HEADER_LENGTH + UBX_CHECKSUM_LENGTH <= text.size(); p++)
+	{
+		if(((uint8_t)text[p] != UBX_SYNC1) || ((uint8_t)text[p + 1] != UBX_SYNC2))
+			continue;
+
+		size_t length = (uint8_t)text[p + 4] | ((uint8_t)text[p + 5] << 8);
+		size_t end = p + UBX_HEADER_LENGTH + length;
+		if((end + UBX_CHECKSUM_LENGTH > text.size()) || !(random.next() % 4))
+			continue;
+
+		uint8_t a, b;
+		ubxChecksum((const uint8_t*)text.data() + p + 2, end - p - 2, a, b);
+		text[end] = (char)a;
+		text[end + 1] = (char)b;
+	}
+}
+
+static int runFuzz(const Options& options)
+{
+	Random random(options.seed);
+
+	NMEAGeneratorConfig config;
+	config.sentences = "GGA,RMC,GSA,GSV,VTG,GLL,TXT,PVT,SAT";
+	config.talkers = "GN,GP,GL,GA";
+	NMEAGenerator generator(config);
+	std::string seed;
+	for(int i = 0; i < 8; i++)
+		generator.epoch(seed);
+
+	GPSDecoder decoder("");
+	uint64_t decoded = 0;
+
+	for(long i = 0; i < options.iterations; i++)
+	{
+		size_t from = random.next() % seed.size();
+		std::string text = seed.substr(from, 1 + random.next() % 2048);
+		mutate(text, random);
+		fixChecksums(text, random);
+
+		//odd read sizes, frames split across calls
+		for(size_t p = 0; p < text.size(); )
+		{
+			size_t length = std::min<size_t>(1 + random.next() % 97, text.size() - p);
+			decoded += decoder.decode(text.data() + p, length);
+			p += length;
+		}
+
+		//sentences handed over one at a time, as the old stream read did
+		size_t p = 0;
+		while(p < text.size())
+		{
+			size_t end = text.find('\n', p);
+			if(end == std::string::npos)
+				end = text.size();
+			decoder.GPSSentenceCheck(text.data() + p, end - p);
+			decoder.crunchGPSSentence(text.data() + p, end - p);
+			p = end + 1;
+		}
+
+		if((i + 1) % 100000 == 0)
+			std::cout << i + 1 << " inputs" << std::endl;
+	}
+	decoded += decoder.flush();
+
+	std::cout << options.iterations << " inputs, " << decoded << " sentences passed, no crash" << std::endl;
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	int i = 1;
+	if((argc > 1) && strncmp(argv[1], "--", 2))
+		options.log = argv[i++];
+
+	for(; i < argc; i++)
+	{
+		std::string option = argv[i];
+		const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+		if(option == "--burst")
+			options.burst = true;
+		else if(option == "--fuzz")
+		{
+			options.fuzz = true;
+			if(value && isdigit(value[0]))
+				options.iterations = atol(argv[++i]);
+		}
+		else if(!value)
+		{
+			std::cout << "Missing value for " << option << std::endl;
+			return 1;
+		}
+		else if(option == "--epochs")
+			options.epochs = atoi(argv[++i]);
+		else if(option == "--rate")
+			options.rateHz = atoi(argv[++i]);
+		else if(option == "--baud")
+			options.baud = atoi(argv[++i]);
+		else if(option == "--flip")
+			options.flip = atof(argv[++i]);
+		else if(option == "--truncate")
+			options.truncate = atof(argv[++i]);
+		else if(option == "--drop")
+			options.drop = atof(argv[++i]);
+		else if(option == "--garbage")
+			options.garbage = atof(argv[++i]);
+		else if(option == "--seed")
+			options.seed = atoi(argv[++i]);
+		else
+		{
+			std::cout << "Unknown option " << option << std::endl;
+			return 1;
+		}
+	}
+
+	return options.fuzz ? runFuzz(options) : runPty(options);
+}
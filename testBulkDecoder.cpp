@@ -0,0 +1,196 @@
+// GPSBulkDecoder promises the fixes and counts of decoding each log start
+// to end on one GPSDecoder. Checks that over generated logs, clean and
+// corrupted, NMEA alone and with UBX mixed in, for small and large chunks,
+// with and without warm-up, on one thread and many.
+//
+//   testBulkDecoder
+//
+// Exits 0 when every case passes.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "GPSBulkDecoder.h"
+#include "GPSDecoder.h"
+#include "NMEAGenerator.h"
+
+static const size_t LOG_BYTES = 512 << 10;
+
+static void fixCollected(const GPSFix& fix, void* context)
+{
+	static_cast<std::vector<GPSFix>*>(context)->push_back(fix);
+}
+
+static bool sameFix(const GPSFix& a, const GPSFix& b)
+{
+	return (a.talker.view() == b.talker.view())
+		&& (a.time.valid == b.time.valid) && (a.time.millisOfDay() == b.time.millisOfDay())
+		&& (a.date.valid == b.date.valid) && (a.date.year == b.date.year) && (a.date.month == b.date.month) && (a.date.day == b.date.day)
+		&& (a.latitude == b.latitude) && (a.longitude == b.longitude) && (a.altitude == b.altitude)
+		&& (a.heightOfGeoid == b.heightOfGeoid) && (a.speedKnots == b.speedKnots) && (a.course == b.course)
+		&& (a.quality == b.quality) && (a.fixType == b.fixType) && (a.status == b.status)
+		&& (a.PDOP == b.PDOP) && (a.HDOP == b.HDOP) && (a.VDOP == b.VDOP)
+		&& (a.satellitesUsed == b.satellitesUsed) && (a.satellitesInView == b.satellitesInView)
+		&& (a.sentences == b.sentences);
+}
+
+static bool sameStats(GPSStatsSnapshot a, GPSStatsSnapshot b)
+{
+	std::sort(a.types.begin(), a.types.end());
+	std::sort(b.types.begin(), b.types.end());
+	return (a.bytes == b.bytes) && (a.frames == b.frames) && (a.sentences == b.sentences)
+		&& (a.checksumFailures == b.checksumFailures) && (a.malformed == b.malformed)
+		&& (a.truncated == b.truncated) && (a.overlong == b.overlong) && (a.droppedBytes == b.droppedBytes)
+		&& (a.noPosition == b.noPosition) && (a.ubxFrames == b.ubxFrames)
+		&& (a.ubxChecksumFailures == b.ubxChecksumFailures) && (a.epochs == b.epochs)
+		&& (a.partialEpochs == b.partialEpochs) && (a.types == b.types) && (a.otherTypes == b.otherTypes);
+}
+
+// Adds one decoder's counts to total, as GPSBulkDecoder sums its logs.
+static void addStats(GPSStatsSnapshot& total, const GPSStatsSnapshot& add)
+{
+	total.bytes += add.bytes;
+	total.frames += add.frames;
+	total.sentences += add.sentences;
+	total.checksumFailures += add.checksumFailures;
+	total.malformed += add.malformed;
+	total.truncated += add.truncated;
+	total.overlong += add.overlong;
+	total.droppedBytes += add.droppedBytes;
+	total.noPosition += add.noPosition;
+	total.ubxFrames += add.ubxFrames;
+	total.ubxChecksumFailures += add.ubxChecksumFailures;
+	total.epochs += add.epochs;
+	total.partialEpochs += add.partialEpochs;
+	total.otherTypes += add.otherTypes;
+	for(const auto& type : add.types)
+	{
+		auto found = std::find_if(total.types.begin(), total.types.end(),
+			[&](const std::pair<std::string, uint64_t>& t) { return t.first == type.first; });
+		if(found != total.types.end())
+			found->second += type.second;
+		else
+			total.types.push_back(type);
+	}
+}
+
+static bool writeLog(const std::string& path, const NMEAGeneratorConfig& config)
+{
+	NMEAGenerator generator(config);
+	std::string out;
+	generator.fill(out, LOG_BYTES);
+
+	FILE* file = fopen(path.c_str(), "w");
+	if(!file)
+		return false;
+	bool written = fwrite(out.data(), 1, out.size(), file) == out.size();
+	return (fclose(file) == 0) && written;
+}
+
+static std::string readLog(const std::string& path)
+{
+	std::string in;
+	FILE* file = fopen(path.c_str(), "r");
+	if(!file)
+		return in;
+	char buffer[64 << 10];
+	size_t n;
+	while((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		in.append(buffer, n);
+	fclose(file);
+	return in;
+}
+
+static bool check(const std::string& name, bool passed)
+{
+	printf("%s %s\n", passed ? "ok  " : "FAIL", name.c_str());
+	return passed;
+}
+
+int main()
+{
+	char directory[] = "/tmp/testBulkDecoderXXXXXX";
+	if(!mkdtemp(directory))
+		return 1;
+
+	bool passed = true;
+	for(int ubx = 0; ubx < 2; ubx++)
+	for(int corrupt = 0; corrupt < 2; corrupt++)
+	{
+		std::string kind = std::string(ubx ? "UBX mixed" : "NMEA") + (corrupt ? ", corrupted" : ", clean");
+
+		//two logs, so each has to start on a fresh decoder
+		std::vector<std::string> paths;
+		for(int i = 0; i < 2; i++)
+		{
+			NMEAGeneratorConfig config;
+			config.sentences = ubx ? "GGA,RMC,GSA,GSV,VTG,PVT,SAT" : "GGA,RMC,GSA,GSV,VTG,GLL";
+			config.talkers = "GN,GP,GL,GA";
+			config.rateHz = 5;
+			config.seed = 1 + i;
+			if(corrupt)
+				config.checksumErrorRate = config.truncateRate = config.noiseRate = 0.01;
+
+			paths.push_back(std::string(directory) + "/log" + std::to_string(i) + ".nmea");
+			if(!writeLog(paths.back(), config))
+				return 1;
+		}
+
+		std::vector<GPSFix> serial;
+		GPSStatsSnapshot serialStats;
+		for(const std::string& path : paths)
+		{
+			std::string log = readLog(path);
+			GPSDecoder decoder{GPSSourceConfig()};
+			decoder.addFixListener(fixCollected, &serial);
+			decoder.decode(log.data(), log.size());
+			decoder.flush();
+
+			GPSStatsSnapshot stats;
+			decoder.readStats(stats);
+			addStats(serialStats, stats);
+		}
+		passed &= check(kind + ": fixes found", serial.size() > 500);
+		if(corrupt)
+			passed &= check(kind + ": damage seen", (serialStats.checksumFailures > 0) && (serialStats.droppedBytes > 0));
+
+		for(size_t chunkBytes : {(size_t)4 << 10, (size_t)64 << 10, (size_t)1 << 20})
+		for(size_t warmupBytes : {(size_t)0, (size_t)64 << 10})
+		for(int threads : {1, 4, 16})
+		{
+			GPSBulkConfig config;
+			config.threads = threads;
+			config.chunkBytes = chunkBytes;
+			config.warmupBytes = warmupBytes;
+
+			GPSBulkDecoder bulk;
+			bulk.setConfig(config);
+			for(const std::string& path : paths)
+				bulk.add(path);
+
+			std::vector<GPSFix> fixes;
+			if(!bulk.run(fixCollected, &fixes))
+				return 1;
+			GPSStatsSnapshot stats;
+			bulk.readStats(stats);
+
+			bool same = (fixes.size() == serial.size()) && sameStats(stats, serialStats);
+			for(size_t i = 0; same && (i < fixes.size()); i++)
+				same = sameFix(fixes[i], serial[i]);
+
+			passed &= check(kind + ", " + std::to_string(chunkBytes >> 10) + " KB chunks, "
+				+ std::to_string(warmupBytes >> 10) + " KB warm-up, " + std::to_string(threads) + " threads", same);
+		}
+
+		for(const std::string& path : paths)
+			unlink(path.c_str());
+	}
+
+	rmdir(directory);
+	return passed ? 0 : 1;
+}
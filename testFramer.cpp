@@ -0,0 +1,180 @@
+// NMEAFramer has to cut a stream into the same frames, with the same
+// counts, however the stream is split across feed() calls: whole, byte
+// by byte and at random points. Checks a hand-made stream with a known
+// count of every kind of damage, including a false UBX sync held across
+// feeds, then generated receiver output with corruption and UBX mixed in.
+//
+//   testFramer
+//
+// Exits 0 when every case passes.
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "GPSUBX.h"
+#include "NMEAFramer.h"
+#include "NMEAGenerator.h"
+
+struct Framed
+{
+	std::vector<std::string> frames;
+	uint64_t truncated = 0;
+	uint64_t overlong = 0;
+	uint64_t droppedBytes = 0;
+	uint64_t ubxFrames = 0;
+	uint64_t ubxChecksumFailures = 0;
+
+	bool operator==(const Framed& other) const
+	{
+		return (frames == other.frames) && (truncated == other.truncated) && (overlong == other.overlong)
+			&& (droppedBytes == other.droppedBytes) && (ubxFrames == other.ubxFrames)
+			&& (ubxChecksumFailures == other.ubxChecksumFailures);
+	}
+};
+
+static void frameCut(const char* frame, size_t length, void* context)
+{
+	static_cast<Framed*>(context)->frames.push_back(std::string(frame, length));
+}
+
+// Feeds stream in pieces that end at each of cuts, then the rest.
+static Framed frame(const std::string& stream, const std::vector<size_t>& cuts)
+{
+	Framed out;
+	NMEAFramer framer;
+	size_t from = 0;
+	for(size_t cut : cuts)
+	{
+		framer.feed(stream.data() + from, cut - from, frameCut, &out);
+		from = cut;
+	}
+	framer.feed(stream.data() + from, stream.size() - from, frameCut, &out);
+	framer.finish(frameCut, &out);
+
+	out.truncated = framer.truncated();
+	out.overlong = framer.overlong();
+	out.droppedBytes = framer.droppedBytes();
+	out.ubxFrames = framer.ubxFrames();
+	out.ubxChecksumFailures = framer.ubxChecksumFailures();
+	return out;
+}
+
+static Framed whole(const std::string& stream)
+{
+	return frame(stream, std::vector<size_t>());
+}
+
+static Framed byteByByte(const std::string& stream)
+{
+	std::vector<size_t> cuts;
+	for(size_t i = 1; i < stream.size(); i++)
+		cuts.push_back(i);
+	return frame(stream, cuts);
+}
+
+static Framed randomSplits(const std::string& stream, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::vector<size_t> cuts;
+	for(size_t i = 1 + random() % 200; i < stream.size(); i += 1 + random() % 200)
+		cuts.push_back(i);
+	return frame(stream, cuts);
+}
+
+static bool check(const std::string& name, bool passed)
+{
+	printf("%s %s\n", passed ? "ok  " : "FAIL", name.c_str());
+	return passed;
+}
+
+static bool checkSplits(const std::string& name, const std::string& stream, const Framed& expected)
+{
+	bool passed = check(name + ": byte by byte", byteByByte(stream) == expected);
+	for(uint32_t seed = 1; seed <= 20; seed++)
+		passed &= check(name + ": random splits " + std::to_string(seed), randomSplits(stream, seed) == expected);
+	return passed;
+}
+
+int main()
+{
+	bool passed = true;
+
+	//every kind of damage once, and what it costs
+	std::string stream;
+	Framed expected;
+
+	stream += "noise";
+	expected.droppedBytes += 5;
+
+	stream += "$GPGGA,1*00\r\n";
+	expected.frames.push_back("$GPGGA,1*00");
+
+	stream += "$GPTRU,12";
+	expected.truncated++;
+	expected.droppedBytes += 9;
+	stream += "$GPGLL,2*00\r\n";
+	expected.frames.push_back("$GPGLL,2*00");
+
+	std::string overlong = "$" + std::string(100, 'A');
+	stream += overlong + "\r\n";
+	expected.overlong++;
+	expected.droppedBytes += overlong.size();
+
+	//a lone sync byte in front of a sentence
+	stream += "\xB5";
+	expected.droppedBytes += 1;
+	stream += "$GPVTG,3*00\r\n";
+	expected.frames.push_back("$GPVTG,3*00");
+
+	std::string pvt;
+	uint8_t payload[4] = {1, 2, 3, 4};
+	ubxAppendMessage(pvt, UBX_NAV, UBX_NAV_PVT, payload, sizeof(payload));
+	stream += pvt;
+	expected.frames.push_back(pvt);
+	expected.ubxFrames++;
+
+	//a UBX header whose checksum fails: the sync is dropped and the rest
+	//hunted through as noise
+	std::string bad = pvt;
+	bad[bad.size() - 1] ^= 0x55;
+	bad[bad.size() - 2] ^= 0x55;
+	stream += bad;
+	expected.ubxChecksumFailures++;
+	expected.droppedBytes += bad.size();
+
+	//a length no receiver sends
+	stream += std::string("\xB5\x62\x01\x07\xff\xff", 6);
+	expected.overlong++;
+	expected.droppedBytes += 6;
+
+	stream += "$GPZDA,4*00\r\n";
+	expected.frames.push_back("$GPZDA,4*00");
+
+	//no line ending at the end of the log
+	stream += "$GPTXT,5*00";
+	expected.frames.push_back("$GPTXT,5*00");
+
+	passed &= check("damage: whole", whole(stream) == expected);
+	passed &= checkSplits("damage", stream, expected);
+
+	//receiver output with every sentence type, UBX and corruption
+	NMEAGeneratorConfig config;
+	config.sentences = "GGA,RMC,GSA,GSV,VTG,GLL,TXT,PVT,SAT";
+	config.talkers = "GN,GP,GL,GA";
+	config.checksumErrorRate = 0.02;
+	config.truncateRate = 0.02;
+	config.noiseRate = 0.02;
+	NMEAGenerator generator(config);
+	std::string generated;
+	generator.fill(generated, 256 << 10);
+
+	Framed reference = whole(generated);
+	passed &= check("generated: frames found", reference.frames.size() > 1000);
+	passed &= check("generated: damage seen", (reference.truncated > 0) && (reference.droppedBytes > 0));
+	passed &= checkSplits("generated", generated, reference);
+
+	return passed ? 0 : 1;
+}
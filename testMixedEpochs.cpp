@@ -0,0 +1,99 @@
+// A receiver sending UBX NAV-PVT alongside NMEA reports each epoch both
+// ways; the decoder has to give one fix per epoch either way round, and go
+// back to NMEA fixes when the binary ones stop.
+//
+//   testMixedEpochs
+//
+// Exits 0 when every case passes.
+
+#include <cstdio>
+#include <string>
+
+#include "GPSDecoder.h"
+#include "NMEAGenerator.h"
+
+struct Count
+{
+	int fixes = 0;
+	int binary = 0;			//with a NAV-PVT in them
+	int withHDOP = 0;
+};
+
+static void fixDecoded(const GPSFix& fix, void* context)
+{
+	Count* count = static_cast<Count*>(context);
+	count->fixes++;
+	if(fix.sentences & FIX_PVT)
+		count->binary++;
+	if(fix.HDOP > 0)
+		count->withHDOP++;
+}
+
+static bool check(const char* name, bool passed)
+{
+	printf("%s %s\n", passed ? "ok  " : "FAIL", name);
+	return passed;
+}
+
+// Decodes epochs of the mix, then as many with only the NMEA sentences of
+// it when nmeaAfter, one decode() per epoch.
+static Count decodeMix(const char* sentences, int epochs, bool nmeaAfter)
+{
+	NMEAGeneratorConfig config;
+	config.sentences = sentences;
+	config.talkers = "GN,GP,GL";
+	config.rateHz = 5;
+	NMEAGenerator mixed(config);
+
+	Count count;
+	GPSDecoder decoder{GPSSourceConfig()};
+	decoder.addFixListener(fixDecoded, &count);
+
+	std::string out;
+	for(int i = 0; i < epochs; i++)
+	{
+		out.clear();
+		mixed.epoch(out);
+		decoder.decode(out.data(), out.size());
+	}
+
+	if(nmeaAfter)
+	{
+		config.sentences = "GGA,RMC,GSA,GSV,VTG";
+		NMEAGenerator nmea(config);
+		for(int i = 0; i < epochs; i++)
+		{
+			out.clear();
+			nmea.epoch(out);
+			decoder.decode(out.data(), out.size());
+		}
+	}
+
+	decoder.flush();
+	return count;
+}
+
+int main()
+{
+	const int EPOCHS = 200;
+	bool passed = true;
+
+	Count nmeaFirst = decodeMix("GGA,RMC,GSA,GSV,VTG,PVT,SAT", EPOCHS, false);
+	passed &= check("NMEA then UBX: one fix per epoch", nmeaFirst.fixes == EPOCHS);
+	passed &= check("NMEA then UBX: every fix binary", nmeaFirst.binary == EPOCHS);
+	passed &= check("NMEA then UBX: HDOP from the NMEA", nmeaFirst.withHDOP == EPOCHS);
+
+	Count ubxFirst = decodeMix("PVT,SAT,GGA,RMC,GSA,GSV,VTG", EPOCHS, false);
+	passed &= check("UBX then NMEA: one fix per epoch", ubxFirst.fixes == EPOCHS);
+	passed &= check("UBX then NMEA: every fix binary", ubxFirst.binary == EPOCHS);
+
+	//the binary fixes stop, NMEA ones take over within MAX_UNMATCHED epochs
+	Count stopped = decodeMix("GGA,RMC,GSA,GSV,VTG,PVT,SAT", EPOCHS, true);
+	int lost = 2 * EPOCHS - stopped.fixes;
+	passed &= check("UBX stops: NMEA fixes again", (lost >= 0) && (lost <= GPSEpochAssembler::MAX_UNMATCHED));
+
+	Count nmeaOnly = decodeMix("GGA,RMC,GSA,GSV,VTG", EPOCHS, false);
+	passed &= check("NMEA only: one fix per epoch", nmeaOnly.fixes == EPOCHS);
+
+	return passed ? 0 : 1;
+}
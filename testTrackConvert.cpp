@@ -0,0 +1,88 @@
+// trackConvert's --from/--to window over raw logs with and without dates:
+// a dated log is cut to the window, a GGA-only one, whose fixes carry only
+// a time of day, is kept whole rather than compared with a date.
+//
+//   testTrackConvert path/to/trackConvert
+//
+// Exits 0 when every case passes.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+
+#include "NMEAGenerator.h"
+
+static const int EPOCHS = 60;
+
+static bool check(const char* name, bool passed)
+{
+	printf("%s %s\n", passed ? "ok  " : "FAIL", name);
+	return passed;
+}
+
+static bool writeLog(const std::string& path, const char* sentences)
+{
+	NMEAGeneratorConfig config;
+	config.sentences = sentences;
+	NMEAGenerator generator(config);
+
+	std::string out;
+	for(int i = 0; i < EPOCHS; i++)
+		generator.epoch(out);
+
+	FILE* file = fopen(path.c_str(), "w");
+	if(!file)
+		return false;
+	bool written = fwrite(out.data(), 1, out.size(), file) == out.size();
+	return (fclose(file) == 0) && written;
+}
+
+// Fixes trackConvert says it wrote, -1 when it failed.
+static long convert(const std::string& trackConvert, const std::string& in, const std::string& out, const char* options)
+{
+	std::string command = trackConvert + " " + in + " " + out + " " + options;
+	FILE* pipe = popen(command.c_str(), "r");
+	if(!pipe)
+		return -1;
+
+	long fixes = -1;
+	char line[256];
+	while(fgets(line, sizeof(line), pipe))
+		sscanf(line, "Wrote %ld fixes", &fixes);
+	return (pclose(pipe) == 0) ? fixes : -1;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		printf("usage: testTrackConvert path/to/trackConvert\n");
+		return 1;
+	}
+	std::string trackConvert = argv[1];
+
+	char directory[] = "/tmp/testTrackConvertXXXXXX";
+	if(!mkdtemp(directory))
+		return 1;
+	std::string dated = std::string(directory) + "/dated.nmea";
+	std::string undated = std::string(directory) + "/undated.nmea";
+	std::string out = std::string(directory) + "/out.csv";
+	if(!writeLog(dated, "GGA,RMC,GSA") || !writeLog(undated, "GGA,GSA"))
+		return 1;
+
+	//the generator starts at 2024-05-01T00:00:00Z, one epoch a second
+	bool passed = true;
+	passed &= check("dated, whole", convert(trackConvert, dated, out, "") == EPOCHS);
+	passed &= check("dated, --from", convert(trackConvert, dated, out, "--from 2024-05-01T00:00:30") == EPOCHS - 30);
+	passed &= check("dated, --to", convert(trackConvert, dated, out, "--to 2024-05-01T00:00:09") == 10);
+	passed &= check("undated, --from", convert(trackConvert, undated, out, "--from 2024-05-01T00:00:30") == EPOCHS);
+	passed &= check("undated, --to", convert(trackConvert, undated, out, "--to 2024-05-01T00:00:09") == EPOCHS);
+
+	unlink(dated.c_str());
+	unlink(undated.c_str());
+	unlink(out.c_str());
+	rmdir(directory);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,330 @@
+// GPSTrackIndex has to find exactly the points a scan of every track log
+// would. Writes track logs of random walks, one across 180 degrees, then
+// checks box, radius and polygon queries, with and without a time window,
+// against GPSTrackReader::read() over every track, and that load() turns
+// down an index that was cut short or altered, or whose tracks changed.
+//
+//   testTrackIndex
+//
+// Exits 0 when every case passes.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <unistd.h>
+
+#include "GPSGeodesy.h"
+#include "GPSTrackIndex.h"
+#include "GPSTrackLog.h"
+
+static const int64_t START_TIME = 1714521600000LL;		//2024-05-01
+static const int POINTS = 5000;
+static const uint32_t BLOCK_POINTS = 64;
+
+typedef std::tuple<std::string, int64_t, int32_t, int32_t> Match;
+
+// An area as its test on a point in degrees.
+struct Area
+{
+	enum { BOX, CIRCLE, POLYGON } shape;
+	double minLatitude, minLongitude, maxLatitude, maxLongitude;
+	double latitude, longitude, metres;
+	std::vector<double> polygonLatitude, polygonLongitude;
+
+	bool contains(double pointLatitude, double pointLongitude) const
+	{
+		if(shape == CIRCLE)
+			return gpsDistance(latitude, longitude, pointLatitude, pointLongitude) <= metres;
+		if(shape == POLYGON)
+		{
+			bool inside = false;
+			const std::vector<double>& lat = polygonLatitude;
+			const std::vector<double>& lon = polygonLongitude;
+			for(size_t i = 0, j = lat.size() - 1; i < lat.size(); j = i++)
+				if(((lat[i] > pointLatitude) != (lat[j] > pointLatitude))
+					&& (pointLongitude < lon[j] + (pointLatitude - lat[j]) * (lon[i] - lon[j]) / (lat[i] - lat[j])))
+					inside = !inside;
+			return inside;
+		}
+
+		if((pointLatitude < minLatitude) || (pointLatitude > maxLatitude))
+			return false;
+		if(minLongitude <= maxLongitude)
+			return (pointLongitude >= minLongitude) && (pointLongitude <= maxLongitude);
+		return (pointLongitude >= minLongitude) || (pointLongitude <= maxLongitude);
+	}
+};
+
+struct Scan
+{
+	const std::string* track;
+	const Area* area;
+	std::vector<Match>* matches;
+};
+
+static void pointScanned(const GPSTrackPoint& point, void* context)
+{
+	Scan* scan = static_cast<Scan*>(context);
+	if(scan->area->contains(point.latitude * 1e-7, point.longitude * 1e-7))
+		scan->matches->push_back(Match(*scan->track, point.time, point.latitude, point.longitude));
+}
+
+static void pointFound(const std::string& track, const GPSTrackPoint& point, void* context)
+{
+	static_cast<std::vector<Match>*>(context)->push_back(Match(track, point.time, point.latitude, point.longitude));
+}
+
+// Every match by reading each track from start to end.
+static std::vector<Match> bruteForce(const std::vector<std::string>& tracks, const Area& area, int64_t from, int64_t to)
+{
+	std::vector<Match> matches;
+	for(const std::string& track : tracks)
+	{
+		GPSTrackReader reader;
+		if(!reader.open(track))
+			continue;
+		Scan scan = {&track, &area, &matches};
+		reader.read(from, to, pointScanned, &scan);
+	}
+	std::sort(matches.begin(), matches.end());
+	return matches;
+}
+
+static std::vector<Match> indexed(const GPSTrackIndex& index, const Area& area, int64_t from, int64_t to)
+{
+	std::vector<Match> matches;
+	if(area.shape == Area::BOX)
+		index.queryBox(area.minLatitude, area.minLongitude, area.maxLatitude, area.maxLongitude, from, to, pointFound, &matches);
+	else if(area.shape == Area::CIRCLE)
+		index.queryRadius(area.latitude, area.longitude, area.metres, from, to, pointFound, &matches);
+	else
+		index.queryPolygon(area.polygonLatitude.data(), area.polygonLongitude.data(), area.polygonLatitude.size(),
+			from, to, pointFound, &matches);
+	std::sort(matches.begin(), matches.end());
+	return matches;
+}
+
+// A walk of a point a second from latitude, longitude, wrapping at 180
+// degrees longitude.
+static bool writeTrack(const std::string& path, double latitude, double longitude, double eastward, int64_t start, uint32_t seed)
+{
+	GPSTrackWriter writer;
+	if(!writer.open(path, BLOCK_POINTS))
+		return false;
+
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<double> step(-0.0002, 0.0002);
+	for(int i = 0; i < POINTS; i++)
+	{
+		latitude += step(random);
+		longitude += eastward + step(random);
+		if(longitude > 180)
+			longitude -= 360;
+
+		GPSTrackPoint point;
+		point.time = start + i * 1000LL;
+		point.latitude = (int32_t)std::lround(latitude * 1e7);
+		point.longitude = (int32_t)std::lround(longitude * 1e7);
+		point.quality = 1;
+		if(!writer.add(point))
+			return false;
+	}
+	writer.close();
+	return true;
+}
+
+static bool check(const std::string& name, bool passed)
+{
+	printf("%s %s\n", passed ? "ok  " : "FAIL", name.c_str());
+	return passed;
+}
+
+static bool writeFile(const std::string& path, const std::string& data)
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if(!file)
+		return false;
+	bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+	return (fclose(file) == 0) && written;
+}
+
+static std::string readFile(const std::string& path)
+{
+	std::string in;
+	FILE* file = fopen(path.c_str(), "r");
+	if(!file)
+		return in;
+	char buffer[64 << 10];
+	size_t n;
+	while((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		in.append(buffer, n);
+	fclose(file);
+	return in;
+}
+
+int main()
+{
+	char directory[] = "/tmp/testTrackIndexXXXXXX";
+	if(!mkdtemp(directory))
+		return 1;
+	std::string base(directory);
+
+	//Cambridge twice, an hour apart, a walk east over 180 degrees near
+	//Fiji, and one south of it later in the day
+	std::vector<std::string> tracks;
+	for(int i = 0; i < 4; i++)
+		tracks.push_back(base + "/track" + std::to_string(i) + ".trk");
+	if(!writeTrack(tracks[0], 52.20, 0.12, 0, START_TIME, 1)
+		|| !writeTrack(tracks[1], 52.21, 0.11, 0, START_TIME + 3600000, 2)
+		|| !writeTrack(tracks[2], -17.0, 179.8, 0.0001, START_TIME, 3)
+		|| !writeTrack(tracks[3], -17.2, 179.95, 0.0001, START_TIME + 7200000, 4))
+		return 1;
+
+	GPSTrackIndex index;
+	bool passed = check("build", index.build(tracks, 2) == 1);
+	std::string indexPath = base + "/tracks.idx";
+	passed &= check("save", index.save(indexPath) == 1);
+
+	GPSTrackIndex loaded;
+	passed &= check("load", loaded.load(indexPath) == 1);
+	passed &= check("load: every block", loaded.blockCount() == index.blockCount());
+
+	const int64_t ALL_FROM = GPSTrackIndex::ALL_TIME_FROM;
+	const int64_t ALL_TO = GPSTrackIndex::ALL_TIME_TO;
+
+	struct Query
+	{
+		std::string name;
+		Area area;
+		int64_t from;
+		int64_t to;
+	};
+	std::vector<Query> queries;
+
+	Area world = {};
+	world.shape = Area::BOX;
+	world.minLatitude = -90;
+	world.minLongitude = -180;
+	world.maxLatitude = 90;
+	world.maxLongitude = 180;
+	queries.push_back({"everything", world, ALL_FROM, ALL_TO});
+	queries.push_back({"everything, 20 minutes of it", world, START_TIME + 3000000, START_TIME + 4200000});
+
+	Area box = {};
+	box.shape = Area::BOX;
+	box.minLatitude = 52.19;
+	box.minLongitude = 0.10;
+	box.maxLatitude = 52.21;
+	box.maxLongitude = 0.13;
+	queries.push_back({"box", box, ALL_FROM, ALL_TO});
+	queries.push_back({"box, first hour", box, START_TIME, START_TIME + 3599999});
+
+	Area across = {};
+	across.shape = Area::BOX;
+	across.minLatitude = -17.3;
+	across.minLongitude = 179.9;
+	across.maxLatitude = -16.9;
+	across.maxLongitude = -179.8;
+	queries.push_back({"box across 180 degrees", across, ALL_FROM, ALL_TO});
+
+	Area circle = {};
+	circle.shape = Area::CIRCLE;
+	circle.latitude = 52.205;
+	circle.longitude = 0.118;
+	circle.metres = 800;
+	queries.push_back({"radius", circle, ALL_FROM, ALL_TO});
+
+	Area circleAcross = circle;
+	circleAcross.latitude = -17.0;
+	circleAcross.longitude = 180.0;
+	circleAcross.metres = 5000;
+	queries.push_back({"radius across 180 degrees", circleAcross, ALL_FROM, ALL_TO});
+
+	Area polygon = {};
+	polygon.shape = Area::POLYGON;
+	polygon.polygonLatitude = {52.19, 52.215, 52.22, 52.195};
+	polygon.polygonLongitude = {0.10, 0.105, 0.14, 0.13};
+	queries.push_back({"polygon", polygon, ALL_FROM, ALL_TO});
+	queries.push_back({"polygon, second hour", polygon, START_TIME + 3600000, START_TIME + 7199999});
+
+	Area nowhere = box;
+	nowhere.minLatitude = 10;
+	nowhere.maxLatitude = 11;
+	queries.push_back({"box with nothing in it", nowhere, ALL_FROM, ALL_TO});
+
+	for(const Query& query : queries)
+	{
+		std::vector<Match> expected = bruteForce(tracks, query.area, query.from, query.to);
+		std::vector<Match> found = indexed(loaded, query.area, query.from, query.to);
+		passed &= check(query.name + ": " + std::to_string(expected.size()) + " points", found == expected);
+	}
+	passed &= check("everything: every point", bruteForce(tracks, world, ALL_FROM, ALL_TO).size() == 4 * POINTS);
+
+	//a small area only reaches a few blocks
+	indexed(loaded, box, START_TIME, START_TIME + 3599999);
+	passed &= check("box, first hour: blocks skipped", loaded.blocksRead() < loaded.blockCount() / 4);
+
+	//damaged indexes
+	std::string saved = readFile(indexPath);
+	std::string damagedPath = base + "/damaged.idx";
+
+	for(size_t cut : {(size_t)4, (size_t)20, saved.size() / 2, saved.size() - 1})
+	{
+		writeFile(damagedPath, saved.substr(0, cut));
+		GPSTrackIndex damaged;
+		passed &= check("truncated to " + std::to_string(cut) + " bytes", damaged.load(damagedPath) == 0);
+	}
+
+	std::string longer = saved + "x";
+	writeFile(damagedPath, longer);
+	GPSTrackIndex extended;
+	passed &= check("trailing bytes", extended.load(damagedPath) == 0);
+
+	std::string magic = saved;
+	magic[0] = 'X';
+	writeFile(damagedPath, magic);
+	GPSTrackIndex badMagic;
+	passed &= check("wrong magic", badMagic.load(damagedPath) == 0);
+
+	//block count one higher
+	std::string blocks = saved;
+	uint32_t blockCount;
+	memcpy(&blockCount, &blocks[16], 4);
+	blockCount++;
+	memcpy(&blocks[16], &blockCount, 4);
+	writeFile(damagedPath, blocks);
+	GPSTrackIndex badBlocks;
+	passed &= check("wrong block count", badBlocks.load(damagedPath) == 0);
+
+	//the root pointing past the nodes, its first child is 8 bytes from the end
+	std::string root = saved;
+	uint32_t first = 0xffffff00;
+	memcpy(&root[root.size() - 8], &first, 4);
+	writeFile(damagedPath, root);
+	GPSTrackIndex badRoot;
+	passed &= check("root out of range", badRoot.load(damagedPath) == 0);
+
+	//a track that grew since
+	FILE* grown = fopen(tracks[3].c_str(), "a");
+	if(grown)
+	{
+		fputc(0, grown);
+		fclose(grown);
+	}
+	GPSTrackIndex stale;
+	passed &= check("track changed since", stale.load(indexPath) == 0);
+
+	for(const std::string& track : tracks)
+		unlink(track.c_str());
+	unlink(indexPath.c_str());
+	unlink(damagedPath.c_str());
+	rmdir(directory);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+// Converts tracks between raw NMEA logs, the binary track log and
+// KML/GPX/CSV.
+//
+//   trackConvert in out [--from yyyy-mm-ddThh:mm:ss] [--to yyyy-mm-ddThh:mm:ss]
+//                       [--simplify metres] [--max-hdop hdop] [--max-speed m/s]
+//                       [--smooth metres] [--threads n]
+//
+// in is a raw NMEA log, a directory of them, converted in name order, or a
+// .trk track log. The format of out follows its extension: .trk, .kml,
+// .gpx, .geojson or .csv. Only valid fixes are converted. Raw logs are
+// decoded on --threads cores, every one by default, with the same result
+// as on one, see GPSBulkDecoder.h. --max-hdop and --max-speed drop fixes
+// with a worse HDOP or a jump faster than that from the last one; --smooth
+// runs the Kalman filter with that position error at HDOP 1, see
+// GPSFilter.h. --simplify then drops the points within that many metres
+// of the simplified track. --from and --to only apply to fixes with a
+// date, from RMC or NAV-PVT; those without one, e.g. from GGA alone, are
+// all kept.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include "GPSBulkDecoder.h"
+#include "GPSDecoder.h"
+#include "GPSFileSinks.h"
+#include "GPSFilter.h"
+#include "GPSGeodesy.h"
+#include "GPSSimplify.h"
+#include "GPSTrackLog.h"
+
+struct Conversion
+{
+	GPSSink* output;
+	int64_t from;
+	int64_t to;
+	uint64_t count;
+	uint64_t undated;
+	GPSMotionTracker motion;
+	GPSFixFilter filter;
+};
+
+static bool filterFix(Conversion* conversion, const GPSFix& fix, GPSFix& out)
+{
+	if(!conversion->filter.getConfig().enabled())
+	{
+		out = fix;
+		return true;
+	}
+	return conversion->filter.add(fix, out) == FILTER_ACCEPTED;
+}
+
+static void fixDecoded(const GPSFix& fix, void* context)
+{
+	Conversion* conversion = static_cast<Conversion*>(context);
+	if(!fix.valid())
+		return;
+
+	//without a date the time is only a time of day, the window cannot say
+	int64_t time = gpsFixTime(fix.date, fix.time);
+	bool inWindow = (time >= conversion->from) && (time <= conversion->to);
+	if(!fix.date.valid)
+	{
+		inWindow = true;
+		conversion->undated++;
+	}
+
+	GPSFix out;
+	if(inWindow && filterFix(conversion, fix, out))
+	{
+		conversion->output->fix(out);
+		conversion->motion.add(out);
+		conversion->count++;
+	}
+}
+
+static void pointRead(const GPSTrackPoint& point, void* context)
+{
+	Conversion* conversion = static_cast<Conversion*>(context);
+	GPSFix fix;
+	if(!filterFix(conversion, gpsTrackFix(point), fix))
+		return;
+
+	conversion->output->fix(fix);
+	conversion->motion.add(fix);
+	conversion->count++;
+}
+
+struct Collection
+{
+	Conversion* conversion;
+	std::vector<GPSTrackPoint> points;
+};
+
+static void pointCollected(const GPSTrackPoint& point, void* context)
+{
+	Collection* collection = static_cast<Collection*>(context);
+	GPSFix fix;
+	if(filterFix(collection->conversion, gpsTrackFix(point), fix))
+		collection->points.push_back(gpsTrackPoint(fix));
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 3)
+	{
+		std::cout << "usage: trackConvert in out [--from yyyy-mm-ddThh:mm:ss] [--to yyyy-mm-ddThh:mm:ss] [--simplify metres]"
+			" [--max-hdop hdop] [--max-speed m/s] [--smooth metres] [--threads n]" << std::endl;
+		return 1;
+	}
+
+	std::string in = argv[1];
+	std::string out = argv[2];
+
+	Conversion conversion;
+	conversion.count = 0;
+	conversion.undated = 0;
+	conversion.from = std::numeric_limits<int64_t>::min();
+	conversion.to = std::numeric_limits<int64_t>::max();
+	GPSSimplifyConfig simplify;
+	GPSFilterConfig filter;
+	GPSBulkConfig bulk;
+	for(int i = 3; i < argc; i += 2)
+	{
+		if(i + 1 == argc)
+		{
+			std::cout << "Missing value for " << argv[i] << std::endl;
+			return 1;
+		}
+		if(!strcmp(argv[i], "--simplify"))
+		{
+			simplify.toleranceMetres = atof(argv[i+1]);
+			continue;
+		}
+		if(!strcmp(argv[i], "--max-hdop"))
+		{
+			filter.maxHDOP = atof(argv[i+1]);
+			continue;
+		}
+		if(!strcmp(argv[i], "--max-speed"))
+		{
+			filter.maxSpeed = atof(argv[i+1]);
+			continue;
+		}
+		if(!strcmp(argv[i], "--smooth"))
+		{
+			filter.smooth = true;
+			filter.positionSigma = atof(argv[i+1]);
+			continue;
+		}
+		if(!strcmp(argv[i], "--threads"))
+		{
+			bulk.threads = atoi(argv[i+1]);
+			continue;
+		}
+
+		int64_t* limit = !strcmp(argv[i], "--from") ? &conversion.from : !strcmp(argv[i], "--to") ? &conversion.to : nullptr;
+		if(!limit || !gpsParseTime(argv[i+1], *limit))
+		{
+			std::cout << "Bad option " << argv[i] << " " << argv[i+1] << std::endl;
+			return 1;
+		}
+	}
+
+	std::unique_ptr<GPSSink> output = makeFileSink(out);
+	if(!output)
+	{
+		std::cout << "Unknown output format or failed to open " << out << std::endl;
+		return 1;
+	}
+	conversion.output = output.get();
+	conversion.filter.setConfig(filter);
+
+	GPSSimplifySink* simplifier = nullptr;
+
+	if(endsWith(in, ".trk"))
+	{
+		GPSTrackReader reader;
+		if(!reader.open(in))
+		{
+			std::cout << "Failed to open track log " << in << std::endl;
+			return 1;
+		}
+		if(reader.recovered())
+			std::cout << "Track log was not closed, rebuilt its index" << std::endl;
+
+		if(!simplify.enabled())
+			reader.read(conversion.from, conversion.to, pointRead, &conversion);
+		else
+		{
+			//the whole range at once, simplified on every core
+			Collection collection{&conversion, {}};
+			reader.read(conversion.from, conversion.to, pointCollected, &collection);
+			std::vector<GPSTrackPoint>& points = collection.points;
+
+			//the distance is that of the whole track, as without --simplify
+			for(const GPSTrackPoint& point : points)
+				conversion.motion.add(gpsTrackFix(point));
+
+			points = gpsSimplifyTrack(points.data(), points.size(), simplify.toleranceMetres);
+			for(const GPSTrackPoint& point : points)
+			{
+				conversion.output->fix(gpsTrackFix(point));
+				conversion.count++;
+			}
+		}
+	}
+	else
+	{
+		GPSBulkDecoder decoder;
+		decoder.setConfig(bulk);
+		if(!decoder.add(in))
+		{
+			std::cout << "Failed to open log " << in << std::endl;
+			return 1;
+		}
+
+		//points go through the simplifier on their way out
+		if(simplify.enabled())
+		{
+			simplifier = new GPSSimplifySink(simplify, std::move(output));
+			output.reset(simplifier);
+			conversion.output = simplifier;
+		}
+
+		if(!decoder.run(fixDecoded, &conversion))
+		{
+			std::cout << "Failed to open a log in " << in << std::endl;
+			return 1;
+		}
+	}
+
+	output->close();
+	if(simplifier)
+		conversion.count = simplifier->pointsKept();
+	std::cout << "Wrote " << conversion.count << " fixes to " << out << ", "
+		<< conversion.motion.motion().distance / 1000 << " km" << std::endl;
+	if(filter.enabled())
+		std::cout << "Filter dropped " << conversion.filter.rejected() << " fixes" << std::endl;
+	bool window = (conversion.from != std::numeric_limits<int64_t>::min()) || (conversion.to != std::numeric_limits<int64_t>::max());
+	if(window && conversion.undated)
+		std::cout << "Kept " << conversion.undated << " fixes without a date, --from and --to need RMC or NAV-PVT" << std::endl;
+	return 0;
+}
@@ -0,0 +1,170 @@
+// Indexes track logs by place and time, and pulls the fixes in an area
+// and time window out of them without reading the rest.
+//
+//   trackIndex build index.idx track.trk... [--threads n]
+//   trackIndex query index.idx out [--from yyyy-mm-ddThh:mm:ss] [--to yyyy-mm-ddThh:mm:ss]
+//                    [--box lat,lon,lat,lon | --radius lat,lon,metres | --polygon lat,lon,lat,lon,lat,lon...]
+//
+// The format of out follows its extension as for trackConvert. Without an
+// area the whole time window is written.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GPSFileSinks.h"
+#include "GPSTrackIndex.h"
+#include "GPSTrackLog.h"
+
+static std::vector<double> parseNumbers(const char* text)
+{
+	std::vector<double> numbers;
+	while(*text)
+	{
+		char* end;
+		numbers.push_back(strtod(text, &end));
+		if(end == text)
+			return std::vector<double>();
+		text = (*end == ',') ? end + 1 : end;
+	}
+	return numbers;
+}
+
+static void pointFound(const std::string& /*track*/, const GPSTrackPoint& point, void* sink)
+{
+	static_cast<GPSSink*>(sink)->fix(gpsTrackFix(point));
+}
+
+static int build(int argc, char** argv)
+{
+	std::vector<std::string> tracks;
+	int threads = 0;
+	for(int i = 3; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--threads"))
+		{
+			tracks.push_back(argv[i]);
+			continue;
+		}
+		if(i + 1 == argc)
+		{
+			std::cout << "Missing value for " << argv[i] << std::endl;
+			return 1;
+		}
+		threads = atoi(argv[++i]);
+	}
+
+	GPSTrackIndex index;
+	if(!index.build(tracks, threads))
+	{
+		std::cout << "Failed to open a track log" << std::endl;
+		return 1;
+	}
+	if(!index.save(argv[2]))
+	{
+		std::cout << "Failed to write " << argv[2] << std::endl;
+		return 1;
+	}
+
+	std::cout << "Indexed " << index.blockCount() << " blocks of " << index.trackCount() << " track logs" << std::endl;
+	return 0;
+}
+
+static int query(int argc, char** argv)
+{
+	if(argc < 4)
+		return -1;
+
+	int64_t from = GPSTrackIndex::ALL_TIME_FROM;
+	int64_t to = GPSTrackIndex::ALL_TIME_TO;
+	const char* shape = nullptr;
+	std::vector<double> area;
+	for(int i = 4; i < argc; i += 2)
+	{
+		if(i + 1 == argc)
+		{
+			std::cout << "Missing value for " << argv[i] << std::endl;
+			return 1;
+		}
+		if(!strcmp(argv[i], "--box") || !strcmp(argv[i], "--radius") || !strcmp(argv[i], "--polygon"))
+		{
+			shape = argv[i];
+			area = parseNumbers(argv[i+1]);
+			continue;
+		}
+
+		int64_t* limit = !strcmp(argv[i], "--from") ? &from : !strcmp(argv[i], "--to") ? &to : nullptr;
+		if(!limit || !gpsParseTime(argv[i+1], *limit))
+		{
+			std::cout << "Bad option " << argv[i] << " " << argv[i+1] << std::endl;
+			return 1;
+		}
+	}
+
+	bool box = shape && !strcmp(shape, "--box");
+	bool radius = shape && !strcmp(shape, "--radius");
+	if((box && (area.size() != 4)) || (radius && (area.size() != 3))
+		|| (shape && !box && !radius && ((area.size() < 6) || (area.size() % 2))))
+	{
+		std::cout << "Bad area for " << shape << std::endl;
+		return 1;
+	}
+
+	GPSTrackIndex index;
+	if(!index.load(argv[2]))
+	{
+		std::cout << "Failed to load " << argv[2] << ", or a track log changed since; build it again" << std::endl;
+		return 1;
+	}
+
+	std::unique_ptr<GPSSink> output = makeFileSink(argv[3]);
+	if(!output)
+	{
+		std::cout << "Unknown output format or failed to open " << argv[3] << std::endl;
+		return 1;
+	}
+
+	size_t found;
+	if(!shape)
+		found = index.queryBox(-90, -180, 90, 180, from, to, pointFound, output.get());
+	else if(box)
+		found = index.queryBox(area[0], area[1], area[2], area[3], from, to, pointFound, output.get());
+	else if(radius)
+		found = index.queryRadius(area[0], area[1], area[2], from, to, pointFound, output.get());
+	else
+	{
+		std::vector<double> latitude, longitude;
+		for(size_t i = 0; i < area.size(); i += 2)
+		{
+			latitude.push_back(area[i]);
+			longitude.push_back(area[i+1]);
+		}
+		found = index.queryPolygon(latitude.data(), longitude.data(), latitude.size(), from, to, pointFound, output.get());
+	}
+	output->close();
+
+	std::cout << "Wrote " << found << " fixes to " << argv[3] << " from " << index.blocksRead()
+		<< " of " << index.blockCount() << " blocks" << std::endl;
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int ret = -1;
+	if((argc >= 4) && !strcmp(argv[1], "build"))
+		ret = build(argc, argv);
+	else if((argc >= 4) && !strcmp(argv[1], "query"))
+		ret = query(argc, argv);
+
+	if(ret < 0)
+	{
+		std::cout << "usage: trackIndex build index.idx track.trk... [--threads n]" << std::endl;
+		std::cout << "       trackIndex query index.idx out [--from yyyy-mm-ddThh:mm:ss] [--to yyyy-mm-ddThh:mm:ss]" << std::endl;
+		std::cout << "                        [--box lat,lon,lat,lon | --radius lat,lon,metres | --polygon lat,lon,...]" << std::endl;
+		return 1;
+	}
+	return ret;
+}